@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+
+struct Stopwatch
+{
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start = Clock::now();
+};
+
+// Seconds since the stopwatch was started.
+double Elapsed(const Stopwatch& stopwatch)
+{
+    const auto delta = Stopwatch::Clock::now() - stopwatch.start;
+    return std::chrono::duration<double>(delta).count();
+}
+
+
+// Runs 'function' 'repetitions' times and returns the fastest run in seconds. The fastest run is the one least
+// disturbed by the rest of the system, which makes it the most stable number to compare between runs.
+template <typename Function>
+double Measure(const unsigned repetitions, Function&& function)
+{
+    double best = std::numeric_limits<double>::max();
+
+    for (unsigned i = 0; i < repetitions; ++i)
+    {
+        Stopwatch stopwatch;
+        function();
+        const double seconds = Elapsed(stopwatch);
+
+        if (seconds < best)
+            best = seconds;
+    }
+
+    return best;
+}
+
+
+void ReportHeader(const char* title)
+{
+    printf("\n---- %s ----\n", title);
+    printf("%-48s %12s %16s\n", "Case", "Time (ms)", "Throughput");
+}
+
+// Prints the time of a case together with how many 'unit' it processes per second.
+void Report(const char* name, const double seconds, const double items, const char* unit)
+{
+    const double per_second = items / seconds;
+
+    if (per_second >= 1e6)
+        printf("%-48s %12.3f %12.2f M%s/s\n", name, seconds * 1000.0, per_second / 1e6, unit);
+    else
+        printf("%-48s %12.3f %12.2f  %s/s\n", name, seconds * 1000.0, per_second, unit);
+}
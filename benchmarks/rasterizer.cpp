@@ -0,0 +1,794 @@
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "binning.h"
+#include "pipeline.h"
+#include "shadows.h"
+#include "lab2.h"
+
+
+// Draws the model from Lab3's default view with the serial rasterizer, then with the binned one on more and more
+// threads. The binned frame time should go down with the number of threads, up to the number of cores.
+void BenchmarkBinning(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    const Mesh mesh = IndexedMesh(model);
+
+    VertexBuffer vertices;
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+
+    const double triangles = model.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    const double serial = Measure(repetitions, [&]()
+    {
+        Draw(camera, viewport, mesh, vertices, z_buffer, View(image));
+    });
+    Report((prefix + " serial").c_str(), serial, triangles, "triangles");
+
+    for (const unsigned thread_count : { 1u, 2u, 4u, 8u, std::thread::hardware_concurrency() })
+    {
+        ThreadPool pool(thread_count);
+        TileBins bins;
+
+        const double binned = Measure(repetitions, [&]()
+        {
+            DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+        });
+
+        Report((prefix + " binned, " + std::to_string(thread_count) + " threads").c_str(), binned, triangles, "triangles");
+        printf("%-48s %12.2fx\n", "Speedup over serial", serial / binned);
+    }
+}
+
+
+// Transforms the model's vertices for Lab3's default view, first three per triangle with VertexShader, then every
+// vertex of the indexed mesh once with TransformVertices.
+void BenchmarkVertexStage(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    std::vector<RasterVertex> rasters(3 * model.size());
+    VertexBuffer vertices;
+    Resize(vertices, mesh);
+
+    const double triangles = model.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(mesh.vertex_count) + " of " + std::to_string(3 * model.size()) + " vertices)";
+
+    const double per_triangle = Measure(repetitions, [&]()
+    {
+        for (size_t i = 0; i < model.size(); ++i)
+        {
+            rasters[3 * i + 0] = VertexShader(viewport, Vertex(model[i].v0), camera);
+            rasters[3 * i + 1] = VertexShader(viewport, Vertex(model[i].v1), camera);
+            rasters[3 * i + 2] = VertexShader(viewport, Vertex(model[i].v2), camera);
+        }
+    });
+
+    const double batched = Measure(repetitions, [&]()
+    {
+        TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+    });
+
+    Report((prefix + " per triangle").c_str(), per_triangle, triangles, "triangles");
+    Report((prefix + " batched").c_str(),      batched,      triangles, "triangles");
+    printf("%-48s %12.2fx\n", "Speedup", per_triangle / batched);
+}
+
+
+// The model as the rasterizer sees it from Lab3's default view.
+std::vector<ScreenTriangle> ScreenTriangles(const std::vector<Triangle>& model, const Viewport& viewport)
+{
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    std::vector<ScreenTriangle> triangles;
+    triangles.reserve(model.size());
+
+    for (u32 i = 0; i < model.size(); ++i)
+    {
+        const Triangle& triangle = model[i];
+        triangles.push_back({
+            VertexShader(viewport, Vertex(triangle.v0), camera),
+            VertexShader(viewport, Vertex(triangle.v1), camera),
+            VertexShader(viewport, Vertex(triangle.v2), camera),
+            ColorCode(triangle.color),
+            i,
+            ScreenTriangle::WHOLE
+        });
+    }
+
+    return triangles;
+}
+
+// Rasterizes and depth tests already transformed triangles, first collecting every triangle's fragments in a vector
+// and depth testing them afterwards, then depth testing them in a fragment functor as they're found.
+void BenchmarkFragments(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const std::vector<ScreenTriangle> triangles = ScreenTriangles(model, viewport);
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+    const Array2DView<u32> framebuffer = View(image);
+
+    const double collected = Measure(repetitions, [&]()
+    {
+        Fill(z_buffer, std::numeric_limits<f32>::max());
+        for (const ScreenTriangle& triangle : triangles)
+        {
+            for (const Pixel& pixel : Rasterize(viewport, triangle.p0, triangle.p1, triangle.p2))
+            {
+                if (z_buffer(pixel.location.y, pixel.location.x) > pixel.z)
+                {
+                    z_buffer(pixel.location.y, pixel.location.x) = pixel.z;
+                    framebuffer(pixel.location.y, pixel.location.x) = triangle.color;
+                }
+            }
+        }
+    });
+
+    const double streamed = Measure(repetitions, [&]()
+    {
+        Fill(z_buffer, 0.0f);  // It holds 1/z.
+        for (const ScreenTriangle& triangle : triangles)
+            Rasterize(viewport, triangle.p0, triangle.p1, triangle.p2, DepthTestFragment { z_buffer, framebuffer, triangle.color });
+    });
+
+    const double count = triangles.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    Report((prefix + " std::vector<Pixel>").c_str(), collected, count, "triangles");
+    Report((prefix + " fragment functor").c_str(),   streamed,  count, "triangles");
+    printf("%-48s %12.2fx\n", "Speedup", collected / streamed);
+}
+
+
+// The rasterizer before incremental stepping, for comparison: all three edge functions evaluated in full at every
+// pixel, and z from a division per covered pixel.
+template <typename Fragment>
+void RasterizeReference(const Viewport& viewport, const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2, const Fragment& fragment)
+{
+    const AABB aabb = PixelBounds(viewport, p0, p1, p2);
+
+    const f32 area = EdgeFunction(p0, p1, p2.x, p2.y);
+
+    for (i32 y = aabb.top; y <= aabb.bottom; y++)
+    {
+        for (i32 x = aabb.left; x <= aabb.right; x++)
+        {
+            const i64 sample_x = i64(x) * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+            const i64 sample_y = i64(y) * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+
+            const i64 w0 = EdgeFunction(p1, p2, sample_x, sample_y);
+            const i64 w1 = EdgeFunction(p2, p0, sample_x, sample_y);
+            const i64 w2 = EdgeFunction(p0, p1, sample_x, sample_y);
+
+            if (w0 <= 0 && w1 <= 0 && w2 <= 0)
+            {
+                const f32 z = 1 / ((w0 / area) / p0.z + (w1 / area) / p1.z + (w2 / area) / p2.z);
+                fragment(x, y, 1 / z);
+            }
+        }
+    }
+}
+
+// 'count' right triangles with legs of 'size' pixels scattered over the viewport, at random depths.
+std::vector<ScreenTriangle> SizedTriangles(const Viewport& viewport, const int size, const unsigned count)
+{
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int> x     (viewport.left, std::max(viewport.left, viewport.right  - size));
+    std::uniform_int_distribution<int> y     (viewport.top,  std::max(viewport.top,  viewport.bottom - size));
+    std::uniform_real_distribution<f32> depth (2.0f, 50.0f);
+
+    std::vector<ScreenTriangle> triangles;
+    triangles.reserve(count);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const i32 left = x(generator);
+        const i32 top  = y(generator);
+        const f32 z    = depth(generator);
+        triangles.push_back({ AtPixel(left, top, z), AtPixel(left + size, top, z + 1), AtPixel(left, top + size, z + 2), 0xFFFFFFFFu, i, ScreenTriangle::WHOLE });
+    }
+
+    return triangles;
+}
+
+// Rasterizes triangles of one size with the reference, the incremental and the SIMD block rasterizer.
+void BenchmarkTriangleSize(const char* name, const std::vector<ScreenTriangle>& triangles, const Viewport& viewport, const unsigned repetitions)
+{
+    const int width  = viewport.right  - viewport.left;
+    const int height = viewport.bottom - viewport.top;
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+    const Array2DView<u32> framebuffer = View(image);
+
+    long fragments = 0;
+    for (const ScreenTriangle& triangle : triangles)
+        Rasterize(viewport, triangle.p0, triangle.p1, triangle.p2, [&](i32, i32, f32) { fragments += 1; });
+
+    const double reference = Measure(repetitions, [&]()
+    {
+        Fill(z_buffer, 0.0f);
+        for (const ScreenTriangle& triangle : triangles)
+            RasterizeReference(viewport, triangle.p0, triangle.p1, triangle.p2, DepthTestFragment { z_buffer, framebuffer, triangle.color });
+    });
+
+    const double incremental = Measure(repetitions, [&]()
+    {
+        Fill(z_buffer, 0.0f);
+        for (const ScreenTriangle& triangle : triangles)
+            Rasterize(viewport, triangle.p0, triangle.p1, triangle.p2, DepthTestFragment { z_buffer, framebuffer, triangle.color });
+    });
+
+    const double blocks = Measure(repetitions, [&]()
+    {
+        Fill(z_buffer, 0.0f);
+        for (const ScreenTriangle& triangle : triangles)
+            RasterizeBlocks(viewport, triangle.p0, triangle.p1, triangle.p2, DepthTestFragment { z_buffer, framebuffer, triangle.color });
+    });
+
+    const double count = triangles.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(fragments / triangles.size()) + " px each)";
+
+    Report((prefix + " reference").c_str(),   reference,   count, "triangles");
+    Report((prefix + " incremental").c_str(), incremental, count, "triangles");
+    Report((prefix + " SIMD blocks").c_str(), blocks,      count, "triangles");
+    printf("%-48s %12.2fx  %6.2fx  (%.1f M fragments/s)\n", "Speedup incremental, blocks over incremental",
+        reference / incremental, incremental / blocks, fragments / blocks / 1e6);
+}
+
+
+// Draws the model on all threads with and without the hierarchical z-buffer, and reports what it culled.
+void BenchmarkHierarchicalZ(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+
+    const Mesh mesh = IndexedMesh(model);
+
+    ThreadPool pool(std::thread::hardware_concurrency());
+    TileBins bins;
+
+    const double triangles = model.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    bins.hierarchical_z = false;
+    const double without = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+
+    bins.hierarchical_z = true;
+    const double with = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+    const OcclusionStats stats = Occlusion(bins);
+
+    Report((prefix + " without").c_str(), without, triangles, "triangles");
+    Report((prefix + " with").c_str(),    with,    triangles, "triangles");
+    printf("%-48s %12.2fx\n", "Speedup", without / with);
+    printf(
+        "%-48s %llu of %llu triangles, %llu of %llu blocks, %llu pixels\n", "Culled",
+        static_cast<unsigned long long>(stats.triangles_culled), static_cast<unsigned long long>(stats.triangles),
+        static_cast<unsigned long long>(stats.blocks_culled),    static_cast<unsigned long long>(stats.blocks),
+        static_cast<unsigned long long>(stats.pixels_culled)
+    );
+}
+
+// Walls over Lab3's whole default view, one behind the other, a unit apart (the vertex shader rounds depths to whole
+// units). Front to back, everything but the first is hidden; back to front, nothing is.
+std::vector<Triangle> LayeredModel(const unsigned layers, const bool front_to_back)
+{
+    using glm::vec3;
+
+    std::vector<Triangle> model;
+    for (unsigned layer = 0; layer < layers; ++layer)
+    {
+        const float distance = 2.0f + (front_to_back ? layer : layers - 1 - layer);
+        const float z    = 3.0f - distance;
+        const float side = 2.0f * distance;
+        const vec3 a (-side, -side, z), b (side, -side, z), c (side, side, z), d (-side, side, z);
+        const vec3 color (0.2f + 0.6f * layer / layers);
+
+        model.emplace_back(a, b, c, color);
+        model.emplace_back(a, c, d, color);
+    }
+
+    return model;
+}
+
+
+// Draws the model on all threads flat shaded, then deferred with PixelShader once per pixel. The shading pass costs the
+// same however much overdraw the model has.
+void BenchmarkDeferred(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    Light light;
+    light.position = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+    GBuffer gbuffer;
+
+    ThreadPool pool(std::thread::hardware_concurrency());
+    TileBins bins;
+
+    const double triangles = model.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    const double forward = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+
+    const double deferred = Measure(repetitions, [&]()
+    {
+        DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, View(image));
+    });
+
+    const double shading = Measure(repetitions, [&]()
+    {
+        Shade(light, viewport, mesh, gbuffer, pool, View(image));
+    });
+
+    Report((prefix + " flat").c_str(),          forward,  triangles, "triangles");
+    Report((prefix + " deferred").c_str(),      deferred, triangles, "triangles");
+    Report((prefix + " of it shading").c_str(), shading,  static_cast<double>(width) * height, "pixels");
+}
+
+// Draws the model on all threads in one pass, then with a depth pre-pass, and how many fragments each shaded per pixel.
+// Flat shading is only a store, so this is mostly what the second pass of rasterization costs; the shading saved grows
+// with what PixelShader would cost.
+void BenchmarkDepthPrepass(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+
+    ThreadPool pool(std::thread::hardware_concurrency());
+    TileBins bins;
+
+    const double triangles = model.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    bins.depth_prepass = false;
+    const double single = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+    const ShadingStats single_shading = Shading(bins);
+
+    bins.depth_prepass = true;
+    const double prepass = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+    const ShadingStats prepass_shading = Shading(bins);
+
+    Report((prefix + " one pass").c_str(),       single,  triangles, "triangles");
+    Report((prefix + " depth pre-pass").c_str(), prepass, triangles, "triangles");
+    printf("%-48s %12.3f -> %.3f\n", "Shaded per pixel", ShadedPerPixel(single_shading), ShadedPerPixel(prepass_shading));
+}
+
+
+// Interpolates N varyings at every fragment and adds them up, so none of it can be optimized away.
+template <unsigned N>
+struct SumVaryings
+{
+    const VaryingInterpolator<N>& interpolator;
+    SimdFloat&                    sum;
+
+    inline void operator() (const i32 x, const i32 y, const f32 depth) const noexcept
+    {
+        Varyings<N> varyings;
+        interpolator.At(x, y, depth, varyings);
+        for (unsigned i = 0; i < N; ++i)
+            sum = sum + SimdFloat(varyings.values[i]);
+    }
+    inline void operator() (const i32 x, const i32 y, const SimdFloat& depth, const SimdFloat& covered) const noexcept
+    {
+        SimdFloat varyings[N];
+        interpolator.At(x, y, depth, varyings);
+        for (unsigned i = 0; i < N; ++i)
+            sum = sum + (varyings[i] & covered);
+    }
+};
+
+// Interpolates N varyings at every pixel of a triangle over the whole viewport, in SIMD. What a shader pays per pixel for its
+// varyings, by how many it has.
+template <unsigned N>
+void BenchmarkVaryings(const Viewport& viewport, const unsigned repetitions)
+{
+    const RasterVertex p0 = AtPixel(viewport.left,      viewport.top,        1.0f);
+    const RasterVertex p1 = AtPixel(viewport.right * 2, viewport.top,        2.0f);
+    const RasterVertex p2 = AtPixel(viewport.left,      viewport.bottom * 2, 4.0f);
+
+    long fragments = 0;
+    Rasterize(viewport, p0, p1, p2, [&](i32, i32, f32) { fragments += 1; });
+
+    Varyings<N> vertices[3];
+    for (unsigned i = 0; i < N; ++i)
+        for (unsigned vertex = 0; vertex < 3; ++vertex)
+            vertices[vertex].values[i] = static_cast<f32>(i + vertex);
+
+    const VaryingInterpolator<N> interpolator = Interpolator(p0, p1, p2, WholeTriangle(), vertices);
+
+    SimdFloat sum (0.0f);
+    const double seconds = Measure(repetitions, [&]()
+    {
+        RasterizeBlocks(viewport, p0, p1, p2, SumVaryings<N> { interpolator, sum });
+    });
+
+    alignas(SIMD_ALIGNMENT) f32 lanes[SIMD_WIDTH];
+    Store(lanes, sum);
+
+    Report((std::to_string(N) + " varyings").c_str(), seconds, static_cast<double>(fragments), "pixels");
+    if (lanes[0] < 0.0f)
+        printf("(The sum %f only keeps the interpolation from being optimized away.)\n", lanes[0]);
+}
+
+// Draws the model on all threads flat shaded, then lit with PixelShader at every fragment at the world position its
+// varyings give, with and without a depth pre-pass, then deferred.
+void BenchmarkLit(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    Light light;
+    light.position = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+    GBuffer gbuffer;
+
+    ThreadPool pool(std::thread::hardware_concurrency());
+    TileBins bins;
+
+    const double triangles = model.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    const double flat = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+
+    const double lit = Measure(repetitions, [&]()
+    {
+        DrawBinnedLit(camera, light, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+
+    bins.depth_prepass = true;
+    const double lit_prepass = Measure(repetitions, [&]()
+    {
+        DrawBinnedLit(camera, light, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+    bins.depth_prepass = false;
+
+    const double deferred = Measure(repetitions, [&]()
+    {
+        DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, View(image));
+    });
+
+    Report((prefix + " flat").c_str(),          flat,        triangles, "triangles");
+    Report((prefix + " lit").c_str(),           lit,         triangles, "triangles");
+    Report((prefix + " lit, pre-pass").c_str(), lit_prepass, triangles, "triangles");
+    Report((prefix + " deferred").c_str(),      deferred,    triangles, "triangles");
+}
+
+
+// The 12 triangles of a cube facing outwards, each face after one it shares an edge with.
+void AddCube(std::vector<Triangle>& model, const glm::vec3& centre, const float half, const glm::vec3& color)
+{
+    using glm::vec3;
+    const vec3 x (1, 0, 0), y (0, 1, 0), z (0, 0, 1);
+
+    const vec3 faces[6][3] = { { x, y, z }, { y, z, x }, { -x, z, y }, { -y, x, z }, { z, x, y }, { -z, y, x } };
+    for (const auto& face : faces)
+    {
+        const vec3 middle = centre + face[0] * half;
+        model.emplace_back(middle + (-face[1] - face[2]) * half, middle + (face[1] - face[2]) * half, middle + (face[1] + face[2]) * half, color);
+        model.emplace_back(middle + (-face[1] - face[2]) * half, middle + (face[1] + face[2]) * half, middle + (-face[1] + face[2]) * half, color);
+    }
+}
+
+// A wall over the middle of Lab3's default view, and a 'side' x 'side' field of cubes on the floor behind it, most of
+// them hidden by it.
+std::vector<Triangle> WalledModel(const unsigned side)
+{
+    using glm::vec3;
+
+    std::vector<Triangle> model;
+    const vec3 a (-0.8f, -0.8f, 1.5f), b (0.8f, -0.8f, 1.5f), c (0.8f, 0.8f, 1.5f), d (-0.8f, 0.8f, 1.5f);
+    model.emplace_back(a, b, c, vec3(0.75f));
+    model.emplace_back(a, c, d, vec3(0.75f));
+
+    const float spacing = 4.0f / side;
+    for (unsigned row = 0; row < side; ++row)
+        for (unsigned column = 0; column < side; ++column)
+            AddCube(model, vec3(-2.0f + spacing * column, 0.6f, -spacing * row), 0.3f * spacing, vec3(0.3f + 0.5f * column / side, 0.4f, 0.3f + 0.5f * row / side));
+
+    return model;
+}
+
+// Draws the model on all threads with and without occlusion culling, how long culling the clusters takes of that, and
+// what it culled.
+void BenchmarkOcclusionCulling(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+
+    ThreadPool pool(std::thread::hardware_concurrency());
+    TileBins bins;
+
+    const double triangles = model.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    bins.occlusion_culling = false;
+    const double without = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+
+    bins.occlusion_culling = true;
+    const double with = Measure(repetitions, [&]()
+    {
+        DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    });
+    const ClusterStats stats = bins.cluster_culling;
+
+    std::vector<u8> visible;
+    const double culling = Measure(repetitions, [&]()
+    {
+        CullClusters(camera, viewport, mesh, pool, bins.occlusion_buffer, visible);
+    });
+
+    Report((prefix + " without").c_str(),         without, triangles, "triangles");
+    Report((prefix + " with").c_str(),            with,    triangles, "triangles");
+    Report((prefix + " of it culling").c_str(),   culling, static_cast<double>(mesh.clusters.size()), "clusters");
+    printf("%-48s %12.2fx\n", "Speedup", without / with);
+    printf(
+        "%-48s %llu of %llu clusters, %llu of %llu triangles, %llu occluders\n", "Culled",
+        static_cast<unsigned long long>(stats.culled), static_cast<unsigned long long>(stats.clusters),
+        static_cast<unsigned long long>(Culling(bins).occluded), static_cast<unsigned long long>(model.size()),
+        static_cast<unsigned long long>(stats.occluders)
+    );
+}
+
+
+// Draws 'frames' frames flying towards the model on all threads, lit, one after the other and then pipelined, with the
+// geometry of every frame overlapping the tiles of the one before. The time is per frame, over the whole flight, so the
+// pipeline filling and draining is in it. Pipelining gains when neither stage keeps all cores busy on its own.
+void BenchmarkPipeline(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned frames, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    std::vector<Camera> cameras(frames);
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        cameras[frame].position = glm::vec3(0.0f, 0.0f, 4.0f - 1.5f * frame / frames);
+        SetYaw(cameras[frame], 0.0f);
+    }
+
+    Light light;
+    light.position = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+
+    const unsigned thread_count = std::thread::hardware_concurrency();
+    ThreadPool    pool(thread_count);
+    TileBins      bins;
+    FramePipeline pipeline(mesh, viewport, thread_count);
+
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    const double serial = Measure(repetitions, [&]()
+    {
+        for (const Camera& camera : cameras)
+            DrawBinnedLit(camera, light, viewport, mesh, pool, bins, z_buffer, View(image));
+    }) / frames;
+
+    const auto draw_bins = [&](const Camera& camera, const Light& frame_light, TileBins& frame_bins)
+    {
+        DrawBinsLit(camera, frame_light, viewport, mesh, pool, frame_bins, z_buffer, View(image));
+    };
+
+    const double pipelined = Measure(repetitions, [&]()
+    {
+        BeginFrame(pipeline, cameras[0], light);
+        for (unsigned frame = 0; frame < frames; ++frame)
+        {
+            if (frame + 1 < frames)
+                BeginFrame(pipeline, cameras[frame + 1], light);
+            DrawFrame(pipeline, draw_bins);
+        }
+    }) / frames;
+
+    Report((prefix + " one after the other").c_str(), serial,    1.0, "frames");
+    Report((prefix + " pipelined").c_str(),           pipelined, 1.0, "frames");
+    printf("%-48s %12.2fx\n", "Speedup", serial / pipelined);
+}
+
+// Draws frames of the model lit by a moving light, with Lab3's deferred shading and no shadows, then in the shadows of
+// a shadow map drawn again every frame at a few sizes, and with Lab2's ray tracer at the same size: with the camera
+// moving too, and with it still, when the primary hits are kept and what Lab2 pays is mostly its shadow rays.
+void BenchmarkShadows(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned frames, const unsigned repetitions)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    std::vector<Camera> cameras(frames);
+    std::vector<Light>  lights(frames);
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        cameras[frame].position = glm::vec3(0.0f, 0.0f, 3.0f - 0.5f * frame / frames);
+        lights[frame].position  = glm::vec3(-0.5f + 1.0f * frame / frames, -0.4f, 0.3f);
+    }
+
+    Array2D<u32> image(height, width);
+    GBuffer      gbuffer;
+    ShadowMap    shadows;
+
+    ThreadPool pool(std::thread::hardware_concurrency());
+    TileBins   bins;
+
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    const double unshadowed = Measure(repetitions, [&]()
+    {
+        for (unsigned frame = 0; frame < frames; ++frame)
+            DrawBinnedDeferred(cameras[frame], lights[frame], viewport, mesh, pool, bins, gbuffer, View(image));
+    }) / frames;
+    Report((prefix + " no shadows").c_str(), unshadowed, 1.0, "frames");
+
+    for (const i32 size : { 256, 512, 1024 })
+    {
+        Resize(shadows, size);
+
+        const double shadowed = Measure(repetitions, [&]()
+        {
+            for (unsigned frame = 0; frame < frames; ++frame)
+            {
+                DrawShadowMap(lights[frame], mesh, pool, shadows);
+                DrawBinnedDeferred(cameras[frame], lights[frame], viewport, mesh, pool, bins, gbuffer, View(image), &shadows);
+            }
+        }) / frames;
+
+        const std::string label = prefix + " shadow map " + std::to_string(size) + "x" + std::to_string(size);
+        Report(label.c_str(), shadowed, 1.0, "frames");
+    }
+
+    const BVH bvh = BuildBVH(model);
+    const std::vector<ShadingRecord> shading = ShadingTable(model);
+    PrimaryHits hits(width, height);
+
+    const double ray_traced = Measure(repetitions, [&]()
+    {
+        for (unsigned frame = 0; frame < frames; ++frame)
+            Draw(cameras[frame], lights[frame], width / 2.0f, shading, bvh, pool, hits, View(image));
+    }) / frames;
+
+    const double shadow_rays = Measure(repetitions, [&]()
+    {
+        for (const Light& light : lights)
+            Draw(cameras[0], light, width / 2.0f, shading, bvh, pool, hits, View(image));
+    }) / frames;
+
+    Report((prefix + " Lab2 ray traced").c_str(),       ray_traced,  1.0, "frames");
+    Report((prefix + " Lab2 camera still").c_str(),     shadow_rays, 1.0, "frames");
+}
+
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    ReportHeader("Binned rasterizer");
+
+    BenchmarkBinning("Cornell box", LoadTestModel(),         400, 400, 20);
+    BenchmarkBinning("Random",      LoadRandomModel(100000), 400, 400, 3);
+
+    ReportHeader("Vertex stage");
+
+    BenchmarkVertexStage("Cornell box", LoadTestModel(),         400, 400, 1000);
+    BenchmarkVertexStage("Random",      LoadRandomModel(100000), 400, 400, 20);
+
+    ReportHeader("Fragments");
+
+    BenchmarkFragments("Cornell box", LoadTestModel(),         400, 400, 20);
+    BenchmarkFragments("Random",      LoadRandomModel(100000), 400, 400, 5);
+
+    ReportHeader("Triangle sizes");
+
+    const Viewport viewport {0, 0, 400, 400};
+    BenchmarkTriangleSize("Small",          SizedTriangles(viewport,   4, 200000), viewport, 5);
+    BenchmarkTriangleSize("Medium",         SizedTriangles(viewport,  40,  10000), viewport, 5);
+    BenchmarkTriangleSize("Screen filling", SizedTriangles(viewport, 800,    100), viewport, 5);
+
+    ReportHeader("Hierarchical z-buffer");
+
+    BenchmarkHierarchicalZ("Cornell box",           LoadTestModel(),         400, 400, 20);
+    BenchmarkHierarchicalZ("Random",                LoadRandomModel(100000), 400, 400, 5);
+    BenchmarkHierarchicalZ("Layers, front to back", LayeredModel(50, true),  400, 400, 10);
+    BenchmarkHierarchicalZ("Layers, back to front", LayeredModel(50, false), 400, 400, 10);
+
+    ReportHeader("Deferred shading");
+
+    BenchmarkDeferred("Cornell box",           LoadTestModel(),         400, 400, 20);
+    BenchmarkDeferred("Layers, back to front", LayeredModel(50, false), 400, 400, 10);
+
+    ReportHeader("Depth pre-pass");
+
+    BenchmarkDepthPrepass("Cornell box",           LoadTestModel(),         400, 400, 20);
+    BenchmarkDepthPrepass("Random",                LoadRandomModel(100000), 400, 400, 5);
+    BenchmarkDepthPrepass("Layers, front to back", LayeredModel(50, true),  400, 400, 10);
+    BenchmarkDepthPrepass("Layers, back to front", LayeredModel(50, false), 400, 400, 10);
+
+    ReportHeader("Varyings");
+
+    BenchmarkVaryings<1>(viewport, 50);
+    BenchmarkVaryings<3>(viewport, 50);
+    BenchmarkVaryings<8>(viewport, 50);
+
+    BenchmarkLit("Cornell box",           LoadTestModel(),         400, 400, 20);
+    BenchmarkLit("Layers, back to front", LayeredModel(50, false), 400, 400, 10);
+
+    ReportHeader("Occlusion culling");
+
+    BenchmarkOcclusionCulling("Cornell box",   LoadTestModel(),   400, 400, 20);
+    BenchmarkOcclusionCulling("Behind a wall", WalledModel(100),  400, 400, 10);
+
+    ReportHeader("Frame pipeline");
+
+    BenchmarkPipeline("Cornell box", LoadTestModel(),         400, 400, 60, 5);
+    BenchmarkPipeline("Random",      LoadRandomModel(100000), 400, 400, 20, 3);
+
+    ReportHeader("Shadows");
+
+    BenchmarkShadows("Cornell box", LoadTestModel(),         400, 400, 20, 5);
+    BenchmarkShadows("Random",      LoadRandomModel(100000), 400, 400, 5,  2);
+}
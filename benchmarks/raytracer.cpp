@@ -0,0 +1,253 @@
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "TestModel.h"
+#include "raytracer.h"
+#include "soa.h"
+#include "bvh.h"
+#include "packet.h"
+
+
+// The primary rays of Lab2's default view: a 'width' x 'height' image with the camera at (0, 0, 2) looking down -z.
+std::vector<glm::vec3> PrimaryRays(const int width, const int height)
+{
+    const float focal = width / 2.0f;
+
+    std::vector<glm::vec3> directions;
+    directions.reserve(static_cast<unsigned>(width * height));
+
+    for (int row = 0; row < height; ++row)
+        for (int column = 0; column < width; ++column)
+            directions.emplace_back(column - (width / 2.0f), row - (height / 2.0f), -focal);
+
+    return directions;
+}
+
+
+// Intersects every ray with the model using the reference kernel, the precomputed one, and the precomputed one on
+// SIMD_WIDTH triangles at a time.
+void BenchmarkClosestIntersection(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+
+    const std::vector<glm::vec3>      directions = PrimaryRays(width, height);
+    const std::vector<TriangleRecord> records    = PrecomputeTriangles(model);
+    const TriangleLanes               lanes      = PrecomputeTriangleLanes(model);
+
+    // Sums up the hit indices so the compiler can't throw away the work.
+    long checksum = 0;
+
+    const double reference = Measure(repetitions, [&]()
+    {
+        for (const glm::vec3& direction : directions)
+            checksum += ClosestIntersection(origin, direction, model).triangle_index;
+    });
+
+    const double precomputed = Measure(repetitions, [&]()
+    {
+        for (const glm::vec3& direction : directions)
+            checksum += ClosestIntersection(origin, direction, records).triangle_index;
+    });
+
+    const double vectorized = Measure(repetitions, [&]()
+    {
+        for (const glm::vec3& direction : directions)
+            checksum += ClosestIntersection(origin, direction, lanes).triangle_index;
+    });
+
+    const double rays = directions.size();
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    Report((prefix + " inverse").c_str(),      reference,   rays, "rays");
+    Report((prefix + " precomputed").c_str(),  precomputed, rays, "rays");
+    Report((prefix + " SoA").c_str(),          vectorized,  rays, "rays");
+    printf("%-48s %12.2fx  %6.2fx  (checksum %ld)\n", "Speedup precomputed, SoA over precomputed", reference / precomputed, precomputed / vectorized, checksum);
+}
+
+
+// Builds a BVH over random models of increasing size and traces the same rays through each. The work per ray
+// ('nodes/ray' and 'tests/ray') must grow sub-linearly with the triangle count. Most of these rays pass through the
+// whole cloud of triangles without hitting anything, which is why 'nodes/ray' still grows like the cube root.
+void BenchmarkBVHScaling(const int width, const int height)
+{
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+    const std::vector<glm::vec3> directions = PrimaryRays(width, height);
+
+    printf("%-12s %12s %12s %14s %12s %12s\n", "Triangles", "Build (ms)", "Trace (ms)", "Throughput", "Nodes/ray", "Tests/ray");
+
+    for (const unsigned count : { 100u, 1000u, 10000u, 100000u, 1000000u })
+    {
+        const std::vector<Triangle> model = LoadRandomModel(count);
+
+        BVH bvh;
+        const double build = Measure(1, [&]() { bvh = BuildBVH(model); });
+
+        TraversalStatistics statistics;
+        long checksum = 0;
+
+        const double trace = Measure(1, [&]()
+        {
+            for (const glm::vec3& direction : directions)
+                checksum += ClosestIntersection(origin, direction, bvh, &statistics).triangle_index;
+        });
+
+        printf(
+            "%-12u %12.3f %12.3f %9.2f Mrays/s %12.1f %12.1f\n",
+            count, build * 1000.0, trace * 1000.0, directions.size() / trace / 1e6,
+            statistics.node_visits / double(statistics.rays), statistics.triangle_tests / double(statistics.rays)
+        );
+    }
+}
+
+
+struct ShadowRay
+{
+    glm::vec3 start;
+    glm::vec3 direction;  // Reaches the light at t = 1.
+};
+
+// The shadow rays Lab2's Draw would trace for the default view.
+std::vector<ShadowRay> ShadowRays(const BVH& bvh, const glm::vec3& light, const int width, const int height)
+{
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+
+    std::vector<ShadowRay> rays;
+
+    for (const glm::vec3& direction : PrimaryRays(width, height))
+    {
+        const Intersection intersection = ClosestIntersection(origin, direction, bvh);
+        if (!intersection)
+            continue;
+
+        const glm::vec3 intersection_to_light = light - intersection.position;
+        const glm::vec3 start = intersection.position + glm::normalize(intersection_to_light) * 0.001f;
+
+        rays.push_back({ start, intersection_to_light });
+    }
+
+    return rays;
+}
+
+// Compares answering shadow rays with the closest hit (the old path in Draw) against the any-hit query.
+void BenchmarkShadowRays(
+        const char* name, const std::vector<Triangle>& model, const glm::vec3& light,
+        const bool include_linear, const unsigned repetitions
+)
+{
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(model);
+    const BVH bvh = BuildBVH(model);
+
+    const std::vector<ShadowRay> rays = ShadowRays(bvh, light, 200, 200);
+
+    long blocked = 0;
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    if (include_linear)
+    {
+        const double closest = Measure(repetitions, [&]()
+        {
+            for (const ShadowRay& ray : rays)
+                blocked += ClosestIntersection(ray.start, ray.direction, records).distance < 1.0f;
+        });
+        const double any = Measure(repetitions, [&]()
+        {
+            for (const ShadowRay& ray : rays)
+                blocked += Occluded(ray.start, ray.direction, 1.0f, records);
+        });
+
+        Report((prefix + " linear closest").c_str(), closest, rays.size(), "rays");
+        Report((prefix + " linear any-hit").c_str(), any,     rays.size(), "rays");
+    }
+
+    TraversalStatistics closest_statistics;
+    TraversalStatistics any_statistics;
+
+    const double closest = Measure(repetitions, [&]()
+    {
+        for (const ShadowRay& ray : rays)
+            blocked += ClosestIntersection(ray.start, ray.direction, bvh, &closest_statistics).distance < 1.0f;
+    });
+    const double any = Measure(repetitions, [&]()
+    {
+        for (const ShadowRay& ray : rays)
+            blocked += Occluded(ray.start, ray.direction, 1.0f, bvh, &any_statistics);
+    });
+
+    Report((prefix + " BVH closest").c_str(), closest, rays.size(), "rays");
+    Report((prefix + " BVH any-hit").c_str(), any,     rays.size(), "rays");
+    printf(
+        "%-48s %12.1f %12.1f  (checksum %ld)\n", "Nodes/ray closest vs any-hit",
+        closest_statistics.node_visits / double(closest_statistics.rays), any_statistics.node_visits / double(any_statistics.rays), blocked
+    );
+}
+
+
+// Traces the primary rays of a 'width' x 'height' view one at a time and in packets, as Draw does in either mode.
+void BenchmarkPackets(const char* name, const std::vector<Triangle>& model, const int width, const int height, const unsigned repetitions)
+{
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+    const float focal = width / 2.0f;
+
+    const BVH bvh = BuildBVH(model);
+
+    long checksum = 0;
+
+    const double single = Measure(repetitions, [&]()
+    {
+        for (int row = 0; row < height; ++row)
+            for (int column = 0; column < width; ++column)
+                checksum += ClosestIntersection(origin, glm::vec3(column - (width / 2.0f), row - (height / 2.0f), -focal), bvh).triangle_index;
+    });
+
+    const double packets = Measure(repetitions, [&]()
+    {
+        for (int row = 0; row < height; row += PACKET_HEIGHT)
+        {
+            for (int column = 0; column < width; column += PACKET_WIDTH)
+            {
+                glm::vec3 directions[PACKET_SIZE];
+                for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+                    directions[lane] = glm::vec3(column + lane % PACKET_WIDTH - (width / 2.0f), row + lane / PACKET_WIDTH - (height / 2.0f), -focal);
+
+                Intersection intersections[PACKET_SIZE];
+                ClosestIntersection(origin, directions, bvh, intersections);
+
+                for (const Intersection& intersection : intersections)
+                    checksum += intersection.triangle_index;
+            }
+        }
+    });
+
+    const double rays = width * height;
+    const std::string prefix = std::string(name) + " (" + std::to_string(model.size()) + " triangles)";
+
+    Report((prefix + " single").c_str(),                                         single,  rays, "rays");
+    Report((prefix + " packets of " + std::to_string(PACKET_SIZE)).c_str(),     packets, rays, "rays");
+    printf("%-48s %12.2fx  (checksum %ld)\n", "Speedup", single / packets, checksum);
+}
+
+
+int main()
+{
+    ReportHeader("ClosestIntersection");
+
+    BenchmarkClosestIntersection("Cornell box", LoadTestModel(),          300, 300, 5);
+    BenchmarkClosestIntersection("Random",      LoadRandomModel(1000),    100, 100, 3);
+    BenchmarkClosestIntersection("Random",      LoadRandomModel(10000),    50,  50, 3);
+
+    printf("\n---- BVH ----\n");
+
+    BenchmarkBVHScaling(200, 200);
+
+    ReportHeader("Shadow rays");
+
+    // Lab2's light, and one behind the random model so most of its shadow rays are blocked.
+    BenchmarkShadowRays("Cornell box", LoadTestModel(),         glm::vec3(0.0f, 0.0f,  1.0f), true,  20);
+    BenchmarkShadowRays("Random",      LoadRandomModel(100000), glm::vec3(0.0f, 0.0f, -2.0f), false, 5);
+
+    ReportHeader("Ray packets");
+
+    BenchmarkPackets("Cornell box", LoadTestModel(),         512, 512, 10);
+    BenchmarkPackets("Random",      LoadRandomModel(100000), 512, 512, 3);
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <ctime>
 #include <iomanip>
@@ -8,6 +10,7 @@
 #include <glm/glm.hpp>
 
 #include "debug.h"
+#include "utilities.h"
 
 const glm::vec4 BLACK ( 0.0f, 0.0f, 0.0f, 0.0f );
 const glm::vec4 GREY  ( 0.5f, 0.5f, 0.5f, 0.5f );
@@ -164,6 +167,33 @@ void Render(Window& window)
 }
 
 
+// The window's own pixel buffer, which Render uploads to the screen.
+Array2DView<Uint32> ScreenView(const Window& window)
+{
+    return { window.pixels, window.height, window.width, window.width };
+}
+
+// Direct access to the screen texture's memory, so a frame can be drawn without a copy through 'window.pixels'. The
+// contents are undefined until drawn, every pixel must be written. Call Present when done.
+Array2DView<Uint32> LockScreen(Window& window)
+{
+	void* pixels;
+	int   pitch;
+	Assert(SDL_LockTexture(window.screen, nullptr, &pixels, &pitch) == 0, "Error: %s", SDL_GetError());
+
+	return { static_cast<Uint32*>(pixels), window.height, window.width, static_cast<unsigned>(pitch / sizeof(Uint32)) };
+}
+
+// Unlocks the screen texture after LockScreen and shows it.
+void Present(Window& window)
+{
+	SDL_UnlockTexture(window.screen);
+
+	Assert(SDL_RenderCopy(window.renderer, window.screen, nullptr, nullptr) == 0, "Error: %s", SDL_GetError());
+	SDL_RenderPresent(window.renderer);
+}
+
+
 void ScreenShot(const Window& window, const std::string& filename)
 {
 	int width, height;
@@ -4,6 +4,8 @@
 // Defines a simple test model: The Cornel Box
 
 #include <glm/glm.hpp>
+#include <cmath>
+#include <random>
 #include <vector>
 
 // Used to describe a triangular surface:
@@ -185,4 +187,37 @@ std::vector<Triangle> LoadTestModel()
 	return triangles;
 }
 
+// Generates a soup of randomly oriented triangles spread over the same volume as the
+// Cornell Box. The triangles shrink as the count grows, so the total surface area (and
+// with it the number of triangles a ray passes through) stays roughly the same. The
+// same seed gives the same model.
+std::vector<Triangle> LoadRandomModel( unsigned count, unsigned seed = 0 )
+{
+	std::vector<Triangle> triangles;
+	triangles.reserve( count );
+
+	using glm::vec3;
+
+	std::mt19937 generator( seed );
+	std::uniform_real_distribution<float> unit( -1.0f, 1.0f );
+	std::uniform_real_distribution<float> channel( 0.15f, 0.75f );
+
+	const float size = 2.0f / std::sqrt( static_cast<float>( count ) );
+
+	for( unsigned i=0; i<count; ++i )
+	{
+		vec3 center( unit(generator), unit(generator), unit(generator) );
+
+		vec3 v0 = center + size * vec3( unit(generator), unit(generator), unit(generator) );
+		vec3 v1 = center + size * vec3( unit(generator), unit(generator), unit(generator) );
+		vec3 v2 = center + size * vec3( unit(generator), unit(generator), unit(generator) );
+
+		vec3 color( channel(generator), channel(generator), channel(generator) );
+
+		triangles.emplace_back( v0, v1, v2, color );
+	}
+
+	return triangles;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "light.h"
+
+
+// Views of the Cornell box (LoadTestModel) and a light for it, shared by the tests of Lab3's draws.
+
+// Inside the box, where walls go through the near plane and are clipped.
+Camera InsideCamera()
+{
+    Camera camera;
+    camera.position = glm::vec3(0.3f, 0.0f, 0.5f);
+    SetYaw(camera, 0.7f);
+    return camera;
+}
+
+// Near the middle of the box, a tenth as bright as the default light.
+Light TestLight()
+{
+    Light light;
+    light.position = glm::vec3(0.2f, -0.3f, 0.4f);
+    light.color    = glm::vec3(1.0f, 1.0f, 1.0f) * 1.4f;
+    return light;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+
+// Counts every heap allocation made through operator new, so a render loop can prove it doesn't allocate once it's
+// warmed up. Replaces the global operator new and delete, so include it in exactly one translation unit per
+// executable, and only in the ones that want the count (tests, benchmarks, Headless).
+//
+//     const uint64_t before = AllocationCount();
+//     Draw(...);
+//     Assert(AllocationCount() == before, "Draw allocated.");
+//
+// malloc isn't counted; nothing in the render loops calls it directly (AlignedAllocator goes through operator new).
+
+
+std::atomic<uint64_t> allocation_count {0};
+
+uint64_t AllocationCount()
+{
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+
+// None of these are inlined, or GCC pairs up the malloc and free inside them with the new- and delete-expressions
+// around them and warns about the mismatch.
+[[gnu::noinline]] void* CountedAllocate(const size_t size) noexcept
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+}
+
+[[gnu::noinline]] void* operator new(const size_t size)
+{
+    void* memory = CountedAllocate(size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+[[gnu::noinline]] void* operator new[](const size_t size)
+{
+    void* memory = CountedAllocate(size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+[[gnu::noinline]] void* operator new  (const size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size); }
+[[gnu::noinline]] void* operator new[](const size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size); }
+
+[[gnu::noinline]] void operator delete  (void* memory) noexcept                           { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory) noexcept                           { std::free(memory); }
+[[gnu::noinline]] void operator delete  (void* memory, size_t) noexcept                   { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory, size_t) noexcept                   { std::free(memory); }
+[[gnu::noinline]] void operator delete  (void* memory, const std::nothrow_t&) noexcept    { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory, const std::nothrow_t&) noexcept    { std::free(memory); }
@@ -0,0 +1,637 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "lab3.h"
+#include "hiz.h"
+#include "occlusion.h"
+#include "deferred.h"
+#include "varyings.h"
+#include "threadpool.h"
+
+
+// Lab3's rasterizer on many threads, sort-middle: every triangle is first transformed and sorted into bins by the
+// screen tiles its bounding box touches, then each tile is rasterized by a single thread. A thread owns the z-buffer
+// and framebuffer pixels of the tile it's working on, so the threads never share a pixel and need no locks.
+//
+// Each bin lists its triangles in model order, and RasterizeBlocks gives the same fragments for a pixel no matter which
+// viewport it's clipped to, so every pixel sees the same fragments in the same order as in Draw, and the image is the
+// same bit for bit.
+//
+// Every tile also keeps the hierarchical z-buffer of hiz.h over its pixels, and culls the triangles and blocks behind
+// what it has drawn so far. That doesn't change the image either, and neither does occlusion culling (see occlusion.h),
+// which skips the clusters of the mesh hidden behind its largest triangles before their vertices are transformed.
+//
+// With a depth pre-pass, DrawBinned rasterizes every tile twice: the first pass only fills the z-buffer, and the second
+// shades just the fragments whose depth is the one that's there, so every pixel is shaded once however many triangles
+// cover it.
+//
+// DrawBinnedLit draws the same way, but shades every fragment with PixelShader at the world position the varyings of
+// varyings.h give. DrawBinnedDeferred rasterizes the tiles into the G-buffer of deferred.h instead, and shades it
+// afterwards.
+//
+// Every draw is Bin, then one of the DrawBins functions on what it binned, so the two stages can also run on different
+// frames at once (see pipeline.h).
+
+
+// A triangle after the vertex stage, or a piece of one clipping has cut up, with everything the tiles need to draw it.
+struct ScreenTriangle
+{
+    static constexpr u32 WHOLE = ~0u;
+
+    RasterVertex p0, p1, p2;
+    u32          color;
+    u32          triangle;  // Its index in the mesh.
+    u32          piece;     // WHOLE, or the index of its barycentric coordinates in its batch's 'TileBins::pieces'.
+};
+
+// A triangle of a batch in a row of tiles: the tiles of the row from 'first_column' to 'last_column' it might cover.
+struct TileSpan
+{
+    u32 triangle;  // Its index in its batch's 'TileBins::triangles'.
+    u16 first_column;
+    u16 last_column;
+};
+
+// A triangle of a batch and the tiles it might cover, kept until every triangle of the batch is counted into the bins.
+struct BinnedTriangle
+{
+    u32 triangle;  // Its index in its batch's 'TileBins::triangles'.
+    u16 left;
+    u16 top;
+    u16 right;
+    u16 bottom;
+};
+
+inline bool IsEmpty(const AABB& bounds)
+{
+    return bounds.right < bounds.left or bounds.bottom < bounds.top;
+}
+
+
+// How many fragments the binned draws shaded, and over how many pixels. Without a depth pre-pass, DrawBinned shades
+// every fragment that's closer than what's been drawn so far, and overdraw makes that more than one a pixel.
+struct ShadingStats
+{
+    u64 pixels = 0;
+    u64 shaded = 0;
+};
+
+ShadingStats& operator+= (ShadingStats& total, const ShadingStats& stats)
+{
+    total.pixels += stats.pixels;
+    total.shaded += stats.shaded;
+    return total;
+}
+
+inline double ShadedPerPixel(const ShadingStats& stats)
+{
+    return stats.pixels > 0 ? static_cast<double>(stats.shaded) / static_cast<double>(stats.pixels) : 0.0;
+}
+
+
+struct TileBins
+{
+    static constexpr int      TILE_SIZE = 32;  // Pixels. A multiple of BLOCK_SIZE, so no block spans two tiles.
+    static constexpr unsigned BATCHES   = 64;  // Contiguous ranges of triangles binned in parallel, in order.
+
+    int tile_columns = 0;
+    int tile_rows    = 0;
+
+    // The triangles on screen of every batch, each once and in model order. Every batch has its own bins so the
+    // binning threads don't share them, and walking the batches in order keeps the triangles in model order.
+    //
+    // A triangle that might cover at most SMALL_TILES tiles is binned to each of them: tile 'tile' of batch 'batch' has
+    // 'tile_triangles[batch]' from 'tile_offsets[batch * (tile_count + 1) + tile]' up to the next tile's offset. A
+    // bigger one is binned to the rows of tiles it spans: row 'row' of batch 'batch' has 'spans[batch]' from
+    // 'span_offsets[batch * (tile_rows + 1) + row]' up to the next row's offset, and a tile skips the ones that don't
+    // reach its column. Binning every triangle to its tiles would take an entry for every tile a big one covers, and
+    // spanning every one would have a tile read past all the small ones of its row.
+    //
+    // Counted before they're filled, and never shrunk: once they've held the busiest view, no view makes them allocate.
+    static constexpr int SMALL_TILES = 4;
+
+    std::vector<ScreenTriangle> triangles[BATCHES];
+    std::vector<BinnedTriangle> small_triangles[BATCHES];
+    std::vector<BinnedTriangle> big_triangles[BATCHES];
+    std::vector<u32>            tile_triangles[BATCHES];
+    std::vector<u32>            tile_offsets;
+    std::vector<TileSpan>       spans[BATCHES];
+    std::vector<u32>            span_offsets;
+
+    // The model's vertices after the vertex stage, in the last frame.
+    VertexBuffer vertices;
+
+    // Whether the clusters of the mesh are occlusion culled before the vertex stage. Which ones were to be drawn in the
+    // last frame, which registers of vertices that took, and what was culled.
+    bool            occlusion_culling = false;
+    OcclusionBuffer occlusion_buffer;
+    std::vector<u8> visible_clusters;
+    std::vector<u8> needed_vertices;  // One per SIMD_WIDTH vertices.
+    ClusterStats    cluster_culling;
+
+    // What culling dropped from every batch in the last frame.
+    CullingStats batch_culling[BATCHES];
+
+    // The barycentric coordinates of the pieces of the triangles every batch has clipped, which only the lit and
+    // deferred draws need. Rare enough to be kept out of the bins.
+    std::vector<PieceBarycentrics> pieces[BATCHES];
+
+    // Over the z-buffer DrawBinned draws into, and what it culled in every tile in the last frame.
+    bool                        hierarchical_z = true;
+    HierarchicalZ               hiz;
+    std::vector<OcclusionStats> tile_stats;
+
+    // Whether DrawBinned and DrawBinnedLit fill the z-buffer in a pass of its own before shading, and how much was
+    // shaded in every tile in the last frame.
+    bool                      depth_prepass = false;
+    std::vector<ShadingStats> tile_shading;
+};
+
+static_assert(TileBins::TILE_SIZE % BLOCK_SIZE == 0, "Tiles must be made of whole blocks.");
+static_assert(TileBins::TILE_SIZE % HierarchicalZ::GROUP_PIXELS == 0, "Tiles must be made of whole groups of blocks.");
+
+inline int TileCount(const TileBins& bins)
+{
+    return bins.tile_columns * bins.tile_rows;
+}
+
+// The pixels of 'tile', clipped to the viewport.
+inline Viewport TileViewport(const TileBins& bins, const Viewport& viewport, const int tile)
+{
+    const int left = viewport.left + (tile % bins.tile_columns) * TileBins::TILE_SIZE;
+    const int top  = viewport.top  + (tile / bins.tile_columns) * TileBins::TILE_SIZE;
+
+    return { left, top, std::min(left + TileBins::TILE_SIZE, viewport.right), std::min(top + TileBins::TILE_SIZE, viewport.bottom) };
+}
+
+
+// Turns the counts in 'offsets[1]' to 'offsets[count]' into where each of the 'count' ranges they count starts, one
+// place up, and returns their total. Putting every entry at 'offsets[range + 1]++' then leaves 'offsets[range]' where
+// the range starts and 'offsets[range + 1]' where it ends.
+inline u32 RangeStarts(u32* offsets, const unsigned count)
+{
+    u32 start = 0;
+    for (unsigned range = 0; range < count; ++range)
+    {
+        const u32 range_count = offsets[range + 1];
+        offsets[range + 1] = start;
+        start += range_count;
+    }
+    return start;
+}
+
+// Runs the vertex stage on every vertex of the mesh, then culls the triangles the camera can't see and sorts the ones
+// on screen into the tiles they might cover.
+void Bin(
+        const Camera& camera, const Viewport& viewport, const Mesh& mesh,
+        ThreadPool& pool, TileBins& bins
+)
+{
+    bins.tile_columns = (viewport.right  - viewport.left + TileBins::TILE_SIZE - 1) / TileBins::TILE_SIZE;
+    bins.tile_rows    = (viewport.bottom - viewport.top  + TileBins::TILE_SIZE - 1) / TileBins::TILE_SIZE;
+
+    const unsigned tile_rows  = static_cast<unsigned>(bins.tile_rows);
+    const unsigned tile_count = static_cast<unsigned>(bins.tile_columns) * tile_rows;
+    const unsigned count      = TriangleCount(mesh);
+    const unsigned batch_size = (count + TileBins::BATCHES - 1) / TileBins::BATCHES;
+
+    bins.tile_offsets.resize(TileBins::BATCHES * (tile_count + 1));
+    bins.span_offsets.resize(TileBins::BATCHES * (tile_rows + 1));
+
+    // Every vertex once, before any triangle needs it. In whole registers, so every batch starts on one.
+    Resize(bins.vertices, mesh);
+
+    const unsigned padded_vertices = static_cast<unsigned>(mesh.positions[0].size());
+    const unsigned vertex_batch    = ((padded_vertices / SIMD_WIDTH + TileBins::BATCHES - 1) / TileBins::BATCHES) * SIMD_WIDTH;
+
+    // With occlusion culling, only the registers with vertices of the clusters that are left.
+    if (bins.occlusion_culling)
+    {
+        bins.cluster_culling = CullClusters(camera, viewport, mesh, pool, bins.occlusion_buffer, bins.visible_clusters);
+
+        bins.needed_vertices.assign(padded_vertices / SIMD_WIDTH, false);
+        for (u32 cluster = 0; cluster < mesh.clusters.size(); ++cluster)
+            if (bins.visible_clusters[cluster])
+                std::fill(&bins.needed_vertices[mesh.clusters[cluster].first_vertex / SIMD_WIDTH],
+                          &bins.needed_vertices[(mesh.clusters[cluster].last_vertex - 1) / SIMD_WIDTH] + 1, true);
+    }
+    else
+    {
+        bins.cluster_culling = ClusterStats();
+    }
+
+    ParallelFor(pool, TileBins::BATCHES, [&](const unsigned batch, unsigned)
+    {
+        const unsigned first = std::min(batch * vertex_batch, padded_vertices);
+        const unsigned last  = std::min(first + vertex_batch, padded_vertices);
+
+        if (not bins.occlusion_culling)
+        {
+            TransformVertices(camera, viewport, mesh, bins.vertices, first, last);
+            return;
+        }
+
+        // In runs of needed registers.
+        for (unsigned run = first; run < last; )
+        {
+            if (not bins.needed_vertices[run / SIMD_WIDTH])
+            {
+                run += SIMD_WIDTH;
+                continue;
+            }
+
+            unsigned end = run;
+            while (end < last and bins.needed_vertices[end / SIMD_WIDTH])
+                end += SIMD_WIDTH;
+
+            TransformVertices(camera, viewport, mesh, bins.vertices, run, end);
+            run = end;
+        }
+    });
+
+    ParallelFor(pool, TileBins::BATCHES, [&](const unsigned batch, unsigned)
+    {
+        const unsigned first = std::min(batch * batch_size, count);
+        const unsigned last  = std::min(first + batch_size, count);
+
+        std::vector<ScreenTriangle>& triangles = bins.triangles[batch];
+        triangles.clear();
+
+        std::vector<BinnedTriangle>& small_triangles = bins.small_triangles[batch];
+        std::vector<BinnedTriangle>& big_triangles   = bins.big_triangles[batch];
+        small_triangles.clear();
+        big_triangles.clear();
+
+        u32* tile_offsets = &bins.tile_offsets[batch * (tile_count + 1)];
+        u32* span_offsets = &bins.span_offsets[batch * (tile_rows + 1)];
+        std::fill(tile_offsets, tile_offsets + tile_count + 1, 0u);
+        std::fill(span_offsets, span_offsets + tile_rows + 1, 0u);
+
+        CullingStats& culling = bins.batch_culling[batch];
+        culling = CullingStats();
+
+        std::vector<PieceBarycentrics>& pieces = bins.pieces[batch];
+        pieces.clear();
+
+        ClippedPolygon polygon;
+
+        // The cluster of the first triangle, and then of every next one.
+        auto cluster = std::upper_bound(mesh.clusters.begin(), mesh.clusters.end(), first,
+            [](const unsigned triangle, const Cluster& c) { return triangle < c.first_triangle; }) - 1;
+
+        for (unsigned i = first; i < last; ++i)
+        {
+            if (bins.occlusion_culling)
+            {
+                while (cluster->last_triangle <= i)
+                    ++cluster;
+
+                if (not bins.visible_clusters[static_cast<size_t>(cluster - mesh.clusters.begin())])
+                {
+                    culling.submitted += 1;
+                    culling.occluded  += 1;
+                    continue;
+                }
+            }
+
+            if (not VisibleTriangle(camera, viewport, mesh, bins.vertices, i, culling, polygon))
+                continue;
+
+            for (u32 piece = 0; piece < PieceCount(polygon); ++piece)
+            {
+                const RasterVertex& p0 = polygon.vertices[0];
+                const RasterVertex& p1 = polygon.vertices[piece + 1];
+                const RasterVertex& p2 = polygon.vertices[piece + 2];
+
+                // The same box the rasterizers walk.
+                const AABB bounds = PixelBounds(viewport, p0, p1, p2);
+
+                if (IsEmpty(bounds))
+                    continue;
+
+                ScreenTriangle screen_triangle { p0, p1, p2, mesh.colors[i], i, ScreenTriangle::WHOLE };
+                if (polygon.clipped)
+                {
+                    screen_triangle.piece = static_cast<u32>(pieces.size());
+                    pieces.push_back(Barycentrics(polygon, piece));
+                }
+
+                const int tile_left   = (bounds.left   - viewport.left) / TileBins::TILE_SIZE;
+                const int tile_right  = (bounds.right  - viewport.left) / TileBins::TILE_SIZE;
+                const int tile_top    = (bounds.top    - viewport.top)  / TileBins::TILE_SIZE;
+                const int tile_bottom = (bounds.bottom - viewport.top)  / TileBins::TILE_SIZE;
+
+                // Counted here, binned once all of them are.
+                const BinnedTriangle binned { static_cast<u32>(triangles.size()),
+                                              static_cast<u16>(tile_left),  static_cast<u16>(tile_top),
+                                              static_cast<u16>(tile_right), static_cast<u16>(tile_bottom) };
+                triangles.push_back(screen_triangle);
+
+                if ((tile_right - tile_left + 1) * (tile_bottom - tile_top + 1) <= TileBins::SMALL_TILES)
+                {
+                    small_triangles.push_back(binned);
+                    for (int tile_row = tile_top; tile_row <= tile_bottom; ++tile_row)
+                        for (int tile_column = tile_left; tile_column <= tile_right; ++tile_column)
+                            tile_offsets[tile_row * bins.tile_columns + tile_column + 1] += 1;
+                }
+                else
+                {
+                    big_triangles.push_back(binned);
+                    for (int tile_row = tile_top; tile_row <= tile_bottom; ++tile_row)
+                        span_offsets[tile_row + 1] += 1;
+                }
+            }
+        }
+
+        // Then every one after the ones before it in its tiles or rows, in bins only ever grown to what's needed.
+        const u32 tile_entries = RangeStarts(tile_offsets, tile_count);
+        const u32 span_entries = RangeStarts(span_offsets, tile_rows);
+
+        if (bins.tile_triangles[batch].size() < tile_entries)
+            bins.tile_triangles[batch].resize(tile_entries);
+        if (bins.spans[batch].size() < span_entries)
+            bins.spans[batch].resize(span_entries);
+
+        const unsigned tile_columns   = static_cast<unsigned>(bins.tile_columns);
+        u32*           tile_triangles = bins.tile_triangles[batch].data();
+        for (const BinnedTriangle& small : small_triangles)
+            for (unsigned tile_row = small.top; tile_row <= small.bottom; ++tile_row)
+                for (unsigned tile_column = small.left; tile_column <= small.right; ++tile_column)
+                    tile_triangles[tile_offsets[tile_row * tile_columns + tile_column + 1]++] = small.triangle;
+
+        TileSpan* spans = bins.spans[batch].data();
+        for (const BinnedTriangle& big : big_triangles)
+            for (unsigned tile_row = big.top; tile_row <= big.bottom; ++tile_row)
+                spans[span_offsets[tile_row + 1]++] = { big.triangle, big.left, big.right };
+    });
+}
+
+// What culling dropped in the last frame, over all batches.
+CullingStats Culling(const TileBins& bins)
+{
+    CullingStats total;
+    for (const CullingStats& stats : bins.batch_culling)
+        total += stats;
+
+    return total;
+}
+
+// What the hierarchical z-buffer culled in the last frame, over all tiles.
+OcclusionStats Occlusion(const TileBins& bins)
+{
+    OcclusionStats total;
+    for (const OcclusionStats& stats : bins.tile_stats)
+        total += stats;
+
+    return total;
+}
+
+// What the last binned draw shaded, over all tiles.
+ShadingStats Shading(const TileBins& bins)
+{
+    ShadingStats total;
+    for (const ShadingStats& stats : bins.tile_shading)
+        total += stats;
+
+    return total;
+}
+
+// Runs 'draw_tile(tile, tile_viewport, stats)' for every tile on the pool, after resetting the tile's cells of the
+// hierarchical z-buffer and its OcclusionStats 'stats'.
+template <typename DrawTile>
+void ForEachTile(
+        const Camera& camera, const Viewport& viewport, ThreadPool& pool, TileBins& bins, const DrawTile& draw_tile
+)
+{
+    // The tiles and the hierarchical z-buffer are on grids from (0, 0), and every tile must own its cells.
+    Assert(viewport.left % TileBins::TILE_SIZE == 0 and viewport.top % TileBins::TILE_SIZE == 0,
+        "The viewport (%i, %i) doesn't start on the tile grid.", viewport.left, viewport.top);
+
+    const unsigned tile_count = static_cast<unsigned>(TileCount(bins));
+
+    Resize(bins.hiz, viewport);
+    bins.tile_stats.resize(tile_count);
+    bins.tile_shading.resize(tile_count);
+
+    ParallelFor(pool, tile_count, [&](const unsigned tile, unsigned)
+    {
+        const Viewport tile_viewport = TileViewport(bins, viewport, static_cast<int>(tile));
+
+        OcclusionStats& stats = bins.tile_stats[tile];
+        stats = OcclusionStats();
+        Fill(bins.hiz, tile_viewport, FarDepth(camera));
+
+        draw_tile(tile, tile_viewport, stats);
+    });
+}
+
+// Rasterizes the triangles binned to 'tile', in order, with the fragment functors 'fragment_for(triangle, batch)' gives,
+// and 'occlusion' when the hierarchical z-buffer is on.
+template <typename FragmentFor>
+void RasterizeTile(
+        const TileBins& bins, const unsigned tile, const Viewport& tile_viewport, const HierarchicalZTest& occlusion,
+        const FragmentFor& fragment_for
+)
+{
+    const unsigned row        = tile / static_cast<unsigned>(bins.tile_columns);
+    const unsigned column     = tile % static_cast<unsigned>(bins.tile_columns);
+    const unsigned tile_count = static_cast<unsigned>(bins.tile_columns * bins.tile_rows);
+
+    for (unsigned batch = 0; batch < TileBins::BATCHES; ++batch)
+    {
+        const u32* tile_offsets = &bins.tile_offsets[batch * (tile_count + 1) + tile];
+        const u32* small        = &bins.tile_triangles[batch][tile_offsets[0]];
+        const u32  small_count  = tile_offsets[1] - tile_offsets[0];
+
+        const u32*      span_offsets = &bins.span_offsets[batch * static_cast<unsigned>(bins.tile_rows + 1) + row];
+        const TileSpan* spans        = bins.spans[batch].data() + span_offsets[0];
+        const u32       span_count   = span_offsets[1] - span_offsets[0];
+
+        // The small triangles and the spans that reach the column, both in model order, merged.
+        u32 next_small = 0;
+        u32 next_span  = 0;
+        while (true)
+        {
+            while (next_span < span_count and (column < spans[next_span].first_column or spans[next_span].last_column < column))
+                ++next_span;
+
+            u32 index;
+            if (next_small < small_count and (next_span == span_count or small[next_small] < spans[next_span].triangle))
+                index = small[next_small++];
+            else if (next_span < span_count)
+                index = spans[next_span++].triangle;
+            else
+                break;
+
+            const ScreenTriangle& triangle = bins.triangles[batch][index];
+            const auto fragment = fragment_for(triangle, batch);
+            if (bins.hierarchical_z)
+                RasterizeBlocks(tile_viewport, triangle.p0, triangle.p1, triangle.p2, fragment, occlusion);
+            else
+                RasterizeBlocks(tile_viewport, triangle.p0, triangle.p1, triangle.p2, fragment);
+        }
+    }
+}
+
+// The barycentric coordinates of 'triangle' of 'batch' at its vertices.
+inline PieceBarycentrics Piece(const TileBins& bins, const ScreenTriangle& triangle, const unsigned batch)
+{
+    return triangle.piece == ScreenTriangle::WHOLE ? WholeTriangle() : bins.pieces[batch][triangle.piece];
+}
+
+// The tiles of DrawBinned and DrawBinnedLit: clears, rasterizes and depth tests one tile per task, with the fragment
+// functors 'closer_for(triangle, batch, shaded)' gives. With 'bins.depth_prepass', every tile is rasterized twice: once
+// for the depths alone, then again with 'equal_for(triangle, batch, shaded)' to shade only the fragments that ended up
+// in front.
+template <typename CloserFor, typename EqualFor>
+void DrawTiles(
+        const Camera& camera, const Viewport& viewport, ThreadPool& pool, TileBins& bins,
+        Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer, const CloserFor& closer_for, const EqualFor& equal_for
+)
+{
+    const f32 far_depth = FarDepth(camera);
+
+    ForEachTile(camera, viewport, pool, bins, [&](const unsigned tile, const Viewport& tile_viewport, OcclusionStats& stats)
+    {
+        for (int y = tile_viewport.top; y < tile_viewport.bottom; ++y)
+        {
+            for (int x = tile_viewport.left; x < tile_viewport.right; ++x)
+            {
+                z_buffer(y, x)    = far_depth;
+                framebuffer(y, x) = 0;
+            }
+        }
+
+        ShadingStats& shading = bins.tile_shading[tile];
+        shading.pixels = static_cast<u64>(tile_viewport.right - tile_viewport.left) * static_cast<u64>(tile_viewport.bottom - tile_viewport.top);
+        shading.shaded = 0;
+
+        if (not bins.depth_prepass)
+        {
+            RasterizeTile(bins, tile, tile_viewport, HierarchicalZTest { bins.hiz, z_buffer, stats },
+                [&](const ScreenTriangle& triangle, const unsigned batch)
+                {
+                    return closer_for(triangle, batch, &shading.shaded);
+                });
+            return;
+        }
+
+        RasterizeTile(bins, tile, tile_viewport, HierarchicalZTest { bins.hiz, z_buffer, stats },
+            [&](const ScreenTriangle&, unsigned)
+            {
+                return DepthOnlyFragment { z_buffer };
+            });
+        RasterizeTile(bins, tile, tile_viewport, HierarchicalZTest { bins.hiz, z_buffer, stats, true },
+            [&](const ScreenTriangle& triangle, const unsigned batch)
+            {
+                return equal_for(triangle, batch, &shading.shaded);
+            });
+    });
+}
+
+// Draws the tiles of what Bin binned, flat shaded (see DrawTiles). 'camera' is the one it was binned with.
+void DrawBins(
+        const Camera& camera, const Viewport& viewport,
+        ThreadPool& pool, TileBins& bins, Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer
+)
+{
+    DrawTiles(camera, viewport, pool, bins, z_buffer, framebuffer,
+        [&](const ScreenTriangle& triangle, unsigned, u64* shaded)
+        {
+            return DepthTestFragment { z_buffer, framebuffer, triangle.color, shaded };
+        },
+        [&](const ScreenTriangle& triangle, unsigned, u64* shaded)
+        {
+            return DepthEqualFragment { z_buffer, framebuffer, triangle.color, shaded };
+        });
+}
+
+// DrawBins, lit by 'light' as DrawLit.
+void DrawBinsLit(
+        const Camera& camera, const Light& light, const Viewport& viewport, const Mesh& mesh,
+        ThreadPool& pool, TileBins& bins, Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer,
+        const ShadowMap* shadows = nullptr
+)
+{
+    DrawTiles(camera, viewport, pool, bins, z_buffer, framebuffer,
+        [&](const ScreenTriangle& triangle, const unsigned batch, u64* shaded)
+        {
+            return LitFragmentFor<false>(mesh, light, triangle.triangle, triangle.p0, triangle.p1, triangle.p2,
+                                         Piece(bins, triangle, batch), z_buffer, framebuffer, shaded, shadows);
+        },
+        [&](const ScreenTriangle& triangle, const unsigned batch, u64* shaded)
+        {
+            return LitFragmentFor<true>(mesh, light, triangle.triangle, triangle.p0, triangle.p1, triangle.p2,
+                                        Piece(bins, triangle, batch), z_buffer, framebuffer, shaded, shadows);
+        });
+}
+
+// Rasterizes what Bin binned one tile per task into 'gbuffer', then shades it, as DrawDeferred.
+void DrawBinsDeferred(
+        const Camera& camera, const Light& light, const Viewport& viewport, const Mesh& mesh,
+        ThreadPool& pool, TileBins& bins, GBuffer& gbuffer, const Array2DView<u32>& framebuffer,
+        const ShadowMap* shadows = nullptr
+)
+{
+    Resize(gbuffer, viewport);
+
+    const f32 far_depth = FarDepth(camera);
+
+    ForEachTile(camera, viewport, pool, bins, [&](const unsigned tile, const Viewport& tile_viewport, OcclusionStats& stats)
+    {
+        Clear(gbuffer, tile_viewport, far_depth);
+
+        RasterizeTile(bins, tile, tile_viewport, HierarchicalZTest { bins.hiz, gbuffer.depths, stats },
+            [&](const ScreenTriangle& triangle, const unsigned batch)
+            {
+                return GBufferFragment(gbuffer, triangle.triangle, triangle.p0, triangle.p1, triangle.p2, Piece(bins, triangle, batch));
+            });
+
+        // Shade runs PixelShader once for every pixel with a triangle.
+        ShadingStats& shading = bins.tile_shading[tile];
+        shading.pixels = static_cast<u64>(tile_viewport.right - tile_viewport.left) * static_cast<u64>(tile_viewport.bottom - tile_viewport.top);
+        shading.shaded = 0;
+        for (int y = tile_viewport.top; y < tile_viewport.bottom; ++y)
+            for (int x = tile_viewport.left; x < tile_viewport.right; ++x)
+                shading.shaded += gbuffer.triangles(y, x) != GBuffer::NO_TRIANGLE;
+    });
+
+    Shade(light, viewport, mesh, gbuffer, pool, framebuffer, shadows);
+}
+
+
+// Draw, on the pool: bins the mesh, then draws the tiles (see DrawTiles).
+void DrawBinned(
+        const Camera& camera, const Viewport& viewport, const Mesh& mesh,
+        ThreadPool& pool, TileBins& bins, Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer
+)
+{
+    Bin(camera, viewport, mesh, pool, bins);
+    DrawBins(camera, viewport, pool, bins, z_buffer, framebuffer);
+}
+
+// DrawLit, on the pool: bins the mesh, then draws the tiles (see DrawTiles), lit by 'light'.
+void DrawBinnedLit(
+        const Camera& camera, const Light& light, const Viewport& viewport, const Mesh& mesh,
+        ThreadPool& pool, TileBins& bins, Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer,
+        const ShadowMap* shadows = nullptr
+)
+{
+    Bin(camera, viewport, mesh, pool, bins);
+    DrawBinsLit(camera, light, viewport, mesh, pool, bins, z_buffer, framebuffer, shadows);
+}
+
+// DrawDeferred, on the pool: bins the mesh, rasterizes one tile per task into 'gbuffer', then shades it.
+void DrawBinnedDeferred(
+        const Camera& camera, const Light& light, const Viewport& viewport, const Mesh& mesh,
+        ThreadPool& pool, TileBins& bins, GBuffer& gbuffer, const Array2DView<u32>& framebuffer,
+        const ShadowMap* shadows = nullptr
+)
+{
+    Bin(camera, viewport, mesh, pool, bins);
+    DrawBinsDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, framebuffer, shadows);
+}
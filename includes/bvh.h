@@ -0,0 +1,472 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "TestModel.h"
+#include "raytracer.h"
+#include "simd.h"
+#include "soa.h"
+
+
+// Bounding volume hierarchy over the triangles of a model.
+//
+// Built top-down with the surface area heuristic (SAH), evaluated over a fixed number of bins along the longest axis
+// of the centroids instead of at every triangle. The nodes are stored depth-first in one array, so the first child of
+// an inner node is always the next node and only the second child's index needs to be stored.
+// https://www.pbr-book.org/3ed-2018/Primitives_and_Intersection_Acceleration/Bounding_Volume_Hierarchies
+// http://www.sci.utah.edu/~wald/Publications/2007/ParallelBVHBuild/fastbuild.pdf
+//
+// The triangles are stored as TriangleLanes (see soa.h), with every leaf starting at a multiple of SIMD_WIDTH, so a
+// ray tests a whole leaf in one or two SIMD iterations.
+
+
+struct Bounds
+{
+    glm::vec3 min = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+};
+
+inline void Grow(Bounds& bounds, const glm::vec3& point)
+{
+    bounds.min = glm::min(bounds.min, point);
+    bounds.max = glm::max(bounds.max, point);
+}
+
+inline void Grow(Bounds& bounds, const Bounds& other)
+{
+    bounds.min = glm::min(bounds.min, other.min);
+    bounds.max = glm::max(bounds.max, other.max);
+}
+
+inline float SurfaceArea(const Bounds& bounds)
+{
+    const glm::vec3 size = bounds.max - bounds.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+
+struct BVHNode
+{
+    Bounds bounds;
+
+    uint32_t offset;  // Leaf: index of the first triangle, a multiple of SIMD_WIDTH. Inner node: index of the second child.
+    uint16_t count;   // Number of triangles in a leaf. 0 for inner nodes.
+    uint16_t axis;    // The axis an inner node was split along.
+};
+
+struct BVH
+{
+    static constexpr unsigned BIN_COUNT         = 16;
+    static constexpr unsigned MAX_LEAF_SIZE     = 8;
+    static constexpr unsigned MAX_DEPTH         = 64;   // Also bounds the size of the traversal stack.
+    static constexpr float    TRAVERSAL_COST    = 1.0f;
+    static constexpr float    INTERSECTION_COST = 1.0f;
+
+    std::vector<BVHNode> nodes;
+    TriangleLanes        triangles;  // Ordered so every leaf references a contiguous range.
+    std::vector<int>     indices;    // Index in the original model of each entry in 'triangles', -1 for padding.
+};
+
+// How much work the traversal did. Compare 'triangle_tests' against the triangle count to check that a query is
+// sub-linear.
+struct TraversalStatistics
+{
+    uint64_t rays           = 0;
+    uint64_t node_visits    = 0;
+    uint64_t triangle_tests = 0;
+};
+
+
+// Triangles are intersected SIMD_WIDTH at a time, so the SAH counts the cost of intersecting 'count' triangles in
+// blocks: filling up the last register of a leaf is free.
+inline float Blocks(const uint32_t count)
+{
+    return static_cast<float>((count + SIMD_WIDTH - 1) / SIMD_WIDTH);
+}
+
+
+// The most triangles a node at 'depth' can hold and still have every leaf under it fit a BVHNode's count, even the
+// ones MAX_DEPTH forces, when it and every node under it is split in the middle.
+inline uint64_t MaxNodeTriangles(const unsigned depth)
+{
+    const unsigned levels = BVH::MAX_DEPTH - 1 - depth;
+    return static_cast<uint64_t>(std::numeric_limits<uint16_t>::max()) << std::min(levels, 32u);
+}
+
+
+struct BVHBuilder
+{
+    std::vector<Bounds>    bounds;     // Bounds of each triangle.
+    std::vector<glm::vec3> centroids;  // Centroid of each triangle.
+    std::vector<uint32_t>  order;      // Triangle indices, partitioned as the nodes are built.
+    std::vector<BVHNode>   nodes;
+};
+
+uint32_t BuildBVHNode(BVHBuilder& builder, const uint32_t first, const uint32_t count, const unsigned depth)
+{
+    constexpr unsigned BIN_COUNT = BVH::BIN_COUNT;
+
+    const uint32_t node_index = static_cast<uint32_t>(builder.nodes.size());
+    builder.nodes.emplace_back();
+
+    Bounds bounds;
+    Bounds centroid_bounds;
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        Grow(bounds,          builder.bounds[builder.order[i]]);
+        Grow(centroid_bounds, builder.centroids[builder.order[i]]);
+    }
+
+    builder.nodes[node_index].bounds = bounds;
+
+    const auto MakeLeaf = [&]() -> uint32_t
+    {
+        builder.nodes[node_index].offset = first;
+        builder.nodes[node_index].count  = static_cast<uint16_t>(count);
+        builder.nodes[node_index].axis   = 0;
+        return node_index;
+    };
+
+    if (count <= 2 or depth + 1 >= BVH::MAX_DEPTH)
+        return MakeLeaf();
+
+    const glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+
+    unsigned axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    uint32_t middle = first + count / 2;
+
+    if (extent[axis] > 0.0f)
+    {
+        // Put the centroids into equally sized bins along the axis.
+        const float scale = BIN_COUNT / extent[axis];
+        const auto  Bin   = [&](const uint32_t triangle) -> unsigned
+        {
+            const unsigned bin = static_cast<unsigned>((builder.centroids[triangle][axis] - centroid_bounds.min[axis]) * scale);
+            return std::min(bin, BIN_COUNT - 1);
+        };
+
+        Bounds   bin_bounds[BIN_COUNT];
+        uint32_t bin_counts[BIN_COUNT] = {};
+
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            const unsigned bin = Bin(builder.order[i]);
+            Grow(bin_bounds[bin], builder.bounds[builder.order[i]]);
+            bin_counts[bin] += 1;
+        }
+
+        // Sweep from the right to get the area and count of everything to the right of each split...
+        float    right_areas [BIN_COUNT];
+        uint32_t right_counts[BIN_COUNT];
+
+        Bounds   right_bounds;
+        uint32_t right_count = 0;
+        for (unsigned bin = BIN_COUNT - 1; bin > 0; --bin)
+        {
+            Grow(right_bounds, bin_bounds[bin]);
+            right_count += bin_counts[bin];
+
+            right_areas [bin] = SurfaceArea(right_bounds);
+            right_counts[bin] = right_count;
+        }
+
+        // ... and from the left to evaluate the cost of splitting between bin - 1 and bin.
+        float    best_cost = std::numeric_limits<float>::max();
+        unsigned best_bin  = 0;
+
+        Bounds   left_bounds;
+        uint32_t left_count = 0;
+        for (unsigned bin = 1; bin < BIN_COUNT; ++bin)
+        {
+            Grow(left_bounds, bin_bounds[bin - 1]);
+            left_count += bin_counts[bin - 1];
+
+            if (left_count == 0 or right_counts[bin] == 0)
+                continue;
+
+            const float cost = SurfaceArea(left_bounds) * Blocks(left_count) + right_areas[bin] * Blocks(right_counts[bin]);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_bin  = bin;
+            }
+        }
+
+        const float leaf_cost  = BVH::INTERSECTION_COST * Blocks(count);
+        const float split_cost = BVH::TRAVERSAL_COST + BVH::INTERSECTION_COST * best_cost / SurfaceArea(bounds);
+
+        if (count <= BVH::MAX_LEAF_SIZE and leaf_cost <= split_cost)
+            return MakeLeaf();
+
+        // All centroids can't end up in the same bin as the extent is non-zero, so a split always exists.
+        const auto split = std::partition(
+                builder.order.begin() + first, builder.order.begin() + first + count,
+                [&](const uint32_t triangle) { return Bin(triangle) < best_bin; }
+        );
+        middle = static_cast<uint32_t>(split - builder.order.begin());
+
+        // Too lopsided to fit the bigger side into leaves before MAX_DEPTH: split in the middle along the axis instead.
+        if (std::max(middle - first, first + count - middle) > MaxNodeTriangles(depth + 1))
+        {
+            middle = first + count / 2;
+            std::nth_element(
+                    builder.order.begin() + first, builder.order.begin() + middle, builder.order.begin() + first + count,
+                    [&](const uint32_t a, const uint32_t b) { return builder.centroids[a][axis] < builder.centroids[b][axis]; }
+            );
+        }
+    }
+    else if (count <= BVH::MAX_LEAF_SIZE)
+    {
+        return MakeLeaf();
+    }
+    // Else all centroids are at the same point, and any split is as good as another. Split in the middle.
+
+    BuildBVHNode(builder, first, middle - first, depth + 1);
+    const uint32_t second_child = BuildBVHNode(builder, middle, first + count - middle, depth + 1);
+
+    builder.nodes[node_index].offset = second_child;
+    builder.nodes[node_index].count  = 0;
+    builder.nodes[node_index].axis   = static_cast<uint16_t>(axis);
+
+    return node_index;
+}
+
+BVH BuildBVH(const std::vector<Triangle>& triangles)
+{
+    const uint32_t count = static_cast<uint32_t>(triangles.size());
+
+    BVHBuilder builder;
+    builder.bounds.resize(count);
+    builder.centroids.resize(count);
+    builder.order.resize(count);
+    builder.nodes.reserve(2 * count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Grow(builder.bounds[i], triangles[i].v0);
+        Grow(builder.bounds[i], triangles[i].v1);
+        Grow(builder.bounds[i], triangles[i].v2);
+
+        builder.centroids[i] = (triangles[i].v0 + triangles[i].v1 + triangles[i].v2) / 3.0f;
+        builder.order[i]     = i;
+    }
+
+    if (count > 0)
+        BuildBVHNode(builder, 0, count, 0);
+
+    BVH bvh;
+    bvh.nodes = std::move(builder.nodes);
+    Reserve(bvh.triangles, count + count / 2);
+    bvh.indices.reserve(count + count / 2);
+
+    // The leaves come in the same order as their ranges in 'builder.order', each padded to start on a full SIMD
+    // register.
+    for (BVHNode& node : bvh.nodes)
+    {
+        if (node.count == 0)
+            continue;
+
+        const uint32_t first = node.offset;
+        node.offset = Size(bvh.triangles);
+
+        for (uint32_t i = first; i < first + node.count; ++i)
+        {
+            Append(bvh.triangles, TriangleRecord(triangles[builder.order[i]]));
+            bvh.indices.push_back(static_cast<int>(builder.order[i]));
+        }
+
+        Pad(bvh.triangles);
+        bvh.indices.resize(Size(bvh.triangles), -1);
+    }
+
+    return bvh;
+}
+
+
+// Slab test. Returns the distance to where the ray enters the box, or infinity if it misses it or the box lies
+// entirely beyond 't_max'.
+[[gnu::hot]] inline
+float IntersectBounds(const Bounds& bounds, const glm::vec3& start, const glm::vec3& inverse_direction, const float t_max)
+{
+    using namespace glm;
+
+    const vec3 t0 = (bounds.min - start) * inverse_direction;
+    const vec3 t1 = (bounds.max - start) * inverse_direction;
+
+    const vec3 near = min(t0, t1);
+    const vec3 far  = max(t0, t1);
+
+    const float entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    const float exit  = std::min(std::min(far.x,  far.y),  std::min(far.z,  t_max));
+
+    return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+
+// Same result as the linear scan, with 'triangle_index' referring to the original model.
+[[gnu::hot]]
+Intersection ClosestIntersection(
+        const glm::vec3& start, const glm::vec3& direction, const BVH& bvh,
+        TraversalStatistics* statistics = nullptr
+)
+{
+    using namespace glm;
+
+    if (bvh.nodes.empty())
+        return {};
+
+    const vec3 inverse_direction = 1.0f / direction;
+
+    float closest_t     = std::numeric_limits<float>::max();
+    int   closest_index = -1;
+
+    uint64_t node_visits    = 0;
+    uint64_t triangle_tests = 0;
+
+    uint32_t stack[BVH::MAX_DEPTH + 1];
+    unsigned stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        const uint32_t node_index = stack[--stack_size];
+        const BVHNode& node = bvh.nodes[node_index];
+
+        node_visits += 1;
+
+        // Checked when popped rather than when pushed, so nodes behind a hit found in the meantime are skipped.
+        if (IntersectBounds(node.bounds, start, inverse_direction, closest_t) == std::numeric_limits<float>::infinity())
+            continue;
+
+        if (node.count > 0)
+        {
+            triangle_tests += node.count;
+
+            for (uint32_t first = node.offset; first < node.offset + node.count; first += SIMD_WIDTH)
+            {
+                const SimdFloat t = Intersect(bvh.triangles, first, start, direction);
+
+                unsigned hits = MoveMask((t >= SimdFloat(0.0f)) & (t <= SimdFloat(closest_t)));
+                if (hits == 0)
+                    continue;
+
+                alignas(32) float t_lanes[SIMD_WIDTH];
+                StoreU(t_lanes, t);
+
+                // Ties go to the lowest index in the model, so the result is the same as the linear scan's, no
+                // matter in which order the leaves are visited.
+                for (unsigned lane = 0; hits != 0; ++lane, hits >>= 1)
+                {
+                    const uint32_t i = first + lane;
+                    if ((hits & 1u) and (t_lanes[lane] < closest_t or (t_lanes[lane] == closest_t and bvh.indices[i] < bvh.indices[closest_index])))
+                    {
+                        closest_t     = t_lanes[lane];
+                        closest_index = static_cast<int>(i);
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Visit the child on the side the ray comes from first, as its hits are likely to cull the other one.
+            uint32_t near = node_index + 1;
+            uint32_t far  = node.offset;
+            if (direction[node.axis] < 0.0f)
+                std::swap(near, far);
+
+            stack[stack_size++] = far;
+            stack[stack_size++] = near;
+        }
+    }
+
+    if (statistics)
+    {
+        statistics->rays           += 1;
+        statistics->node_visits    += node_visits;
+        statistics->triangle_tests += triangle_tests;
+    }
+
+    if (closest_index == -1)
+        return {};
+
+    return { start + closest_t * direction, closest_t, bvh.indices[closest_index] };
+}
+
+
+// Any-hit query, see the linear version in raytracer.h. Returns as soon as a leaf has a triangle in [0, t_max).
+[[gnu::hot]]
+bool Occluded(
+        const glm::vec3& start, const glm::vec3& direction, const float t_max, const BVH& bvh,
+        TraversalStatistics* statistics = nullptr
+)
+{
+    using namespace glm;
+
+    if (bvh.nodes.empty())
+        return false;
+
+    const vec3 inverse_direction = 1.0f / direction;
+
+    bool occluded = false;
+
+    uint64_t node_visits    = 0;
+    uint64_t triangle_tests = 0;
+
+    uint32_t stack[BVH::MAX_DEPTH + 1];
+    unsigned stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0 and not occluded)
+    {
+        const uint32_t node_index = stack[--stack_size];
+        const BVHNode& node = bvh.nodes[node_index];
+
+        node_visits += 1;
+
+        if (IntersectBounds(node.bounds, start, inverse_direction, t_max) == std::numeric_limits<float>::infinity())
+            continue;
+
+        if (node.count > 0)
+        {
+            for (uint32_t first = node.offset; first < node.offset + node.count; first += SIMD_WIDTH)
+            {
+                triangle_tests += std::min<uint32_t>(SIMD_WIDTH, node.offset + node.count - first);
+
+                const SimdFloat t = Intersect(bvh.triangles, first, start, direction);
+                if (Any((t >= SimdFloat(0.0f)) & (t < SimdFloat(t_max))))
+                {
+                    occluded = true;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            // Any hit will do, but the near child is still the one most likely to contain a blocker.
+            uint32_t near = node_index + 1;
+            uint32_t far  = node.offset;
+            if (direction[node.axis] < 0.0f)
+                std::swap(near, far);
+
+            stack[stack_size++] = far;
+            stack[stack_size++] = near;
+        }
+    }
+
+    if (statistics)
+    {
+        statistics->rays           += 1;
+        statistics->node_visits    += node_visits;
+        statistics->triangle_tests += triangle_tests;
+    }
+
+    return occluded;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+
 #include <glm/glm.hpp>
 
 #include "intersection.h"
@@ -51,9 +53,55 @@ struct Camera
 
     glm::mat3 cached_rotation_matrix    = glm::mat3();  // Initialized as identity matrix.
     glm::mat4 cached_perspective_matrix = glm::mat4();  // Initialized as identity matrix.
+
+    unsigned version = 0;  // Bumped every time the camera moves, so anything derived from its view can be cached.
 };
 
 
+[[gnu::const]] inline
+glm::mat3 RotationMatrixX(const float radians)
+{
+    return glm::mat3(
+            glm::vec3(1,      0,           0     ),
+            glm::vec3(0,  cos(radians), -sin(radians)),
+            glm::vec3(0,  sin(radians),  cos(radians))
+    );
+}
+
+[[gnu::const]] inline
+glm::mat3 RotationMatrixY(const float radians)
+{
+    return glm::mat3(
+            glm::vec3( cos(radians),  0,  sin(radians)),
+            glm::vec3(    0,          1,       0      ),
+            glm::vec3(-sin(radians),  0,  cos(radians))
+    );
+}
+
+[[gnu::const]] inline
+glm::mat3 RotationMatrixZ(const float radians)
+{
+    return glm::mat3(
+            glm::vec3(cos(radians), -sin(radians),  0),
+            glm::vec3(sin(radians),  cos(radians),  0),
+            glm::vec3(      0,            0,        1)
+    );
+}
+
+// Turns the camera to 'yaw' radians around the y-axis and updates its local coordinate system to match.
+void SetYaw(Camera& camera, const float yaw)
+{
+    const glm::mat3 rotation = RotationMatrixY(yaw);
+
+    camera.yaw     =  yaw;
+    camera.right   =  glm::vec3(rotation[0][0], rotation[0][1], rotation[0][2]);
+    camera.up      = -glm::vec3(rotation[1][0], rotation[1][1], rotation[1][2]);
+    camera.forward = -glm::vec3(rotation[2][0], rotation[2][1], rotation[2][2]);
+
+    camera.cached_rotation_matrix = rotation;
+}
+
+
 vec2 Normalize(const Camera& camera, const AABB& viewport, float x, float y)
 {
     const int image_width  = viewport.right  - viewport.left;
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 #ifndef CRASH_ON_ASSERT
 #define CRASH_ON_ASSERT true
 #endif
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "lab3.h"
+#include "shadows.h"
+#include "threadpool.h"
+
+
+// Deferred shading for Lab3. Rasterizing only finds the triangle in front in every pixel, and writes what shading needs
+// to know about it to a G-buffer. A separate pass then runs PixelShader exactly once for every pixel something was
+// drawn into, so shading costs the same however many triangles were drawn over each other.
+//
+// The G-buffer holds the depth, the triangle and its barycentric coordinates rather than positions and normals: the
+// rest is looked up in the mesh by the triangle, which keeps it at 16 bytes a pixel.
+
+
+struct GBuffer
+{
+    static constexpr u32 NO_TRIANGLE = ~0u;
+    static constexpr i32 SHADE_ROWS  = 8;  // Rows of pixels per task of Shade.
+
+    // 1/z of the closest fragment so far, as the z-buffer of Draw, and which triangle of the mesh it's from.
+    // NO_TRIANGLE where nothing has been drawn.
+    Array2D<f32> depths    { 0, 0 };
+    Array2D<u32> triangles { 0, 0 };
+
+    // The perspective correct barycentric coordinates of the triangle's second and third vertex, divided by z (see
+    // PerspectivePlane). The first vertex's is what's left of 1.
+    Array2D<f32> barycentrics[2] { Array2D<f32>(0, 0), Array2D<f32>(0, 0) };
+};
+
+// Covers 'viewport.bottom' rows and 'viewport.right' columns. Only allocates when the size changes.
+void Resize(GBuffer& gbuffer, const Viewport& viewport)
+{
+    const unsigned rows    = static_cast<unsigned>(viewport.bottom);
+    const unsigned columns = static_cast<unsigned>(viewport.right);
+
+    if (gbuffer.depths.rows != rows or gbuffer.depths.columns != columns)
+    {
+        gbuffer.depths          = Array2D<f32>(rows, columns);
+        gbuffer.triangles       = Array2D<u32>(rows, columns);
+        gbuffer.barycentrics[0] = Array2D<f32>(rows, columns);
+        gbuffer.barycentrics[1] = Array2D<f32>(rows, columns);
+    }
+}
+
+// Empties the pixels of 'area', with the depths at 'far_depth'. The barycentric coordinates are only read where there's
+// a triangle, so they're left as they are.
+void Clear(GBuffer& gbuffer, const AABB& area, const f32 far_depth)
+{
+    for (i32 y = area.top; y < area.bottom; ++y)
+    {
+        std::fill(&gbuffer.depths(y, area.left),    &gbuffer.depths(y, area.left)    + (area.right - area.left), far_depth);
+        std::fill(&gbuffer.triangles(y, area.left), &gbuffer.triangles(y, area.left) + (area.right - area.left), GBuffer::NO_TRIANGLE);
+    }
+}
+
+
+// Depth tests a fragment of a piece of the mesh's 'triangle' against the G-buffer and writes it there where it's
+// closer. The fragment functor of the deferred draws. 'piece' gives the triangle's barycentric coordinates at the
+// piece's vertices, so the G-buffer holds them for the whole triangle even when it's been clipped.
+struct GBufferFragment
+{
+    GBuffer&    gbuffer;
+    u32         triangle;
+    ScreenPlane barycentrics[2];
+
+    GBufferFragment(
+            GBuffer& gbuffer, const u32 triangle, const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2,
+            const PieceBarycentrics& piece
+    ) :
+            gbuffer(gbuffer), triangle(triangle),
+            barycentrics {
+                PerspectivePlane(p0, p1, p2, piece.vertices[0].x, piece.vertices[1].x, piece.vertices[2].x),
+                PerspectivePlane(p0, p1, p2, piece.vertices[0].y, piece.vertices[1].y, piece.vertices[2].y)
+            } {}
+
+    inline void operator() (const i32 x, const i32 y, const f32 depth) const noexcept
+    {
+        if (gbuffer.depths(y, x) < depth)
+        {
+            gbuffer.depths(y, x)          = depth;
+            gbuffer.triangles(y, x)       = triangle;
+            gbuffer.barycentrics[0](y, x) = barycentrics[0].At(x, y);
+            gbuffer.barycentrics[1](y, x) = barycentrics[1].At(x, y);
+        }
+    }
+    // SIMD_WIDTH pixels from (x, y) rightwards at once, for RasterizeBlocks.
+    inline void operator() (const i32 x, const i32 y, const SimdFloat& depth, const SimdFloat& covered) const noexcept
+    {
+        f32* depths = &gbuffer.depths(y, x);
+
+        const SimdFloat closer = covered & (LoadU(depths) < depth);
+        if (not Any(closer))
+            return;
+
+        StoreMasked(depths, closer, depth);
+        StoreMasked(reinterpret_cast<int32_t*>(&gbuffer.triangles(y, x)), closer, SimdInt(static_cast<int32_t>(triangle)));
+        StoreMasked(&gbuffer.barycentrics[0](y, x), closer, barycentrics[0].At(x, barycentrics[0].Row(y)));
+        StoreMasked(&gbuffer.barycentrics[1](y, x), closer, barycentrics[1].At(x, barycentrics[1].Row(y)));
+    }
+};
+
+
+// Runs PixelShader on the pixels of the rows ['first_row', 'last_row') of the viewport that have a triangle, in the
+// shadows of 'shadows' when there's a shadow map, and clears the rest.
+[[gnu::hot]]
+void ShadeRows(
+        const Light& light, const Viewport& viewport, const Mesh& mesh, const GBuffer& gbuffer,
+        const Array2DView<u32>& framebuffer, const i32 first_row, const i32 last_row, const ShadowMap* shadows = nullptr
+)
+{
+    using namespace glm;
+
+    for (i32 y = first_row; y < last_row; ++y)
+    {
+        for (i32 x = viewport.left; x < viewport.right; ++x)
+        {
+            const u32 triangle = gbuffer.triangles(y, x);
+            if (triangle == GBuffer::NO_TRIANGLE)
+            {
+                framebuffer(y, x) = 0;
+                continue;
+            }
+
+            const f32 z  = 1.0f / gbuffer.depths(y, x);
+            const f32 b1 = gbuffer.barycentrics[0](y, x) * z;
+            const f32 b2 = gbuffer.barycentrics[1](y, x) * z;
+
+            const vec3 world_position = (1.0f - b1 - b2) * Position(mesh, mesh.indices[3 * triangle + 0]) +
+                                        b1               * Position(mesh, mesh.indices[3 * triangle + 1]) +
+                                        b2               * Position(mesh, mesh.indices[3 * triangle + 2]);
+
+            const Pixel pixel (x, y, z, world_position / z);
+            const f32   lit = Lit(shadows, world_position, mesh.normals[triangle]);
+            framebuffer(y, x) = ColorCode(PixelShader(pixel, light, mesh.normals[triangle], mesh.shading_colors[triangle], lit));
+        }
+    }
+}
+
+// The shading pass: ShadeRows over the viewport on the pool, in bands of GBuffer::SHADE_ROWS rows.
+void Shade(
+        const Light& light, const Viewport& viewport, const Mesh& mesh, const GBuffer& gbuffer,
+        ThreadPool& pool, const Array2DView<u32>& framebuffer, const ShadowMap* shadows = nullptr
+)
+{
+    const unsigned bands = static_cast<unsigned>((viewport.bottom - viewport.top + GBuffer::SHADE_ROWS - 1) / GBuffer::SHADE_ROWS);
+
+    ParallelFor(pool, bands, [&](const unsigned band, unsigned)
+    {
+        const i32 first_row = viewport.top + static_cast<i32>(band) * GBuffer::SHADE_ROWS;
+        const i32 last_row  = std::min(first_row + GBuffer::SHADE_ROWS, viewport.bottom);
+        ShadeRows(light, viewport, mesh, gbuffer, framebuffer, first_row, last_row, shadows);
+    });
+}
+
+
+// Draw, deferred: rasterizes every triangle of the mesh into 'gbuffer', then shades it on the pool. Returns what
+// culling dropped.
+CullingStats DrawDeferred(
+        const Camera& camera, const Light& light, const Viewport& viewport, const Mesh& mesh, VertexBuffer& vertices,
+        GBuffer& gbuffer, ThreadPool& pool, const Array2DView<u32>& framebuffer, const ShadowMap* shadows = nullptr
+)
+{
+    Resize(gbuffer, viewport);
+    Clear(gbuffer, viewport, FarDepth(camera));
+
+    Resize(vertices, mesh);
+    TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+
+    CullingStats   culling;
+    ClippedPolygon polygon;
+
+    for (u32 triangle = 0; triangle < TriangleCount(mesh); ++triangle)
+    {
+        if (not VisibleTriangle(camera, viewport, mesh, vertices, triangle, culling, polygon))
+            continue;
+
+        for (u32 piece = 0; piece < PieceCount(polygon); ++piece)
+        {
+            const RasterVertex& p0 = polygon.vertices[0];
+            const RasterVertex& p1 = polygon.vertices[piece + 1];
+            const RasterVertex& p2 = polygon.vertices[piece + 2];
+            RasterizeBlocks(viewport, p0, p1, p2, GBufferFragment(gbuffer, triangle, p0, p1, p2, Barycentrics(polygon, piece)));
+        }
+    }
+
+    Shade(light, viewport, mesh, gbuffer, pool, framebuffer, shadows);
+
+    return culling;
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "lab3.h"
+
+
+// A hierarchical z-buffer for Lab3: the farthest depth under every block of RasterizeBlocks, and under every group of
+// blocks, so that triangles and blocks behind what's already been drawn are skipped before any per-pixel work.
+//
+// Depths are 1/z as in the z-buffer, so the farthest is the smallest. A block's cell is raised to the farthest depth of
+// a triangle that covers all of it, or taken from the z-buffer again when a triangle has drawn into part of it, and a
+// group's is the farthest of its blocks. A triangle or block is skipped only when its nearest depth isn't closer than
+// the farthest under it, which is when the depth test would have failed for every one of its pixels anyway, so the
+// image is the same bit for bit.
+//
+// Blocks that stick out of the viewport are never taken from the z-buffer, so they, and their group, stay at the depth
+// they're cleared to and never hide anything.
+
+
+// What the hierarchical test did, summed over the triangles it saw.
+struct OcclusionStats
+{
+    u64 triangles        = 0;  // Reaching the test, so once per tile a triangle is binned to.
+    u64 triangles_culled = 0;
+    u64 blocks           = 0;  // Blocks of the triangles that weren't culled whole, and that touch the triangle.
+    u64 blocks_culled    = 0;
+    u64 pixels_culled    = 0;  // Pixels of the bounding boxes of the culled triangles and blocks, never tested.
+};
+
+OcclusionStats& operator+= (OcclusionStats& total, const OcclusionStats& stats)
+{
+    total.triangles        += stats.triangles;
+    total.triangles_culled += stats.triangles_culled;
+    total.blocks           += stats.blocks;
+    total.blocks_culled    += stats.blocks_culled;
+    total.pixels_culled    += stats.pixels_culled;
+    return total;
+}
+
+
+struct HierarchicalZ
+{
+    static constexpr i32 GROUP_SIZE   = 4;                        // Blocks on a side of a group.
+    static constexpr i32 GROUP_PIXELS = GROUP_SIZE * BLOCK_SIZE;
+
+    // The farthest depth under each block, and under each group of GROUP_SIZE x GROUP_SIZE blocks. On the same grid
+    // from (0, 0) as the blocks of RasterizeBlocks. A stale group has had a block move since it was last taken from
+    // them, and is still a lower bound, just maybe not the tightest.
+    Array2D<f32> blocks { 0, 0 };
+    Array2D<f32> groups { 0, 0 };
+    Array2D<u8>  stale  { 0, 0 };
+};
+
+// Covers a z-buffer of 'viewport.bottom' rows and 'viewport.right' columns. Only allocates when the size changes.
+void Resize(HierarchicalZ& hiz, const Viewport& viewport)
+{
+    const unsigned block_rows    = static_cast<unsigned>((viewport.bottom + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    const unsigned block_columns = static_cast<unsigned>((viewport.right  + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    const unsigned group_rows    = (block_rows    + HierarchicalZ::GROUP_SIZE - 1) / HierarchicalZ::GROUP_SIZE;
+    const unsigned group_columns = (block_columns + HierarchicalZ::GROUP_SIZE - 1) / HierarchicalZ::GROUP_SIZE;
+
+    if (hiz.blocks.rows != block_rows or hiz.blocks.columns != block_columns)
+    {
+        hiz.blocks = Array2D<f32>(block_rows, block_columns);
+        hiz.groups = Array2D<f32>(group_rows, group_columns);
+        hiz.stale  = Array2D<u8> (group_rows, group_columns);
+    }
+}
+
+// Sets the cells under 'area' to 'depth', as when the z-buffer there is cleared to it. 'area' starts on the group grid.
+void Fill(HierarchicalZ& hiz, const AABB& area, const f32 depth)
+{
+    const i32 block_right  = std::min((area.right  + BLOCK_SIZE - 1) / BLOCK_SIZE, static_cast<i32>(hiz.blocks.columns));
+    const i32 block_bottom = std::min((area.bottom + BLOCK_SIZE - 1) / BLOCK_SIZE, static_cast<i32>(hiz.blocks.rows));
+    for (i32 row = area.top / BLOCK_SIZE; row < block_bottom; ++row)
+        for (i32 column = area.left / BLOCK_SIZE; column < block_right; ++column)
+            hiz.blocks(row, column) = depth;
+
+    const i32 group_right  = std::min((area.right  + HierarchicalZ::GROUP_PIXELS - 1) / HierarchicalZ::GROUP_PIXELS, static_cast<i32>(hiz.groups.columns));
+    const i32 group_bottom = std::min((area.bottom + HierarchicalZ::GROUP_PIXELS - 1) / HierarchicalZ::GROUP_PIXELS, static_cast<i32>(hiz.groups.rows));
+    for (i32 row = area.top / HierarchicalZ::GROUP_PIXELS; row < group_bottom; ++row)
+        for (i32 column = area.left / HierarchicalZ::GROUP_PIXELS; column < group_right; ++column)
+        {
+            hiz.groups(row, column) = depth;
+            hiz.stale (row, column) = false;
+        }
+}
+
+
+// The occlusion test of RasterizeBlocks against a hierarchical z-buffer, counting into 'stats'. Only right for a
+// fragment that depth tests against the z-buffer 'hiz' describes, like DepthTestFragment.
+//
+// With 'depths_final', for the color pass after a depth pre-pass (DepthEqualFragment): the z-buffer already holds the
+// depth every pixel ends up with, so only what's strictly behind it is hidden, and nothing drawn moves it.
+struct HierarchicalZTest
+{
+    static constexpr bool ENABLED = true;
+
+    HierarchicalZ&      hiz;
+    const Array2D<f32>& z_buffer;
+    OcclusionStats&     stats;
+    bool                depths_final = false;
+
+    bool Hidden(const f32 nearest, const f32 farthest_under) const noexcept
+    {
+        return depths_final ? nearest < farthest_under : nearest <= farthest_under;
+    }
+
+    // Whether every group under 'bounds' is at least as close as 'nearest'.
+    bool TriangleOccluded(const AABB& bounds, const f32 nearest) const noexcept
+    {
+        stats.triangles += 1;
+
+        for (i32 row = bounds.top / HierarchicalZ::GROUP_PIXELS; row <= bounds.bottom / HierarchicalZ::GROUP_PIXELS; ++row)
+            for (i32 column = bounds.left / HierarchicalZ::GROUP_PIXELS; column <= bounds.right / HierarchicalZ::GROUP_PIXELS; ++column)
+                if (not Hidden(nearest, Group(row, column)))
+                    return false;
+
+        stats.triangles_culled += 1;
+        stats.pixels_culled    += static_cast<u64>(bounds.right - bounds.left + 1) * static_cast<u64>(bounds.bottom - bounds.top + 1);
+        return true;
+    }
+
+    bool BlockOccluded(const i32 block_x, const i32 block_y, const f32 nearest, const i32 pixels) const noexcept
+    {
+        stats.blocks += 1;
+
+        if (not Hidden(nearest, hiz.blocks(block_y / BLOCK_SIZE, block_x / BLOCK_SIZE)))
+            return false;
+
+        stats.blocks_culled += 1;
+        stats.pixels_culled += static_cast<u64>(pixels);
+        return true;
+    }
+
+    // The whole block has been depth tested against depths no farther than 'farthest', so it's at least that close.
+    void BlockCovered(const i32 block_x, const i32 block_y, const f32 farthest) const noexcept
+    {
+        if (depths_final)
+            return;
+
+        Raise(block_y / BLOCK_SIZE, block_x / BLOCK_SIZE, farthest);
+    }
+
+    // Some of the block has been drawn into, so its farthest depth may have moved closer. Takes it from the z-buffer,
+    // where it's just been written and is still in the cache.
+    void BlockDrawn(const i32 block_x, const i32 block_y) const noexcept
+    {
+        static_assert(BLOCK_SIZE % SIMD_WIDTH == 0, "A block row must be a whole number of SIMD registers.");
+
+        if (depths_final)
+            return;
+
+        SimdFloat farthests = LoadU(&z_buffer(block_y, block_x));
+        for (i32 y = block_y; y < block_y + BLOCK_SIZE; ++y)
+            for (i32 x = block_x; x < block_x + BLOCK_SIZE; x += SIMD_WIDTH)
+                farthests = Min(farthests, LoadU(&z_buffer(y, x)));
+
+        alignas(SIMD_ALIGNMENT) f32 lanes[SIMD_WIDTH];
+        Store(lanes, farthests);
+        f32 farthest = lanes[0];
+        for (unsigned lane = 1; lane < SIMD_WIDTH; ++lane)
+            farthest = std::min(farthest, lanes[lane]);
+
+        Raise(block_y / BLOCK_SIZE, block_x / BLOCK_SIZE, farthest);
+    }
+
+    void Raise(const i32 block_row, const i32 block_column, const f32 farthest) const noexcept
+    {
+        f32& block = hiz.blocks(block_row, block_column);
+        if (not (block < farthest))
+            return;
+
+        // Only the farthest block of its group can move the group. Rather than right away, the group is taken from its
+        // blocks when it's next needed, as blocks are drawn into a lot more often than triangles are tested.
+        const i32 group_row    = block_row    / HierarchicalZ::GROUP_SIZE;
+        const i32 group_column = block_column / HierarchicalZ::GROUP_SIZE;
+        if (block <= hiz.groups(group_row, group_column))
+            hiz.stale(group_row, group_column) = true;
+
+        block = farthest;
+    }
+
+    f32 Group(const i32 group_row, const i32 group_column) const noexcept
+    {
+        f32& group = hiz.groups(group_row, group_column);
+        if (not hiz.stale(group_row, group_column))
+            return group;
+
+        const i32 first_row    = group_row    * HierarchicalZ::GROUP_SIZE;
+        const i32 first_column = group_column * HierarchicalZ::GROUP_SIZE;
+        const i32 last_row     = std::min(first_row    + HierarchicalZ::GROUP_SIZE, static_cast<i32>(hiz.blocks.rows));
+        const i32 last_column  = std::min(first_column + HierarchicalZ::GROUP_SIZE, static_cast<i32>(hiz.blocks.columns));
+
+        group = hiz.blocks(first_row, first_column);
+        for (i32 row = first_row; row < last_row; ++row)
+            for (i32 column = first_column; column < last_column; ++column)
+                group = std::min(group, hiz.blocks(row, column));
+
+        hiz.stale(group_row, group_column) = false;
+        return group;
+    }
+};
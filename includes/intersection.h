@@ -23,14 +23,14 @@ enum class IntersectionType
 };
 
 template <typename T>
-struct Intersection
+struct LineIntersection
 {
     const T point;
     const IntersectionType type;
 };
 
 
-Intersection<ivec2> LineLineIntersection(const ivec2& start1, const ivec2& stop1, const ivec2& start2, const ivec2& stop2)
+LineIntersection<ivec2> LineLineIntersection(const ivec2& start1, const ivec2& stop1, const ivec2& start2, const ivec2& stop2)
 {
     using glm::round;
 
@@ -100,10 +100,10 @@ LR_Intersection<ivec2> LineRectIntersection(const Rectangle& rectangle, const gl
     const ivec2 bottom_left  = ivec2(rectangle.left,    rectangle.bottom-1);
     const ivec2 top_right    = ivec2(rectangle.right-1, rectangle.top);
 
-    const Intersection<ivec2> left_intersection   = LineLineIntersection(start, stop, top_left,     bottom_left);
-    const Intersection<ivec2> top_intersection    = LineLineIntersection(start, stop, top_left,     top_right);
-    const Intersection<ivec2> right_intersection  = LineLineIntersection(start, stop, bottom_right, top_right);
-    const Intersection<ivec2> bottom_intersection = LineLineIntersection(start, stop, bottom_right, bottom_left);
+    const LineIntersection<ivec2> left_intersection   = LineLineIntersection(start, stop, top_left,     bottom_left);
+    const LineIntersection<ivec2> top_intersection    = LineLineIntersection(start, stop, top_left,     top_right);
+    const LineIntersection<ivec2> right_intersection  = LineLineIntersection(start, stop, bottom_right, top_right);
+    const LineIntersection<ivec2> bottom_intersection = LineLineIntersection(start, stop, bottom_right, bottom_left);
 
     ivec2 intersections[2];
     int intersection_count = 0;
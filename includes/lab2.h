@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "SDLhelper.h"
+#include "utilities.h"
+#include "camera.h"
+#include "light.h"
+#include "raytracer.h"
+#include "bvh.h"
+#include "packet.h"
+#include "soa.h"
+#include "threadpool.h"
+
+
+// Lab2's renderer: a ray tracer with hard shadows from a single point light. Kept apart from the window and keyboard
+// handling in source/lab2.cpp so it can also run headless.
+
+
+glm::vec3 DirectLight(const glm::vec3& point, const glm::vec3& normal, const glm::vec3& color, const Light& light)
+{
+    using namespace glm;
+
+    const vec3  point_to_light = light.position - point;
+    const vec3  direction_to_light = normalize(point_to_light);
+    const float radius = length(point_to_light);
+
+    const float factor = max(dot(direction_to_light, normal), 0.0f);
+
+    const vec3 result = (color * light.color * factor) / (4.0f * PI * radius * radius);
+
+    return result;
+}
+
+
+// What the primary ray of every pixel hit (a G-buffer). Only depends on the camera, so as long as it doesn't move,
+// changes to the light only need new shadow rays and shading, not new primary rays.
+struct PrimaryHits
+{
+    Array2D<glm::vec3> positions;
+    Array2D<glm::vec3> normals;
+    Array2D<int>       triangle_indices;  // -1 where the ray hit nothing.
+
+    unsigned camera_version = 0;      // Camera::version the hits were traced for.
+    bool     valid          = false;  // Set to false to force tracing them again.
+
+    // ---- CONSTRUCTORS ----
+    PrimaryHits(const int width, const int height) :
+            positions(height, width), normals(height, width), triangle_indices(height, width) {}
+};
+
+inline bool IsCurrent(const PrimaryHits& hits, const Camera& camera)
+{
+    return hits.valid and hits.camera_version == camera.version;
+}
+
+
+// The color of a pixel whose primary ray hit 'position' on a triangle with 'normal' and 'color'.
+Uint32 Shade(
+        const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color,
+        const Light& light, const BVH& bvh
+)
+{
+    using namespace glm;
+
+    // Shadow ray.
+    const vec3 intersection_to_light = light.position - position;
+    const vec3 direction_to_light    = normalize(intersection_to_light);
+    // Move a short distance away so it doesn't collide with itself.
+    const vec3 start_position        = position + direction_to_light * 0.001f;
+
+    // The light is at t = 1 along 'intersection_to_light', so only blockers before that count.
+    const bool in_shadow = Occluded(start_position, intersection_to_light, 1.0f, bvh);
+
+    const float factor  = max(dot(direction_to_light, normal), 0.0f);
+    const vec3  diffuse = color * light.ambient * factor;
+
+    // If there is an object before we reach the light, don't calculate light.
+    if (in_shadow)
+        return ColorCode(diffuse);
+
+    const vec3 specular = DirectLight(position, normal, color, light);
+    return ColorCode(clamp(diffuse + specular, vec3(0), vec3(1)));
+}
+
+
+// Square blocks of pixels handed out to the threads. Small enough that there are plenty to balance the load with, big
+// enough that neighbouring rays (which take similar paths through the BVH) stay on the same thread.
+constexpr int TILE_SIZE = 16;
+
+enum class TraceMode
+{
+    SINGLE,   // One primary ray at a time.
+    PACKETS   // PACKET_WIDTH x PACKET_HEIGHT primary rays at a time, see packet.h.
+};
+
+// Runs 'job(top, left, bottom, right)' for every tile of the image on the pool. Every pixel is computed the same way
+// no matter which thread gets its tile, so the image doesn't depend on the number of threads.
+template <typename Job>
+void ForEachTile(ThreadPool& pool, const int width, const int height, const Job& job)
+{
+    const int tile_columns = (width  + TILE_SIZE - 1) / TILE_SIZE;
+    const int tile_rows    = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    ParallelFor(pool, static_cast<unsigned>(tile_columns * tile_rows), [&](const unsigned tile, unsigned)
+    {
+        const int top  = (tile / tile_columns) * TILE_SIZE;
+        const int left = (tile % tile_columns) * TILE_SIZE;
+
+        job(top, left, std::min(top + TILE_SIZE, height), std::min(left + TILE_SIZE, width));
+    });
+}
+
+
+void TracePrimaryRays(
+        const Camera& camera, const int width, const int height, const float focal,
+        const std::vector<ShadingRecord>& shading, const BVH& bvh,
+        ThreadPool& pool, const TraceMode mode, PrimaryHits& hits
+)
+{
+    using namespace glm;
+
+    const auto PrimaryRay = [&](const int row, const int column) -> vec3
+    {
+        return camera.cached_rotation_matrix * vec3(column - (width/2.0f), row - (height/2.0f), -focal);
+    };
+
+    const auto Store = [&](const int row, const int column, const Intersection& intersection)
+    {
+        hits.triangle_indices(row, column) = intersection.triangle_index;
+        if (intersection)
+        {
+            hits.positions(row, column) = intersection.position;
+            hits.normals  (row, column) = shading[intersection.triangle_index].normal;
+        }
+    };
+
+    ForEachTile(pool, width, height, [&](const int top, const int left, const int bottom, const int right)
+    {
+        if (mode == TraceMode::SINGLE)
+        {
+            for (int row = top; row < bottom; ++row)
+                for (int column = left; column < right; ++column)
+                    Store(row, column, ClosestIntersection(camera.position, PrimaryRay(row, column), bvh));
+            return;
+        }
+
+        for (int row = top; row < bottom; row += PACKET_HEIGHT)
+        {
+            for (int column = left; column < right; column += PACKET_WIDTH)
+            {
+                // Lanes past the edge of the image are traced, but not written.
+                vec3 directions[PACKET_SIZE];
+                for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+                    directions[lane] = PrimaryRay(row + lane / PACKET_WIDTH, column + lane % PACKET_WIDTH);
+
+                Intersection intersections[PACKET_SIZE];
+                ClosestIntersection(camera.position, directions, bvh, intersections);
+
+                for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+                {
+                    const int pixel_row    = row    + lane / PACKET_WIDTH;
+                    const int pixel_column = column + lane % PACKET_WIDTH;
+
+                    if (pixel_row < bottom and pixel_column < right)
+                        Store(pixel_row, pixel_column, intersections[lane]);
+                }
+            }
+        }
+    });
+
+    hits.camera_version = camera.version;
+    hits.valid          = true;
+}
+
+// Traces the primary rays into 'hits' unless they're still current for the camera, then shades every pixel of
+// 'target'. Allocates nothing, so drawing into the same target frame after frame is free of heap allocations.
+void Draw(
+        const Camera& camera, const Light& light, const float focal,
+        const std::vector<ShadingRecord>& shading, const BVH& bvh,
+        ThreadPool& pool, PrimaryHits& hits, const Array2DView<Uint32>& target,
+        const TraceMode mode = TraceMode::PACKETS, const Uint32 background_color = ColorCode(GREY)
+)
+{
+    const int width  = static_cast<int>(target.columns);
+    const int height = static_cast<int>(target.rows);
+
+    Assert(
+        hits.triangle_indices.columns == target.columns and hits.triangle_indices.rows == target.rows,
+        "The primary hits (%ux%u) and the target (%ux%u) are different sizes.",
+        hits.triangle_indices.columns, hits.triangle_indices.rows, target.columns, target.rows
+    );
+
+    if (not IsCurrent(hits, camera))
+        TracePrimaryRays(camera, width, height, focal, shading, bvh, pool, mode, hits);
+
+    ForEachTile(pool, width, height, [&](const int top, const int left, const int bottom, const int right)
+    {
+        for (int row = top; row < bottom; ++row)
+        {
+            for (int column = left; column < right; ++column)
+            {
+                const int triangle_index = hits.triangle_indices(row, column);
+
+                target(row, column) = triangle_index == -1 ? background_color : Shade(
+                        hits.positions(row, column), hits.normals(row, column), shading[triangle_index].color, light, bvh
+                );
+            }
+        }
+    });
+}
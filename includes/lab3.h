@@ -0,0 +1,1294 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "SDLhelper.h"
+#include "TestModel.h"
+#include "interpolation.h"
+#include "intersection.h"
+#include "utilities.h"
+#include "camera.h"
+#include "light.h"
+#include "simd.h"
+
+
+// Lab3's renderer: a rasterizer. Kept apart from the window and keyboard handling in source/lab3.cpp so it can also
+// run headless.
+
+using u8  = uint8_t;
+using u16 = uint16_t;
+using u32 = uint32_t;
+using u64 = uint64_t;
+
+using i8  = int8_t;
+using i16 = int16_t;
+using i32 = int32_t;
+using i64 = int64_t;
+
+using f32 = float_t;
+using f64 = double_t;
+
+
+struct Vertex
+{
+    glm::vec3 position = glm::vec3();
+
+    Vertex() = default;
+    explicit Vertex(const glm::vec3& position) : position(position) {}
+};
+
+using Viewport = AABB;
+
+
+/*
+// For convex polygon only.
+std::vector<Pixel> ScanlineRasterize(const std::vector<Pixel>& vertices)
+{
+    constexpr int MAX_INT = std::numeric_limits<int>::max();
+    constexpr int MIN_INT = std::numeric_limits<int>::min();
+
+    // 1. Find max and min y-value of the polygon
+    // and compute the number of rows it occupies.
+    int bottom = MIN_INT;
+    int top    = MAX_INT;
+    for (const Pixel& vertex : vertices)
+    {
+        if (vertex.y > bottom)
+            bottom = vertex.y;
+        if (vertex.y < top)
+            top = vertex.y;
+    }
+
+    // Break early if polygon is outside of the screen.
+    // if (top >= viewport.bottom) return {};
+    // if (bottom < viewport.top)  return {};
+
+    // // Only care about the rows inside the viewport.
+    // if (bottom >= viewport.bottom) bottom = viewport.bottom - 1;
+    // if (top    <  viewport.top)    top    = viewport.top;
+
+    Assert(bottom != MIN_INT and top != MAX_INT, "Top (%i) or bottom (%i) hasn't been initialized!", top, bottom);
+    Assert(bottom >= top, "Min (%i) is greater than max (%i).", top, bottom);
+
+
+    // 2. Resize leftPixels and rightPixels
+    // so that they have an element for each row.
+    const int rows = std::max(bottom - top + 1, 1024);
+
+    std::vector<Pixel> left  (static_cast<unsigned long>(rows));
+    std::vector<Pixel> right (static_cast<unsigned long>(rows));
+
+
+    // 3. Initialize the x-coordinates in leftPixels
+    // to some really large value and the x-coordinates
+    // in rightPixels to some really small value.
+    for (auto& pixel : left)
+        pixel.x = MAX_INT;
+    for (auto& pixel : right)
+        pixel.x = MIN_INT;
+
+
+    // 4. Loop through all edges of the polygon and use
+    // linear interpolation to find the x-coordinate for
+    // each row it occupies. Update the corresponding
+    // values in rightPixels and leftPixels.
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        const Pixel& first = vertices[i];
+        const Pixel& next  = vertices[(i+1) % vertices.size()];
+
+        const std::vector<Pixel> line_fragments = Interpolate(first, next);
+
+        for (const Pixel& line_fragment : line_fragments)
+        {
+            int row_index = line_fragment.y - top;
+
+            if (not (0 <= row_index and row_index < rows))
+                continue;
+
+            if (left[row_index].x > line_fragment.x)
+                left[row_index] = line_fragment;
+            if (right[row_index].x < line_fragment.x)
+                right[row_index] = line_fragment;
+        }
+    }
+
+
+    std::vector<Pixel> pixels;
+    pixels.reserve(static_cast<unsigned long>(rows));
+    for (int row = 0; row < rows; ++row)
+    {
+        const std::vector<Pixel> row_pixels = Interpolate(left[row], right[row]);
+        pixels.insert(end(pixels), begin(row_pixels), end(row_pixels));
+    }
+
+    return pixels;
+}
+
+*/
+
+
+// ---- RASTER POSITIONS ----
+// VertexShader gives positions in pixels as fixed point with SUBPIXEL_BITS fractional bits (28.4), so vertices snap to
+// a sixteenth of a pixel rather than a whole one, and the edge functions are still exact integers. Pixels are sampled at
+// their centres.
+constexpr i32 SUBPIXEL_BITS  = 4;
+constexpr i32 SUBPIXEL_STEPS = 1 << SUBPIXEL_BITS;  // Per pixel.
+constexpr i32 SUBPIXEL_HALF  = SUBPIXEL_STEPS / 2;
+
+// Raster positions are clamped to this many pixels either side of the origin. An edge function is then a product of
+// differences of at most 2^22 in fixed point, which fits an i64 anywhere, and fits an i32 within a block the edge goes
+// through (see RasterizeBlocks), however large the viewport.
+constexpr i32 MAX_RASTER_COORDINATE = 1 << 17;
+
+// A vertex after VertexShader.
+struct RasterVertex
+{
+    i32 x;  // Fixed point, see SUBPIXEL_BITS.
+    i32 y;
+    f32 z;  // The distance in front of the camera.
+};
+
+// A vertex at the centre of the pixel (x, y).
+inline RasterVertex AtPixel(const i32 x, const i32 y, const f32 z)
+{
+    return { x * SUBPIXEL_STEPS + SUBPIXEL_HALF, y * SUBPIXEL_STEPS + SUBPIXEL_HALF, z };
+}
+
+// The pixel whose centre is the closest one at or to the left of (above) the fixed point 'position'. Shifts rather than
+// divides, so it rounds down for negative positions too.
+inline i32 PixelAtOrBefore(const i32 position)
+{
+    return (position - SUBPIXEL_HALF) >> SUBPIXEL_BITS;
+}
+
+// The pixels whose centres are inside the triangle's bounding box, clipped to the viewport. Empty when 'right < left'
+// or 'bottom < top'.
+inline AABB PixelBounds(const Viewport& viewport, const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2)
+{
+    using std::min;
+    using std::max;
+
+    return {
+        max(PixelAtOrBefore(min({v0.x, v1.x, v2.x}) + SUBPIXEL_STEPS - 1), viewport.left),
+        max(PixelAtOrBefore(min({v0.y, v1.y, v2.y}) + SUBPIXEL_STEPS - 1), viewport.top),
+        min(PixelAtOrBefore(max({v0.x, v1.x, v2.x})), viewport.right  - 1),
+        min(PixelAtOrBefore(max({v0.y, v1.y, v2.y})), viewport.bottom - 1)
+    };
+}
+
+// Twice the signed area of the triangle (v0, v1, p), in fixed point squared. Inside a triangle all three of its edge
+// functions are negative: the rasterizers only fill one winding.
+inline i64 EdgeFunction(const RasterVertex& v0, const RasterVertex& v1, const i64 x, const i64 y)
+{
+    return (x - v0.x) * (i64(v1.y) - v0.y) - (y - v0.y) * (i64(v1.x) - v0.x);
+}
+
+// Something linear in screen space over a triangle's pixels, like 1/z: its value at the centre of the pixel 'anchor'
+// and its steps per pixel. Evaluated from the anchor, the pixel the first vertex is in, rather than stepped from a
+// corner, so a pixel gets the same value whichever viewport the triangle is clipped to (the tiles of binning.h rely on
+// that).
+struct ScreenPlane
+{
+    f32 at_anchor;
+    f32 step_x, step_y;
+    i32 anchor_x, anchor_y;
+
+    f32 Row(const i32 y) const noexcept
+    {
+        return at_anchor + step_y * (y - anchor_y);
+    }
+    f32 At(const i32 x, const i32 y) const noexcept
+    {
+        return Row(y) + step_x * (x - anchor_x);
+    }
+    // At the SIMD_WIDTH pixels from (x, y) rightwards, given Row(y).
+    SimdFloat At(const i32 x, const f32 row) const noexcept
+    {
+        return SimdFloat(row) + SimdFloat(step_x) * ToFloat(SimdInt(x - anchor_x) + LaneIndices());
+    }
+};
+
+// The plane through 'a0 / z0', 'a1 / z1' and 'a2 / z2' at the vertices. Anything linear over the triangle in camera
+// space divided by z is linear in screen space: 1/z itself with all of them 1, and a vertex's perspective correct
+// barycentric coordinate divided by z with its own 1 and the others 0.
+inline ScreenPlane PerspectivePlane(
+        const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2,
+        const f32 a0, const f32 a1, const f32 a2
+)
+{
+    const i64 area = EdgeFunction(p0, p1, p2.x, p2.y);
+
+    // The gradient per fixed point unit is the steps of the edge functions weighted by a/(area z) of the vertex opposite
+    // each edge.
+    const f32 k0 = a0 * (1.0f / (static_cast<f32>(area) * p0.z));
+    const f32 k1 = a1 * (1.0f / (static_cast<f32>(area) * p1.z));
+    const f32 k2 = a2 * (1.0f / (static_cast<f32>(area) * p2.z));
+    const f32 gradient_x = static_cast<f32>(p2.y - p1.y) * k0 + static_cast<f32>(p0.y - p2.y) * k1 + static_cast<f32>(p1.y - p0.y) * k2;
+    const f32 gradient_y = static_cast<f32>(p1.x - p2.x) * k0 + static_cast<f32>(p2.x - p0.x) * k1 + static_cast<f32>(p0.x - p1.x) * k2;
+
+    ScreenPlane plane;
+    plane.anchor_x  = p0.x >> SUBPIXEL_BITS;
+    plane.anchor_y  = p0.y >> SUBPIXEL_BITS;
+    plane.step_x    = gradient_x * SUBPIXEL_STEPS;
+    plane.step_y    = gradient_y * SUBPIXEL_STEPS;
+    plane.at_anchor = (a0 / p0.z + gradient_x * static_cast<f32>(plane.anchor_x * SUBPIXEL_STEPS + SUBPIXEL_HALF - p0.x))
+                                 + gradient_y * static_cast<f32>(plane.anchor_y * SUBPIXEL_STEPS + SUBPIXEL_HALF - p0.y);
+    return plane;
+}
+
+// The edge functions of a triangle at the centre of the pixel 'origin' and their steps per pixel, and the 1/z plane.
+// Shared by both rasterizers so they cover and depth test exactly the same.
+struct TriangleSetup
+{
+    i64 at_origin[3];  // Edges v1-v2, v2-v0 and v0-v1, biased by the fill rule.
+    i64 step_x[3];
+    i64 step_y[3];
+    i32 origin_x, origin_y;
+
+    ScreenPlane depth;
+
+    // On or inside edge 'edge' where this isn't positive.
+    i64 Edge(const int edge, const i32 x, const i32 y) const noexcept
+    {
+        return at_origin[edge] + step_x[edge] * (x - origin_x) + step_y[edge] * (y - origin_y);
+    }
+};
+
+// Sets up the triangle for the pixels from 'origin'. Returns false when it covers no pixel centres at all.
+//
+// The top-left fill rule: a pixel centre exactly on an edge belongs to the triangle only if the edge is a left edge
+// (the triangle is to its right) or a top edge (horizontal, the triangle below it). Two triangles sharing an edge lie
+// on opposite sides of it, so the pixels along it go to exactly one of them: never drawn twice, and never missed.
+inline bool Setup(const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2, const i32 origin_x, const i32 origin_y, TriangleSetup& setup)
+{
+    const i64 area = EdgeFunction(p0, p1, p2.x, p2.y);
+    if (area == 0)
+        return false;
+
+    const RasterVertex* from[3] = { &p1, &p2, &p0 };
+    const RasterVertex* to  [3] = { &p2, &p0, &p1 };
+
+    const i64 origin_sample_x = i64(origin_x) * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+    const i64 origin_sample_y = i64(origin_y) * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+
+    for (int edge = 0; edge < 3; ++edge)
+    {
+        const i64 dx = to[edge]->y - i64(from[edge]->y);
+        const i64 dy = from[edge]->x - i64(to[edge]->x);
+
+        // Inside is where the edge function goes down: to the right of a left edge, below a top one.
+        const bool top_left = dx < 0 or (dx == 0 and dy < 0);
+
+        setup.step_x[edge]    = dx * SUBPIXEL_STEPS;
+        setup.step_y[edge]    = dy * SUBPIXEL_STEPS;
+        setup.at_origin[edge] = EdgeFunction(*from[edge], *to[edge], origin_sample_x, origin_sample_y) + (top_left ? 0 : 1);
+    }
+    setup.origin_x = origin_x;
+    setup.origin_y = origin_y;
+    setup.depth    = PerspectivePlane(p0, p1, p2, 1.0f, 1.0f, 1.0f);
+
+    return true;
+}
+
+
+// Calls 'fragment(x, y, depth)' for every pixel of the viewport the triangle covers, in rows from the top, as it finds
+// them. 'fragment' is a template parameter so it's inlined into the loop: a depth test and store right there needs no
+// memory for the fragments in between.
+//
+// 'depth' is 1/z rather than z, so bigger is closer. Unlike z, 1/z is linear in screen space, so it's a plane over the
+// pixels and needs no division per pixel.
+template <typename Fragment>
+[[gnu::hot]]
+void Rasterize(const Viewport& viewport, const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2, const Fragment& fragment)
+{
+    // Guard-band clipping: triangles reaching outside the guard band have been clipped to it (see ClipTriangle), and
+    // everything else is only clipped to the viewport here, by its bounding box. Edges outside the viewport just never
+    // pass the inside test, so the box is all that needs clipping, and it's never bigger than the viewport.
+    // https://fgiesen.wordpress.com/2011/07/05/a-trip-through-the-graphics-pipeline-2011-part-5/
+
+    // https://fgiesen.wordpress.com/2013/02/08/triangle-rasterization-in-practice/
+
+    const AABB aabb = PixelBounds(viewport, p0, p1, p2);
+
+    TriangleSetup setup;
+    if (aabb.right < aabb.left or aabb.bottom < aabb.top or not Setup(p0, p1, p2, aabb.left, aabb.top, setup))
+        return;
+
+    // Every edge function is linear in the pixel, so going one pixel right or down adds a constant to it. These are
+    // integers, so stepping them gives exactly what evaluating them at every pixel would.
+    i64 w0_row = setup.at_origin[0];
+    i64 w1_row = setup.at_origin[1];
+    i64 w2_row = setup.at_origin[2];
+
+    for (i32 y = aabb.top; y <= aabb.bottom; ++y)
+    {
+        i64 w0 = w0_row;
+        i64 w1 = w1_row;
+        i64 w2 = w2_row;
+
+        const f32 depth_row = setup.depth.Row(y);
+
+        for (i32 x = aabb.left; x <= aabb.right; ++x)
+        {
+            // If point is on or inside all edges, render pixel.
+            if (w0 <= 0 && w1 <= 0 && w2 <= 0)
+                fragment(x, y, depth_row + setup.depth.step_x * (x - setup.depth.anchor_x));
+
+            w0 += setup.step_x[0];
+            w1 += setup.step_x[1];
+            w2 += setup.step_x[2];
+        }
+
+        w0_row += setup.step_y[0];
+        w1_row += setup.step_y[1];
+        w2_row += setup.step_y[2];
+    }
+}
+
+// Pixels on a side of the square blocks RasterizeBlocks works in. A multiple of SIMD_WIDTH, and TileBins::TILE_SIZE
+// is a multiple of it.
+constexpr i32 BLOCK_SIZE = 8;
+
+// The occlusion test of RasterizeBlocks that never finds anything hidden, and compiles to nothing. See hiz.h for one
+// that does.
+struct NoOcclusion
+{
+    static constexpr bool ENABLED = false;
+
+    bool TriangleOccluded(const AABB&, f32) const noexcept              { return false; }
+    bool BlockOccluded(i32, i32, f32, i32) const noexcept               { return false; }
+    void BlockCovered(i32, i32, f32) const noexcept                     {}
+    void BlockDrawn(i32, i32) const noexcept                            {}
+};
+
+// Rasterize, SIMD_WIDTH pixels of a row at a time. Walks the bounding box in BLOCK_SIZE x BLOCK_SIZE blocks on a grid
+// from (0, 0), and checks the edge functions at the corners of each block first: blocks entirely outside an edge are
+// skipped, and only the edges that go through a block are looked at for its pixels. A block inside all of them is
+// filled without looking at the edges again.
+//
+// The edge functions of a block are taken in i64 at its corners. Within a block an edge goes through, it's at most the
+// block's width of steps from zero, so it fits in i32 lanes.
+//
+// 'fragment' takes both 'fragment(x, y, depth, mask)' for the SIMD_WIDTH pixels from (x, y) rightwards, where 'mask'
+// has the covered ones, and the scalar 'fragment(x, y, depth)' of Rasterize. The scalar one is for the ends of rows
+// that stick out of the viewport, so the vector one only ever gets pixels inside it (all SIMD_WIDTH of them are in the
+// viewport, whether covered or not). Covers the same pixels as Rasterize with the same depths, bit for bit.
+//
+// 'occlusion' is asked, with the nearest depth the triangle has there, whether the whole triangle and then each block
+// is hidden, and is told about every block inside the viewport it has drawn into: with its farthest depth there when
+// it covers the whole block.
+template <typename Fragment, typename Occlusion = NoOcclusion>
+[[gnu::hot]]
+void RasterizeBlocks(
+        const Viewport& viewport, const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2, const Fragment& fragment,
+        const Occlusion& occlusion = Occlusion()
+)
+{
+    static_assert(BLOCK_SIZE % SIMD_WIDTH == 0, "A block row must be a whole number of SIMD registers.");
+
+    using std::min;
+    using std::max;
+
+    const AABB aabb = PixelBounds(viewport, p0, p1, p2);
+
+    TriangleSetup setup;
+    if (aabb.right < aabb.left or aabb.bottom < aabb.top or not Setup(p0, p1, p2, aabb.left, aabb.top, setup))
+        return;
+
+    // ---- OCCLUSION ----
+    // Rounding keeps the depth of a pixel, computed as in the loop below, monotonic along rows and columns like the
+    // plane itself, so over a rectangle of pixels it's nearest and farthest at the corners, exactly. A vertex at z = 0
+    // has an infinite 1/z and no such plane, so isn't tested.
+    const bool tests_occlusion = Occlusion::ENABLED and p0.z != 0 and p1.z != 0 and p2.z != 0;
+
+    const auto Nearest = [&](const i32 left, const i32 top, const i32 right, const i32 bottom) -> f32
+    {
+        return max(max(setup.depth.At(left, top), setup.depth.At(right, top)), max(setup.depth.At(left, bottom), setup.depth.At(right, bottom)));
+    };
+    const auto Farthest = [&](const i32 left, const i32 top, const i32 right, const i32 bottom) -> f32
+    {
+        return min(min(setup.depth.At(left, top), setup.depth.At(right, top)), min(setup.depth.At(left, bottom), setup.depth.At(right, bottom)));
+    };
+
+    if (tests_occlusion and occlusion.TriangleOccluded(aabb, Nearest(aabb.left, aabb.top, aabb.right, aabb.bottom)))
+        return;
+
+    // Blocks on a grid from (0, 0), so they line up with the tiles of binning.h.
+    const i32 first_block_x = aabb.left - (((aabb.left % BLOCK_SIZE) + BLOCK_SIZE) % BLOCK_SIZE);
+    const i32 first_block_y = aabb.top  - (((aabb.top  % BLOCK_SIZE) + BLOCK_SIZE) % BLOCK_SIZE);
+
+    for (i32 block_y = first_block_y; block_y <= aabb.bottom; block_y += BLOCK_SIZE)
+    {
+        for (i32 block_x = first_block_x; block_x <= aabb.right; block_x += BLOCK_SIZE)
+        {
+            // ---- TRIVIAL REJECT AND ACCEPT ----
+            // An edge function is linear, so over a block it's largest and smallest at the corners.
+            bool outside = false;
+            int  crossing_count = 0;
+            int  crossing[3];
+            for (int edge = 0; edge < 3; ++edge)
+            {
+                const i64 a = setup.Edge(edge, block_x,                  block_y);
+                const i64 b = setup.Edge(edge, block_x + BLOCK_SIZE - 1, block_y);
+                const i64 c = setup.Edge(edge, block_x,                  block_y + BLOCK_SIZE - 1);
+                const i64 d = setup.Edge(edge, block_x + BLOCK_SIZE - 1, block_y + BLOCK_SIZE - 1);
+
+                outside |= min(min(a, b), min(c, d)) > 0;
+                if (max(max(a, b), max(c, d)) > 0)
+                    crossing[crossing_count++] = edge;
+            }
+            if (outside)
+                continue;
+
+            const bool inside = crossing_count == 0;
+
+            // The steps of the lanes relative to lane 0, for the edges through the block.
+            SimdInt lane_steps[3];
+            for (int i = 0; i < crossing_count; ++i)
+                lane_steps[i] = LaneIndices() * SimdInt(static_cast<i32>(setup.step_x[crossing[i]]));
+
+            const i32 row_first    = max(block_y, aabb.top);
+            const i32 row_last     = min(block_y + BLOCK_SIZE - 1, aabb.bottom);
+            const i32 column_first = max(block_x, aabb.left);
+            const i32 column_last  = min(block_x + BLOCK_SIZE - 1, aabb.right);
+
+            if (tests_occlusion and occlusion.BlockOccluded(
+                    block_x, block_y, Nearest(column_first, row_first, column_last, row_last),
+                    (column_last - column_first + 1) * (row_last - row_first + 1)))
+                continue;
+
+            for (i32 y = row_first; y <= row_last; ++y)
+            {
+                const f32 depth_row = setup.depth.Row(y);
+
+                for (i32 x = block_x; x < block_x + BLOCK_SIZE; x += SIMD_WIDTH)
+                {
+                    const SimdInt columns = SimdInt(x) + LaneIndices();
+
+                    // Inside the clipped bounding box.
+                    SimdFloat mask = AndNot(columns > SimdInt(aabb.left - 1), columns > SimdInt(aabb.right));
+
+                    // On or inside the edges through the block: none of them positive.
+                    for (int i = 0; i < crossing_count; ++i)
+                    {
+                        const SimdInt w = SimdInt(static_cast<i32>(setup.Edge(crossing[i], x, y))) + lane_steps[i];
+                        mask = AndNot(mask, w > SimdInt(0));
+                    }
+
+                    if (not Any(mask))
+                        continue;
+
+                    const SimdFloat depth = setup.depth.At(x, depth_row);
+
+                    if (x >= viewport.left and x + static_cast<i32>(SIMD_WIDTH) <= viewport.right)
+                    {
+                        fragment(x, y, depth, mask);
+                        continue;
+                    }
+
+                    alignas(SIMD_ALIGNMENT) f32 depths[SIMD_WIDTH];
+                    Store(depths, depth);
+                    const unsigned bits = MoveMask(mask);
+                    for (unsigned lane = 0; lane < SIMD_WIDTH; ++lane)
+                        if (bits & (1u << lane))
+                            fragment(x + static_cast<i32>(lane), y, depths[lane]);
+                }
+            }
+
+            const bool whole_block = row_first == block_y and row_last == block_y + BLOCK_SIZE - 1 and
+                                     column_first == block_x and column_last == block_x + BLOCK_SIZE - 1;
+            const bool in_viewport = block_x >= viewport.left and block_x + BLOCK_SIZE <= viewport.right and
+                                     block_y >= viewport.top  and block_y + BLOCK_SIZE <= viewport.bottom;
+            if (tests_occlusion and inside and whole_block)
+                occlusion.BlockCovered(block_x, block_y, Farthest(column_first, row_first, column_last, row_last));
+            else if (tests_occlusion and in_viewport)
+                occlusion.BlockDrawn(block_x, block_y);
+        }
+    }
+}
+
+// The covered pixels as a list, for when they're needed after the fact. Allocates; drawing should use the streaming
+// Rasterize above.
+std::vector<Pixel> Rasterize(const Viewport& viewport, const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2)
+{
+    std::vector<Pixel> pixels;
+    Rasterize(viewport, p0, p1, p2, [&](const i32 x, const i32 y, const f32 depth)
+    {
+        pixels.emplace_back(x, y, 1 / depth, glm::vec3());
+    });
+
+    return pixels;
+}
+
+// Depth tests a fragment against 'z_buffer' (1/z, see Rasterize) and writes 'color' where it's closer. The fragment
+// functor of Draw. Counts the fragments it shades into 'shaded', when there is one.
+struct DepthTestFragment
+{
+    Array2D<f32>&           z_buffer;
+    const Array2DView<u32>& framebuffer;
+    u32                     color;
+    u64*                    shaded = nullptr;
+
+    inline void operator() (const i32 x, const i32 y, const f32 depth) const noexcept
+    {
+        if (z_buffer(y, x) < depth)
+        {
+            z_buffer(y, x)    = depth;
+            framebuffer(y, x) = color;
+
+            if (shaded)
+                *shaded += 1;
+        }
+    }
+    // SIMD_WIDTH pixels from (x, y) rightwards at once, for RasterizeBlocks.
+    inline void operator() (const i32 x, const i32 y, const SimdFloat& depth, const SimdFloat& covered) const noexcept
+    {
+        f32* depths = &z_buffer(y, x);
+
+        const SimdFloat closer = covered & (LoadU(depths) < depth);
+        StoreMasked(depths, closer, depth);
+        StoreMasked(reinterpret_cast<int32_t*>(&framebuffer(y, x)), closer, SimdInt(static_cast<int32_t>(color)));
+
+        if (shaded)
+            *shaded += static_cast<u64>(__builtin_popcount(MoveMask(closer)));
+    }
+};
+
+// The first pass of a depth pre-pass: DepthTestFragment without the color, so the z-buffer ends up with the closest
+// depth of every pixel before anything is shaded.
+struct DepthOnlyFragment
+{
+    Array2D<f32>& z_buffer;
+
+    inline void operator() (const i32 x, const i32 y, const f32 depth) const noexcept
+    {
+        if (z_buffer(y, x) < depth)
+            z_buffer(y, x) = depth;
+    }
+    // SIMD_WIDTH pixels from (x, y) rightwards at once, for RasterizeBlocks.
+    inline void operator() (const i32 x, const i32 y, const SimdFloat& depth, const SimdFloat& covered) const noexcept
+    {
+        f32* depths = &z_buffer(y, x);
+        StoreMasked(depths, covered & (LoadU(depths) < depth), depth);
+    }
+};
+
+// The second pass of a depth pre-pass: writes 'color' only where the fragment is the one DepthOnlyFragment kept. The
+// same triangle rasterized the same way gives the same depth bit for bit, so every pixel is shaded once, unless two
+// triangles have exactly the same depth there, when both are and the last one wins. Counts into 'shaded' as
+// DepthTestFragment does.
+struct DepthEqualFragment
+{
+    const Array2D<f32>&     z_buffer;
+    const Array2DView<u32>& framebuffer;
+    u32                     color;
+    u64*                    shaded = nullptr;
+
+    inline void operator() (const i32 x, const i32 y, const f32 depth) const noexcept
+    {
+        if (z_buffer(y, x) == depth)
+        {
+            framebuffer(y, x) = color;
+
+            if (shaded)
+                *shaded += 1;
+        }
+    }
+    // SIMD_WIDTH pixels from (x, y) rightwards at once, for RasterizeBlocks.
+    inline void operator() (const i32 x, const i32 y, const SimdFloat& depth, const SimdFloat& covered) const noexcept
+    {
+        const SimdFloat front = covered & (LoadU(&z_buffer(y, x)) == depth);
+        StoreMasked(reinterpret_cast<int32_t*>(&framebuffer(y, x)), front, SimdInt(static_cast<int32_t>(color)));
+
+        if (shaded)
+            *shaded += static_cast<u64>(__builtin_popcount(MoveMask(front)));
+    }
+};
+
+// What the z-buffer is cleared to: 1/z at the far plane, so nothing beyond it is drawn.
+inline f32 FarDepth(const Camera& camera)
+{
+    return 1.0f / camera.far;
+}
+
+
+// Snaps a raster coordinate in pixels to fixed point, clamped to MAX_RASTER_COORDINATE. Clamps the way Min and Max of
+// simd.h do, so a NaN (from a vertex in the camera's plane) clamps the same in TransformVertices.
+inline i32 ToFixedPoint(f32 pixels)
+{
+    const f32 limit = static_cast<f32>(MAX_RASTER_COORDINATE);
+    pixels = pixels < limit  ? pixels : limit;
+    pixels = pixels > -limit ? pixels : -limit;
+    return static_cast<i32>(std::nearbyint(pixels * SUBPIXEL_STEPS));
+}
+
+// http://fabiensanglard.net/polygon_codec/
+// The raster position of a point in camera space: pixel x and y in fixed point, and its depth.
+RasterVertex Project(const Viewport& viewport, const Camera& camera, const glm::vec3& camera_space)
+{
+    using namespace glm;
+
+    // Dimensions of the produced image.
+    const i32 image_width  = viewport.right  - viewport.left;
+    const i32 image_height = viewport.bottom - viewport.top;
+
+    // Assuming device ratio is the same as film ratio, for now.
+    const f32 film_aspect_ratio   = camera.film_aperture_width / camera.film_aperture_height;
+    const f32 device_aspect_ratio = image_width / static_cast<f32>(image_height);
+    Assert(device_aspect_ratio - film_aspect_ratio < 0.001f, "They are different! (%f != %f)", device_aspect_ratio, film_aspect_ratio);
+
+    // Image plane coordinates.
+    const f32 image_plane_top    = ((camera.film_aperture_height / 2) / camera.focal_length) * camera.distance_to_canvas;
+    const f32 image_plane_right  = ((camera.film_aperture_width  / 2) / camera.focal_length) * camera.distance_to_canvas;
+    const f32 image_plane_bottom = -image_plane_top;
+    const f32 image_plane_left   = -image_plane_right;
+
+    // const f32 fov = 2 * 180 / PI * std::atan((camera.film_aperture_width / 2) / camera.focal_length);
+
+    // The vertex's location in camera space projected onto the image plane.
+    const f32 screen_position_x = (camera_space.x / -camera_space.z) * camera.distance_to_canvas;
+    const f32 screen_position_y = (camera_space.y / -camera_space.z) * camera.distance_to_canvas;
+
+    // Normalize between [-1, 1]
+    const f32 r = image_plane_right;
+    const f32 l = image_plane_left;
+    const f32 t = image_plane_top;
+    const f32 b = image_plane_bottom;
+    const f32 normalized_device_coordinate_x = (2 * screen_position_x) / (r - l) - (r + l) / (r - l);
+    const f32 normalized_device_coordinate_y = (2 * screen_position_y) / (t - b) - (t + b) / (t - b);
+
+    // Pixel coordinate on image (in raster space, the y is down, so invert direction).
+    const f32 raster_x = ((normalized_device_coordinate_x + 1) / 2) * image_width;
+    const f32 raster_y = ((normalized_device_coordinate_y + 1) / 2) * image_height;
+    const f32 raster_z = -camera_space.z;
+
+    return { ToFixedPoint(raster_x), ToFixedPoint(raster_y), raster_z };
+}
+
+// The vertex's raster position. Only meaningful in front of the near plane; see ClipTriangle for the rest.
+RasterVertex VertexShader(const Viewport& viewport, const Vertex& vertex, const Camera& camera)
+{
+    // Homogeneous coordinate w is 1 (since we don't do perspective), so no need to divide.
+    // Vertex world position in relation to the camera.
+    const glm::vec3 camera_space = camera.cached_rotation_matrix * (vertex.position - camera.position);
+
+    return Project(viewport, camera, camera_space);
+}
+
+// 'lit' is how much of the light reaches the pixel, from 0 in shadow to 1 (see shadows.h). The ambient light always
+// does.
+glm::vec3 PixelShader(const Pixel& pixel, const Light& light, const glm::vec3& normal, const glm::vec3& color, const f32 lit = 1.0f)
+{
+    using namespace glm;
+
+    const vec3 world_position = pixel.inverted_world_position * pixel.z;
+
+    // Reflectance
+    const vec3 fragment_to_light  = light.position - world_position;
+    const vec3 direction_to_light = normalize(fragment_to_light);
+    const f32  radius = length(fragment_to_light);
+
+    const f32 factor = max(dot(direction_to_light, normal), 0.0f);
+
+    const vec3 specular = (lit * factor * light.color) / (4.0f * PI * radius * radius);
+    const vec3 illumination = /* reflectance */ vec3(1.0f) * (specular + light.ambient);
+    const vec3 output_color = clamp(color * illumination, vec3(0), vec3(1));
+
+    return output_color;
+}
+
+[[gnu::const]] inline
+glm::mat4 PerspectiveMatrix(const float near, const float far, const float fov)
+{
+    // https://www.scratchapixel.com/lessons/3d-basic-rendering/perspective-and-orthographic-projection-matrix/building-basic-perspective-projection-matrix
+    const f32 s = 1 / tan((fov / 2) * PI / 180);  // Scaling factor.
+    const f32 a = -far / (far - near);            // Map to 0 factor.
+    const f32 b = -(far * near) / (far - near);   // Map to 1 factor.
+
+    return glm::mat4(
+            glm::vec4(s, 0, 0, 0),
+            glm::vec4(0, s, 0, 0),
+            glm::vec4(0, 0, a, -1),
+            glm::vec4(0, 0, b, 0)
+    );
+}
+
+
+// The volume the camera sees, in camera space: between the near and far planes, and inside the pyramid through the
+// edges of the image plane. The same image plane as VertexShader projects onto, from the film aperture and the focal
+// length; 'camera.fov' and 'camera.image_plane' don't describe it (the latter is rounded to whole units).
+//
+// Around it, the guard band: the same pyramid GUARD_BAND times as wide and high. A triangle with its vertices in front
+// of the near plane and inside the guard band is rasterized as it is, and only the rest are clipped (see ClipTriangle).
+struct Frustum
+{
+    static constexpr f32 GUARD_BAND = 32.0f;
+
+    glm::vec3 position;
+    glm::mat3 rotation;
+    f32       near;
+    f32       far;
+    f32       right;  // The image plane's half width and height at a distance of one.
+    f32       top;
+
+    // The planes a vertex is outside of, as the bits of its outcode.
+    static constexpr u32 OUTSIDE_NEAR         = 1u << 0;
+    static constexpr u32 OUTSIDE_FAR          = 1u << 1;
+    static constexpr u32 OUTSIDE_RIGHT        = 1u << 2;
+    static constexpr u32 OUTSIDE_LEFT         = 1u << 3;
+    static constexpr u32 OUTSIDE_TOP          = 1u << 4;
+    static constexpr u32 OUTSIDE_BOTTOM       = 1u << 5;
+    static constexpr u32 OUTSIDE_GUARD_RIGHT  = 1u << 6;
+    static constexpr u32 OUTSIDE_GUARD_LEFT   = 1u << 7;
+    static constexpr u32 OUTSIDE_GUARD_TOP    = 1u << 8;
+    static constexpr u32 OUTSIDE_GUARD_BOTTOM = 1u << 9;
+
+    // A triangle with a vertex outside any of these is clipped before it's drawn.
+    static constexpr u32 CLIPPED_BY = OUTSIDE_NEAR | OUTSIDE_GUARD_RIGHT | OUTSIDE_GUARD_LEFT | OUTSIDE_GUARD_TOP | OUTSIDE_GUARD_BOTTOM;
+};
+
+Frustum ViewFrustum(const Camera& camera)
+{
+    return {
+        camera.position, camera.cached_rotation_matrix, camera.near, camera.far,
+        (camera.film_aperture_width  / 2) / camera.focal_length,
+        (camera.film_aperture_height / 2) / camera.focal_length
+    };
+}
+
+// Why a triangle can't be seen, if it can't.
+enum class Visibility
+{
+    VISIBLE,
+    BACK_FACING,      // Its normal points away from the camera, so it's the back of a surface.
+    OUTSIDE_FRUSTUM,  // All of its vertices are outside the same plane of the frustum.
+    CLIPPED,          // Visible, but it pokes through the near plane or out of the guard band, so it's clipped first.
+};
+
+// The planes of the frustum and the guard band the vertex at 'v' in camera space is outside of. The camera looks down
+// -z, so a vertex's distance in front of it is -z.
+inline u32 Outcode(const Frustum& frustum, const glm::vec3& v)
+{
+    const f32 guard_right = frustum.right * Frustum::GUARD_BAND;
+    const f32 guard_top   = frustum.top   * Frustum::GUARD_BAND;
+
+    return (-v.z < frustum.near              ? Frustum::OUTSIDE_NEAR         : 0u) |
+           (-v.z > frustum.far               ? Frustum::OUTSIDE_FAR          : 0u) |
+           (v.x >  frustum.right * -v.z      ? Frustum::OUTSIDE_RIGHT        : 0u) |
+           (v.x < -frustum.right * -v.z      ? Frustum::OUTSIDE_LEFT         : 0u) |
+           (v.y >  frustum.top   * -v.z      ? Frustum::OUTSIDE_TOP          : 0u) |
+           (v.y < -frustum.top   * -v.z      ? Frustum::OUTSIDE_BOTTOM       : 0u) |
+           (v.x >  guard_right   * -v.z      ? Frustum::OUTSIDE_GUARD_RIGHT  : 0u) |
+           (v.x < -guard_right   * -v.z      ? Frustum::OUTSIDE_GUARD_LEFT   : 0u) |
+           (v.y >  guard_top     * -v.z      ? Frustum::OUTSIDE_GUARD_TOP    : 0u) |
+           (v.y < -guard_top     * -v.z      ? Frustum::OUTSIDE_GUARD_BOTTOM : 0u);
+}
+
+// Decides on a triangle before anything is projected, from its normal and the outcodes of its vertices. Behind the
+// camera VertexShader divides by a negative depth and gives garbage, and far outside the guard band its raster
+// positions don't fit in fixed point, so a triangle with a vertex there is clipped rather than drawn as it is.
+inline Visibility Cull(
+        const glm::vec3& eye, const glm::vec3& normal, const glm::vec3& v0,
+        const u32 outcode0, const u32 outcode1, const u32 outcode2
+)
+{
+    if (glm::dot(normal, v0 - eye) >= 0)
+        return Visibility::BACK_FACING;
+
+    // All outside the same plane.
+    if ((outcode0 & outcode1 & outcode2) != 0)
+        return Visibility::OUTSIDE_FRUSTUM;
+
+    if (((outcode0 | outcode1 | outcode2) & Frustum::CLIPPED_BY) != 0)
+        return Visibility::CLIPPED;
+
+    return Visibility::VISIBLE;
+}
+
+Visibility Cull(const Frustum& frustum, const Triangle& triangle)
+{
+    return Cull(
+        frustum.position, triangle.normal, triangle.v0,
+        Outcode(frustum, frustum.rotation * (triangle.v0 - frustum.position)),
+        Outcode(frustum, frustum.rotation * (triangle.v1 - frustum.position)),
+        Outcode(frustum, frustum.rotation * (triangle.v2 - frustum.position))
+    );
+}
+
+// How many triangles went into a frame, how many of them culling dropped and why, and how many of the rest were clipped.
+struct CullingStats
+{
+    u64 submitted       = 0;
+    u64 back_facing     = 0;
+    u64 outside_frustum = 0;
+    u64 occluded        = 0;  // Skipped with their cluster, before the vertex stage (see occlusion.h).
+    u64 clipped         = 0;
+};
+
+CullingStats& operator+= (CullingStats& total, const CullingStats& stats)
+{
+    total.submitted       += stats.submitted;
+    total.back_facing     += stats.back_facing;
+    total.outside_frustum += stats.outside_frustum;
+    total.occluded        += stats.occluded;
+    total.clipped         += stats.clipped;
+    return total;
+}
+
+inline u64 Culled(const CullingStats& stats)
+{
+    return stats.back_facing + stats.outside_frustum + stats.occluded;
+}
+
+// Counts a triangle Cull has decided on in 'stats', and returns whether it's still to be drawn.
+inline bool Visible(const Visibility visibility, CullingStats& stats)
+{
+    stats.submitted += 1;
+
+    switch (visibility)
+    {
+        case Visibility::VISIBLE:         return true;
+        case Visibility::BACK_FACING:     stats.back_facing     += 1; return false;
+        case Visibility::OUTSIDE_FRUSTUM: stats.outside_frustum += 1; return false;
+        case Visibility::CLIPPED:         stats.clipped         += 1; return true;
+    }
+    return false;
+}
+
+
+// ---- CLIPPING ----
+
+// What's left of a triangle after clipping: a convex polygon, drawn as the fan of triangles (0, i + 1, i + 2), its
+// pieces. Keeps the barycentric coordinates of the triangle's second and third vertex at every vertex, for what's
+// interpolated over the whole triangle (see GBufferFragment).
+struct ClippedPolygon
+{
+    static constexpr u32 MAX_VERTICES = 3 + 5;  // Every plane clipped to can add a vertex.
+
+    RasterVertex vertices[MAX_VERTICES];
+    glm::vec2    barycentrics[MAX_VERTICES];
+    u32          count   = 0;
+    bool         clipped = false;  // Whether it went through ClipTriangle, or is just the triangle.
+};
+
+inline u32 PieceCount(const ClippedPolygon& polygon)
+{
+    return polygon.count >= 3 ? polygon.count - 2 : 0;
+}
+
+// The barycentric coordinates of a triangle's second and third vertex at the vertices of one of its pieces.
+struct PieceBarycentrics
+{
+    glm::vec2 vertices[3];
+};
+
+inline PieceBarycentrics WholeTriangle()
+{
+    return { { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.0f, 1.0f) } };
+}
+
+inline PieceBarycentrics Barycentrics(const ClippedPolygon& polygon, const u32 piece)
+{
+    return { { polygon.barycentrics[0], polygon.barycentrics[piece + 1], polygon.barycentrics[piece + 2] } };
+}
+
+// Clips the triangle with its vertices at 'camera_space' to the near plane and the guard band of the frustum. Camera
+// space is the homogeneous space of the projection, with w = -z, so the planes are linear in it and so is everything
+// between the vertices; the distances to the planes are the very products Outcode compares, so a vertex is moved
+// exactly when its outcode says it's outside.
+//
+// 'rasters' are what VertexShader gives for the vertices, and the ones that aren't moved keep them, so the pieces still
+// share their edges with the triangle's neighbours bit for bit. A new vertex is always interpolated from the end of its
+// edge that's inside the plane, so the neighbour across the edge gets the very same one. Every vertex of the polygon is
+// inside the guard band, so no raster position needs clamping, and its bounding box is clipped to the viewport as any
+// other triangle's.
+void ClipTriangle(
+        const Frustum& frustum, const Camera& camera, const Viewport& viewport,
+        const glm::vec3 (&camera_space)[3], const RasterVertex (&rasters)[3], ClippedPolygon& polygon
+)
+{
+    using namespace glm;
+
+    struct ClipVertex
+    {
+        vec3         position;
+        vec2         barycentrics;
+        RasterVertex raster;
+        bool         projected;  // Whether 'raster' is known yet.
+    };
+
+    const f32 guard_right = frustum.right * Frustum::GUARD_BAND;
+    const f32 guard_top   = frustum.top   * Frustum::GUARD_BAND;
+
+    // How far inside the near plane and the sides of the guard band a point is, as Outcode tests it.
+    const auto Distance = [&](const vec3& v, const int plane) -> f32
+    {
+        switch (plane)
+        {
+            case 0:  return -v.z - frustum.near;
+            case 1:  return guard_right * -v.z - v.x;
+            case 2:  return v.x + guard_right * -v.z;
+            case 3:  return guard_top * -v.z - v.y;
+            default: return v.y + guard_top * -v.z;
+        }
+    };
+
+    ClipVertex buffers[2][ClippedPolygon::MAX_VERTICES];
+    const vec2 corners[3] = { vec2(0.0f, 0.0f), vec2(1.0f, 0.0f), vec2(0.0f, 1.0f) };
+    for (u32 i = 0; i < 3; ++i)
+        buffers[0][i] = { camera_space[i], corners[i], rasters[i], true };
+
+    // Sutherland-Hodgman, a plane at a time.
+    u32 count = 3;
+    for (int plane = 0; plane < 5 and count > 0; ++plane)
+    {
+        const ClipVertex* in  = buffers[plane % 2];
+        ClipVertex*       out = buffers[(plane + 1) % 2];
+
+        u32 kept = 0;
+        for (u32 i = 0; i < count; ++i)
+        {
+            const ClipVertex& a = in[i];
+            const ClipVertex& b = in[(i + 1) % count];
+            const f32 distance_a = Distance(a.position, plane);
+            const f32 distance_b = Distance(b.position, plane);
+
+            if (distance_a >= 0)
+                out[kept++] = a;
+
+            if ((distance_a >= 0) != (distance_b >= 0))
+            {
+                const ClipVertex& inside  = distance_a >= 0 ? a : b;
+                const ClipVertex& outside = distance_a >= 0 ? b : a;
+                const f32 inside_distance  = distance_a >= 0 ? distance_a : distance_b;
+                const f32 outside_distance = distance_a >= 0 ? distance_b : distance_a;
+                const f32 t = inside_distance / (inside_distance - outside_distance);
+
+                out[kept++] = {
+                    inside.position     + t * (outside.position     - inside.position),
+                    inside.barycentrics + t * (outside.barycentrics - inside.barycentrics),
+                    RasterVertex(), false
+                };
+            }
+        }
+        count = kept;
+    }
+
+    const ClipVertex* clipped = buffers[5 % 2];
+    polygon.count   = count;
+    polygon.clipped = true;
+    for (u32 i = 0; i < count; ++i)
+    {
+        polygon.vertices[i]     = clipped[i].projected ? clipped[i].raster : Project(viewport, camera, clipped[i].position);
+        polygon.barycentrics[i] = clipped[i].barycentrics;
+    }
+}
+
+// ---- INDEXED MESH ----
+
+// Triangles that share their vertices: every distinct position once, and three indices into them per triangle, so the
+// vertex stage transforms a vertex once however many triangles it's in. The positions are a structure of arrays, one
+// aligned array per axis padded to a multiple of SIMD_WIDTH, so SIMD_WIDTH vertices load straight into registers.
+//
+// The triangles are also split into clusters, runs of them that hang together the way a model lists an object's
+// triangles, with the box around each, so occlusion culling can skip a whole cluster before its vertices are
+// transformed (see occlusion.h). Vertices are numbered in the order the triangles first use them, so a cluster's are
+// close together.
+
+// The triangles ['first_triangle', 'last_triangle') and the box around them. Their vertices are all in
+// ['first_vertex', 'last_vertex'), with maybe some of other clusters' in between.
+struct Cluster
+{
+    u32       first_triangle, last_triangle;
+    u32       first_vertex,   last_vertex;
+    glm::vec3 min, max;
+};
+
+struct Mesh
+{
+    static constexpr u32 CLUSTER_TRIANGLES = 64;  // At most, per cluster.
+    static constexpr u32 MAX_OCCLUDERS     = 32;
+
+    AlignedVector<f32>     positions[3];
+    u32                    vertex_count = 0;  // Without the padding.
+    std::vector<u32>       indices;
+    std::vector<glm::vec3> normals;           // One per triangle, for culling.
+    std::vector<u32>       colors;            // One per triangle, as ColorCode.
+    std::vector<glm::vec3> shading_colors;    // One per triangle, as PixelShader takes them.
+    std::vector<Cluster>   clusters;          // In order, covering every triangle.
+    std::vector<u32>       occluders;         // The largest triangles, the largest first, to occlude the clusters with.
+};
+
+inline u32 TriangleCount(const Mesh& mesh)
+{
+    return static_cast<u32>(mesh.normals.size());
+}
+
+inline glm::vec3 Position(const Mesh& mesh, const u32 vertex)
+{
+    return glm::vec3(mesh.positions[0][vertex], mesh.positions[1][vertex], mesh.positions[2][vertex]);
+}
+
+// Merges the vertices of 'triangles' that are at exactly the same position.
+Mesh IndexedMesh(const std::vector<Triangle>& triangles)
+{
+    Mesh mesh;
+    mesh.indices.reserve(3 * triangles.size());
+    mesh.normals.reserve(triangles.size());
+    mesh.colors.reserve(triangles.size());
+    mesh.shading_colors.reserve(triangles.size());
+
+    std::map<std::tuple<f32, f32, f32>, u32> vertices;
+    const auto Index = [&](const glm::vec3& position) -> u32
+    {
+        const auto inserted = vertices.emplace(std::make_tuple(position.x, position.y, position.z), mesh.vertex_count);
+        if (inserted.second)
+        {
+            for (unsigned axis = 0; axis < 3; ++axis)
+                mesh.positions[axis].push_back(position[axis]);
+            mesh.vertex_count += 1;
+        }
+        return inserted.first->second;
+    };
+
+    // The cluster each vertex was last used by, to tell whether a triangle hangs together with the cluster so far.
+    std::vector<u32> vertex_clusters;
+
+    for (const Triangle& triangle : triangles)
+    {
+        const u32 triangle_index = static_cast<u32>(mesh.normals.size());
+        const u32 corners[3]     = { Index(triangle.v0), Index(triangle.v1), Index(triangle.v2) };
+        vertex_clusters.resize(mesh.vertex_count, ~0u);
+
+        // A new cluster when this one is full, or when the triangle shares no vertex with it.
+        const u32 current = static_cast<u32>(mesh.clusters.size()) - 1;
+        const bool shares = not mesh.clusters.empty() and
+                            (vertex_clusters[corners[0]] == current or vertex_clusters[corners[1]] == current or vertex_clusters[corners[2]] == current);
+        if (not shares or mesh.clusters.back().last_triangle - mesh.clusters.back().first_triangle == Mesh::CLUSTER_TRIANGLES)
+            mesh.clusters.push_back({ triangle_index, triangle_index, corners[0], corners[0] + 1, triangle.v0, triangle.v0 });
+
+        Cluster& cluster = mesh.clusters.back();
+        cluster.last_triangle = triangle_index + 1;
+
+        for (const u32 corner : corners)
+        {
+            const glm::vec3 position = Position(mesh, corner);
+            cluster.first_vertex = std::min(cluster.first_vertex, corner);
+            cluster.last_vertex  = std::max(cluster.last_vertex,  corner + 1);
+            cluster.min          = glm::min(cluster.min, position);
+            cluster.max          = glm::max(cluster.max, position);
+            vertex_clusters[corner] = static_cast<u32>(mesh.clusters.size()) - 1;
+        }
+
+        mesh.indices.insert(mesh.indices.end(), corners, corners + 3);
+        mesh.normals.push_back(triangle.normal);
+        mesh.colors.push_back(ColorCode(triangle.color));
+        mesh.shading_colors.push_back(triangle.color);
+    }
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+        while (mesh.positions[axis].size() % SIMD_WIDTH != 0)
+            mesh.positions[axis].push_back(0.0f);
+
+    // Twice the area of every triangle, to pick the largest as occluders.
+    std::vector<f32> areas (mesh.normals.size());
+    for (u32 i = 0; i < areas.size(); ++i)
+    {
+        const glm::vec3 v0 = Position(mesh, mesh.indices[3 * i + 0]);
+        areas[i] = glm::length(glm::cross(Position(mesh, mesh.indices[3 * i + 1]) - v0, Position(mesh, mesh.indices[3 * i + 2]) - v0));
+    }
+
+    mesh.occluders.resize(areas.size());
+    for (u32 i = 0; i < areas.size(); ++i)
+        mesh.occluders[i] = i;
+    std::stable_sort(mesh.occluders.begin(), mesh.occluders.end(), [&](const u32 a, const u32 b) { return areas[a] > areas[b]; });
+    mesh.occluders.resize(std::min<size_t>(mesh.occluders.size(), Mesh::MAX_OCCLUDERS));
+
+    return mesh;
+}
+
+
+// The mesh's vertices after the vertex stage, in the same layout: what VertexShader gives for each, and its outcode.
+// Sized once for the mesh and then reused, so the vertex stage doesn't allocate.
+struct VertexBuffer
+{
+    AlignedVector<i32> rasters[2];  // Fixed point x and y.
+    AlignedVector<f32> depths;
+    AlignedVector<u32> outcodes;
+};
+
+inline RasterVertex Raster(const VertexBuffer& vertices, const u32 vertex)
+{
+    return { vertices.rasters[0][vertex], vertices.rasters[1][vertex], vertices.depths[vertex] };
+}
+
+void Resize(VertexBuffer& vertices, const Mesh& mesh)
+{
+    for (unsigned axis = 0; axis < 2; ++axis)
+        vertices.rasters[axis].resize(mesh.positions[0].size());
+    vertices.depths.resize(mesh.positions[0].size());
+    vertices.outcodes.resize(mesh.positions[0].size());
+}
+
+// VertexShader and Outcode on the vertices in ['first', 'last'), SIMD_WIDTH at a time. Does exactly the operations
+// VertexShader does, in the same order, so the results are the same bit for bit. 'first' and 'last' are multiples of
+// SIMD_WIDTH (or the padded end of the mesh), and 'vertices' has been Resize'd for the mesh.
+[[gnu::hot]]
+void TransformVertices(
+        const Camera& camera, const Viewport& viewport, const Mesh& mesh, VertexBuffer& vertices,
+        const u32 first, const u32 last
+)
+{
+    const i32 image_width  = viewport.right  - viewport.left;
+    const i32 image_height = viewport.bottom - viewport.top;
+
+    const f32 film_aspect_ratio   = camera.film_aperture_width / camera.film_aperture_height;
+    const f32 device_aspect_ratio = image_width / static_cast<f32>(image_height);
+    Assert(device_aspect_ratio - film_aspect_ratio < 0.001f, "They are different! (%f != %f)", device_aspect_ratio, film_aspect_ratio);
+
+    const f32 t = ((camera.film_aperture_height / 2) / camera.focal_length) * camera.distance_to_canvas;
+    const f32 r = ((camera.film_aperture_width  / 2) / camera.focal_length) * camera.distance_to_canvas;
+    const f32 b = -t;
+    const f32 l = -r;
+
+    const glm::mat3& rotation = camera.cached_rotation_matrix;
+    const Frustum    frustum  = ViewFrustum(camera);
+
+    // The guard band has to fit in fixed point, so nothing inside it is clamped.
+    const f32 guard_right = frustum.right * Frustum::GUARD_BAND;
+    const f32 guard_top   = frustum.top   * Frustum::GUARD_BAND;
+    Assert((Frustum::GUARD_BAND + 1) / 2 * static_cast<f32>(std::max(image_width, image_height)) < MAX_RASTER_COORDINATE,
+        "The guard band doesn't fit in fixed point at %i x %i pixels.", image_width, image_height);
+
+    const SimdInt   none  (0);
+    const SimdFloat limit (static_cast<f32>(MAX_RASTER_COORDINATE));
+
+    // As ToFixedPoint.
+    const auto FixedPoint = [&](const SimdFloat& pixels) -> SimdInt
+    {
+        return RoundToInt(Max(Min(pixels, limit), -limit) * SimdFloat(static_cast<f32>(SUBPIXEL_STEPS)));
+    };
+
+    for (u32 i = first; i < last; i += SIMD_WIDTH)
+    {
+        const SimdFloat x = Load(&mesh.positions[0][i]) - SimdFloat(camera.position.x);
+        const SimdFloat y = Load(&mesh.positions[1][i]) - SimdFloat(camera.position.y);
+        const SimdFloat z = Load(&mesh.positions[2][i]) - SimdFloat(camera.position.z);
+
+        // As glm's matrix times vector.
+        const SimdFloat camera_x = SimdFloat(rotation[0][0]) * x + SimdFloat(rotation[1][0]) * y + SimdFloat(rotation[2][0]) * z;
+        const SimdFloat camera_y = SimdFloat(rotation[0][1]) * x + SimdFloat(rotation[1][1]) * y + SimdFloat(rotation[2][1]) * z;
+        const SimdFloat camera_z = SimdFloat(rotation[0][2]) * x + SimdFloat(rotation[1][2]) * y + SimdFloat(rotation[2][2]) * z;
+
+        const SimdFloat screen_x = (camera_x / -camera_z) * SimdFloat(camera.distance_to_canvas);
+        const SimdFloat screen_y = (camera_y / -camera_z) * SimdFloat(camera.distance_to_canvas);
+
+        const SimdFloat ndc_x = (SimdFloat(2.0f) * screen_x) / SimdFloat(r - l) - SimdFloat((r + l) / (r - l));
+        const SimdFloat ndc_y = (SimdFloat(2.0f) * screen_y) / SimdFloat(t - b) - SimdFloat((t + b) / (t - b));
+
+        const SimdFloat raster_x = ((ndc_x + SimdFloat(1.0f)) / SimdFloat(2.0f)) * SimdFloat(static_cast<f32>(image_width));
+        const SimdFloat raster_y = ((ndc_y + SimdFloat(1.0f)) / SimdFloat(2.0f)) * SimdFloat(static_cast<f32>(image_height));
+
+        StoreU(&vertices.rasters[0][i], FixedPoint(raster_x));
+        StoreU(&vertices.rasters[1][i], FixedPoint(raster_y));
+        StoreU(&vertices.depths[i],     -camera_z);
+
+        // As Outcode.
+        const SimdFloat distance = -camera_z;
+        const SimdInt outcode =
+            Select(distance < SimdFloat(frustum.near),                  SimdInt(Frustum::OUTSIDE_NEAR),         none) |
+            Select(distance > SimdFloat(frustum.far),                   SimdInt(Frustum::OUTSIDE_FAR),          none) |
+            Select(camera_x >  SimdFloat(frustum.right) * distance,     SimdInt(Frustum::OUTSIDE_RIGHT),        none) |
+            Select(camera_x < -SimdFloat(frustum.right) * distance,     SimdInt(Frustum::OUTSIDE_LEFT),         none) |
+            Select(camera_y >  SimdFloat(frustum.top)   * distance,     SimdInt(Frustum::OUTSIDE_TOP),          none) |
+            Select(camera_y < -SimdFloat(frustum.top)   * distance,     SimdInt(Frustum::OUTSIDE_BOTTOM),       none) |
+            Select(camera_x >  SimdFloat(guard_right)   * distance,     SimdInt(Frustum::OUTSIDE_GUARD_RIGHT),  none) |
+            Select(camera_x < -SimdFloat(guard_right)   * distance,     SimdInt(Frustum::OUTSIDE_GUARD_LEFT),   none) |
+            Select(camera_y >  SimdFloat(guard_top)     * distance,     SimdInt(Frustum::OUTSIDE_GUARD_TOP),    none) |
+            Select(camera_y < -SimdFloat(guard_top)     * distance,     SimdInt(Frustum::OUTSIDE_GUARD_BOTTOM), none);
+        StoreU(reinterpret_cast<int32_t*>(&vertices.outcodes[i]), outcode);
+    }
+}
+
+// Culls the mesh's 'triangle', counting it in 'stats', and gives what's to be drawn of it if anything: the triangle
+// itself, or what's left of it after ClipTriangle.
+inline bool VisibleTriangle(
+        const Camera& camera, const Viewport& viewport, const Mesh& mesh, const VertexBuffer& vertices,
+        const u32 triangle, CullingStats& stats, ClippedPolygon& polygon
+)
+{
+    const u32 i0 = mesh.indices[3 * triangle + 0];
+    const u32 i1 = mesh.indices[3 * triangle + 1];
+    const u32 i2 = mesh.indices[3 * triangle + 2];
+
+    const Visibility visibility = Cull(
+        camera.position, mesh.normals[triangle], Position(mesh, i0),
+        vertices.outcodes[i0], vertices.outcodes[i1], vertices.outcodes[i2]
+    );
+    if (not Visible(visibility, stats))
+        return false;
+
+    const RasterVertex rasters[3] = { Raster(vertices, i0), Raster(vertices, i1), Raster(vertices, i2) };
+
+    if (visibility == Visibility::CLIPPED)
+    {
+        // As TransformVertices, so the distances to the planes agree with the outcodes.
+        const glm::mat3& rotation = camera.cached_rotation_matrix;
+        const glm::vec3 camera_space[3] = {
+            rotation * (Position(mesh, i0) - camera.position),
+            rotation * (Position(mesh, i1) - camera.position),
+            rotation * (Position(mesh, i2) - camera.position)
+        };
+        ClipTriangle(ViewFrustum(camera), camera, viewport, camera_space, rasters, polygon);
+        return PieceCount(polygon) > 0;
+    }
+
+    const PieceBarycentrics whole = WholeTriangle();
+    for (u32 i = 0; i < 3; ++i)
+    {
+        polygon.vertices[i]     = rasters[i];
+        polygon.barycentrics[i] = whole.vertices[i];
+    }
+    polygon.count   = 3;
+    polygon.clipped = false;
+    return true;
+}
+
+
+// Draws every triangle of the mesh into 'framebuffer', keeping the closest one in each pixel with 'z_buffer' (which
+// holds 1/z). 'vertices' holds the transformed vertices in between. All three are the caller's, and every pixel of
+// 'framebuffer' is written. Returns what culling dropped.
+CullingStats Draw(
+        const Camera& camera, const Viewport& viewport, const Mesh& mesh, VertexBuffer& vertices,
+        Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer
+)
+{
+    Clear(framebuffer);
+    Fill(z_buffer, FarDepth(camera));
+
+    Resize(vertices, mesh);
+    TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+
+    CullingStats   culling;
+    ClippedPolygon polygon;
+
+    for (u32 triangle = 0; triangle < TriangleCount(mesh); ++triangle)
+    {
+        if (not VisibleTriangle(camera, viewport, mesh, vertices, triangle, culling, polygon))
+            continue;
+
+        const DepthTestFragment fragment { z_buffer, framebuffer, mesh.colors[triangle] };
+        for (u32 piece = 0; piece < PieceCount(polygon); ++piece)
+            RasterizeBlocks(viewport, polygon.vertices[0], polygon.vertices[piece + 1], polygon.vertices[piece + 2], fragment);
+    }
+
+    return culling;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+
+// A point light.
+struct Light
+{
+    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 color    = glm::vec3(1.0f, 1.0f, 1.0f) * 14.0f;
+    glm::vec3 ambient  = glm::vec3(1.0f, 1.0f, 1.0f) *  0.5f;
+};
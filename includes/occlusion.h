@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "lab3.h"
+#include "threadpool.h"
+
+
+// Occlusion culling for Lab3, before the vertex stage. The mesh's largest triangles, its occluders, are rasterized into
+// a depth buffer of cells of CELL_SIZE x CELL_SIZE pixels, and a cluster of the mesh (see Mesh) whose box is behind
+// them everywhere it could be on screen is culled whole: none of its vertices are transformed and none of its triangles
+// are set up.
+//
+// It's conservative, so the image is the same bit for bit. An occluder only counts in the cells where it covers every
+// pixel centre, which the rasterizers then fill with it or with something closer, and a cell holds the farthest depth
+// the occluder has at those pixels. A cluster is culled only when its nearest corner is farther than that in every cell
+// it could cover, by DEPTH_MARGIN for how differently the box and the triangles in it round. Occluders in clusters that
+// are culled themselves don't matter: they're behind occluders that are drawn.
+//
+// Coverage takes the edge functions of Setup SIMD_WIDTH cells at a time. In f32 rather than the i64 they're exact in,
+// so a cell is only taken as covered when it's inside every edge by more than the rounding could be off by, and a thin
+// strip along the edges is given up.
+
+
+// What occlusion culling did in the last frame.
+struct ClusterStats
+{
+    u64 clusters  = 0;
+    u64 culled    = 0;  // Hidden behind the occluders, or off screen.
+    u64 occluders = 0;  // Drawn into the buffer.
+};
+
+ClusterStats& operator+= (ClusterStats& total, const ClusterStats& stats)
+{
+    total.clusters  += stats.clusters;
+    total.culled    += stats.culled;
+    total.occluders += stats.occluders;
+    return total;
+}
+
+struct OcclusionBuffer
+{
+    static constexpr i32 CELL_SIZE    = 4;              // Pixels on a side of a cell.
+    static constexpr i32 MIN_OCCLUDER = 16 * 16;        // Pixels a triangle must cover to be worth drawing as an occluder.
+    static constexpr f32 DEPTH_MARGIN = 1.0f / 1024;   // Relative.
+
+    // 1/z, as in the z-buffer, of the farthest occluder pixel in every cell, or 0 where no occluder covers it. The rows
+    // are padded to a multiple of SIMD_WIDTH cells.
+    Array2D<f32> depths { 0, 0 };
+};
+
+// Covers a viewport of 'viewport.bottom' rows and 'viewport.right' columns of pixels. Only allocates when the size
+// changes.
+void Resize(OcclusionBuffer& buffer, const Viewport& viewport)
+{
+    const unsigned rows    = static_cast<unsigned>((viewport.bottom + OcclusionBuffer::CELL_SIZE - 1) / OcclusionBuffer::CELL_SIZE);
+    const unsigned columns = static_cast<unsigned>((viewport.right  + OcclusionBuffer::CELL_SIZE - 1) / OcclusionBuffer::CELL_SIZE);
+    const unsigned padded  = (columns + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+
+    if (buffer.depths.rows != rows or buffer.depths.columns != padded)
+        buffer.depths = Array2D<f32>(rows, padded);
+}
+
+
+// Draws the triangle into the cells it covers whole, where it's closer than what's there. 'p0', 'p1' and 'p2' are as
+// VertexShader gives them, in front of the near plane and inside the guard band.
+[[gnu::hot]]
+void DrawOccluder(OcclusionBuffer& buffer, const Viewport& viewport, const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2)
+{
+    constexpr i32 CELL_SIZE = OcclusionBuffer::CELL_SIZE;
+
+    const AABB bounds = PixelBounds(viewport, p0, p1, p2);
+
+    TriangleSetup setup;
+    if (bounds.right < bounds.left or bounds.bottom < bounds.top or not Setup(p0, p1, p2, bounds.left, bounds.top, setup))
+        return;
+
+    // The cells with all their pixels in the bounds, rounded out to whole registers on the left.
+    const i32 first_column = (bounds.left + CELL_SIZE - 1) / CELL_SIZE;
+    const i32 last_column  = (bounds.right + 1) / CELL_SIZE;  // One past.
+    const i32 first_row    = (bounds.top  + CELL_SIZE - 1) / CELL_SIZE;
+    const i32 last_row     = (bounds.bottom + 1) / CELL_SIZE;
+    const i32 start_column = first_column - first_column % static_cast<i32>(SIMD_WIDTH);
+
+    // An edge function is greatest, and the depth is farthest, at the same corner of every cell: on the side they go up
+    // and down towards.
+    i32 edge_corner_x[3];
+    i32 edge_corner_y[3];
+    for (int edge = 0; edge < 3; ++edge)
+    {
+        edge_corner_x[edge] = setup.step_x[edge] > 0 ? CELL_SIZE - 1 : 0;
+        edge_corner_y[edge] = setup.step_y[edge] > 0 ? CELL_SIZE - 1 : 0;
+    }
+    const i32 depth_corner_x = setup.depth.step_x < 0 ? CELL_SIZE - 1 : 0;
+    const i32 depth_corner_y = setup.depth.step_y < 0 ? CELL_SIZE - 1 : 0;
+
+    const SimdFloat lanes      = ToFloat(LaneIndices());
+    const SimdFloat cell_pixels (static_cast<f32>(CELL_SIZE));
+
+    for (i32 row = first_row; row < last_row; ++row)
+    {
+        const f32 depth_row = setup.depth.Row(row * CELL_SIZE + depth_corner_y);
+
+        for (i32 column = start_column; column < last_column; column += SIMD_WIDTH)
+        {
+            const SimdInt cells = SimdInt(column) + LaneIndices();
+            SimdFloat covered = (SimdInt(first_column - 1) < cells) & (cells < SimdInt(last_column));
+
+            for (int edge = 0; edge < 3; ++edge)
+            {
+                const i64 at   = setup.Edge(edge, column * CELL_SIZE + edge_corner_x[edge], row * CELL_SIZE + edge_corner_y[edge]);
+                const i64 step = setup.step_x[edge] * CELL_SIZE;
+
+                // Well over what the conversions, the multiply and the add can be off by.
+                const f32 margin = (std::abs(static_cast<f32>(at)) + SIMD_WIDTH * std::abs(static_cast<f32>(step))) * (1.0f / (1 << 20)) + 1.0f;
+
+                const SimdFloat value = SimdFloat(static_cast<f32>(at)) + lanes * SimdFloat(static_cast<f32>(step));
+                covered = covered & (value < SimdFloat(-margin));
+            }
+
+            if (not Any(covered))
+                continue;
+
+            // As ScreenPlane::At at every cell's farthest pixel, which is what the rasterizers give there.
+            const SimdFloat offsets = ToFloat(SimdInt(column * CELL_SIZE + depth_corner_x - setup.depth.anchor_x)) + lanes * cell_pixels;
+            const SimdFloat depth   = SimdFloat(depth_row) + SimdFloat(setup.depth.step_x) * offsets;
+
+            f32* cell = &buffer.depths(row, column);
+            StoreU(cell, Max(LoadU(cell), Select(covered, depth, SimdFloat(0.0f))));
+        }
+    }
+}
+
+// Draws the mesh's occluders the camera sees whole, as it sees them, into 'buffer', after clearing it. Returns how many.
+u64 DrawOccluders(OcclusionBuffer& buffer, const Camera& camera, const Viewport& viewport, const Mesh& mesh)
+{
+    Resize(buffer, viewport);
+    Fill(buffer.depths, 0.0f);
+
+    const Frustum frustum = ViewFrustum(camera);
+    u64 drawn = 0;
+
+    for (const u32 triangle : mesh.occluders)
+    {
+        glm::vec3 camera_space[3];
+        u32       outcodes[3];
+        for (u32 i = 0; i < 3; ++i)
+        {
+            camera_space[i] = camera.cached_rotation_matrix * (Position(mesh, mesh.indices[3 * triangle + i]) - camera.position);
+            outcodes[i]     = Outcode(frustum, camera_space[i]);
+        }
+
+        // Only the ones drawn as they are, so the rasterizers draw exactly the same pixels of them.
+        const Visibility visibility = Cull(
+            camera.position, mesh.normals[triangle], Position(mesh, mesh.indices[3 * triangle]), outcodes[0], outcodes[1], outcodes[2]
+        );
+        if (visibility != Visibility::VISIBLE)
+            continue;
+
+        // As TransformVertices, bit for bit.
+        const RasterVertex p0 = Project(viewport, camera, camera_space[0]);
+        const RasterVertex p1 = Project(viewport, camera, camera_space[1]);
+        const RasterVertex p2 = Project(viewport, camera, camera_space[2]);
+
+        if (-EdgeFunction(p0, p1, p2.x, p2.y) < 2 * i64(OcclusionBuffer::MIN_OCCLUDER) * SUBPIXEL_STEPS * SUBPIXEL_STEPS)
+            continue;
+
+        DrawOccluder(buffer, viewport, p0, p1, p2);
+        drawn += 1;
+    }
+
+    return drawn;
+}
+
+// Whether the cluster is hidden behind the occluders in 'buffer', or off screen, so none of it would be drawn.
+bool Occluded(const OcclusionBuffer& buffer, const Camera& camera, const Viewport& viewport, const Cluster& cluster)
+{
+    constexpr i32 CELL_SIZE = OcclusionBuffer::CELL_SIZE;
+
+    i32 min_x = std::numeric_limits<i32>::max(), max_x = std::numeric_limits<i32>::min();
+    i32 min_y = std::numeric_limits<i32>::max(), max_y = std::numeric_limits<i32>::min();
+    f32 nearest = std::numeric_limits<f32>::max();
+
+    for (u32 corner = 0; corner < 8; ++corner)
+    {
+        const glm::vec3 position (
+            corner & 1 ? cluster.max.x : cluster.min.x,
+            corner & 2 ? cluster.max.y : cluster.min.y,
+            corner & 4 ? cluster.max.z : cluster.min.z
+        );
+        const glm::vec3 camera_space = camera.cached_rotation_matrix * (position - camera.position);
+
+        // Projecting means nothing behind the near plane.
+        if (-camera_space.z < camera.near)
+            return false;
+
+        const RasterVertex raster = Project(viewport, camera, camera_space);
+        min_x   = std::min(min_x, raster.x);
+        max_x   = std::max(max_x, raster.x);
+        min_y   = std::min(min_y, raster.y);
+        max_y   = std::max(max_y, raster.y);
+        nearest = std::min(nearest, raster.z);
+    }
+
+    // The pixels the box covers, and one more all round for how its corners and the vertices inside it round.
+    const i32 left   = std::max(PixelAtOrBefore(min_x) - 1, viewport.left);
+    const i32 top    = std::max(PixelAtOrBefore(min_y) - 1, viewport.top);
+    const i32 right  = std::min(PixelAtOrBefore(max_x) + 1, viewport.right  - 1);
+    const i32 bottom = std::min(PixelAtOrBefore(max_y) + 1, viewport.bottom - 1);
+    if (right < left or bottom < top)
+        return true;
+
+    const f32 depth = (1.0f / nearest) * (1.0f + OcclusionBuffer::DEPTH_MARGIN);
+
+    for (i32 row = top / CELL_SIZE; row <= bottom / CELL_SIZE; ++row)
+        for (i32 column = left / CELL_SIZE; column <= right / CELL_SIZE; ++column)
+            if (not (depth < buffer.depths(row, column)))
+                return false;
+
+    return true;
+}
+
+// Draws the occluders into 'buffer', then tests every cluster of the mesh against it on the pool, setting
+// 'visible[cluster]' to whether it's to be drawn.
+ClusterStats CullClusters(
+        const Camera& camera, const Viewport& viewport, const Mesh& mesh, ThreadPool& pool,
+        OcclusionBuffer& buffer, std::vector<u8>& visible
+)
+{
+    constexpr unsigned BATCH = 256;  // Clusters per task.
+
+    ClusterStats stats;
+    stats.clusters  = mesh.clusters.size();
+    stats.occluders = DrawOccluders(buffer, camera, viewport, mesh);
+
+    visible.resize(mesh.clusters.size());
+
+    const unsigned count = static_cast<unsigned>(mesh.clusters.size());
+    ParallelFor(pool, (count + BATCH - 1) / BATCH, [&](const unsigned batch, unsigned)
+    {
+        for (unsigned cluster = batch * BATCH; cluster < std::min(count, (batch + 1) * BATCH); ++cluster)
+            visible[cluster] = not Occluded(buffer, camera, viewport, mesh.clusters[cluster]);
+    });
+
+    for (const u8 cluster_visible : visible)
+        stats.culled += not cluster_visible;
+
+    return stats;
+}
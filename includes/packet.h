@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "raytracer.h"
+#include "simd.h"
+
+
+// Ray packets: SIMD_WIDTH rays from the same point, traced through the BVH together, one ray per lane.
+// https://graphics.stanford.edu/~boulos/papers/cr_SCI.pdf
+//
+// Primary rays of neighbouring pixels take nearly the same path through the BVH, so the packet pays for one traversal
+// and tests every node and triangle against all its rays at once. A lane only stops affecting the traversal once
+// the packet's closest hits have culled a node for all lanes.
+//
+// The packets are PACKET_WIDTH x PACKET_HEIGHT pixels: 4x2 with AVX2 and 2x2 otherwise.
+
+constexpr unsigned PACKET_SIZE   = SIMD_WIDTH;
+constexpr int      PACKET_WIDTH  = SIMD_WIDTH == 8 ? 4 : 2;
+constexpr int      PACKET_HEIGHT = 2;
+
+
+// The rays of a packet have diverged when their directions point to different sides along some axis. They then
+// disagree on which child is near, and share few nodes, so they're better off traced one by one.
+inline bool IsCoherent(const glm::vec3 directions[PACKET_SIZE])
+{
+    for (unsigned axis = 0; axis < 3; ++axis)
+        for (unsigned lane = 1; lane < PACKET_SIZE; ++lane)
+            if ((directions[lane][axis] < 0.0f) != (directions[0][axis] < 0.0f))
+                return false;
+
+    return true;
+}
+
+
+// Same results as calling the BVH's ClosestIntersection for each of the rays 'start + t * directions[lane]'.
+[[gnu::hot]]
+void ClosestIntersection(
+        const glm::vec3& start, const glm::vec3 directions[PACKET_SIZE], const BVH& bvh, Intersection results[PACKET_SIZE],
+        TraversalStatistics* statistics = nullptr
+)
+{
+    if (not IsCoherent(directions) or bvh.nodes.empty())
+    {
+        for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+            results[lane] = ClosestIntersection(start, directions[lane], bvh, statistics);
+        return;
+    }
+
+    alignas(32) float lanes[3][PACKET_SIZE];
+    for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+        for (unsigned axis = 0; axis < 3; ++axis)
+            lanes[axis][lane] = directions[lane][axis];
+
+    const SimdFloat direction_x = LoadU(lanes[0]);
+    const SimdFloat direction_y = LoadU(lanes[1]);
+    const SimdFloat direction_z = LoadU(lanes[2]);
+
+    const SimdFloat one (1.0f);
+    const SimdFloat inverse_x = one / direction_x;
+    const SimdFloat inverse_y = one / direction_y;
+    const SimdFloat inverse_z = one / direction_z;
+
+    const SimdFloat zero (0.0f);
+
+    SimdFloat closest_t     (std::numeric_limits<float>::max());
+    SimdInt   closest_index (-1);                                  // Into 'bvh.triangles'.
+    SimdInt   closest_model (std::numeric_limits<int32_t>::max()); // Into the model, to break ties like the scalar version.
+
+    uint64_t node_visits    = 0;
+    uint64_t triangle_tests = 0;
+
+    uint32_t stack[BVH::MAX_DEPTH + 1];
+    unsigned stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        const uint32_t node_index = stack[--stack_size];
+        const BVHNode& node = bvh.nodes[node_index];
+
+        node_visits += 1;
+
+        // Slab test for all lanes, as in IntersectBounds.
+        const SimdFloat t0_x = (SimdFloat(node.bounds.min.x) - SimdFloat(start.x)) * inverse_x;
+        const SimdFloat t0_y = (SimdFloat(node.bounds.min.y) - SimdFloat(start.y)) * inverse_y;
+        const SimdFloat t0_z = (SimdFloat(node.bounds.min.z) - SimdFloat(start.z)) * inverse_z;
+        const SimdFloat t1_x = (SimdFloat(node.bounds.max.x) - SimdFloat(start.x)) * inverse_x;
+        const SimdFloat t1_y = (SimdFloat(node.bounds.max.y) - SimdFloat(start.y)) * inverse_y;
+        const SimdFloat t1_z = (SimdFloat(node.bounds.max.z) - SimdFloat(start.z)) * inverse_z;
+
+        const SimdFloat entry = Max(Max(Min(t0_x, t1_x), Min(t0_y, t1_y)), Max(Min(t0_z, t1_z), zero));
+        const SimdFloat exit  = Min(Min(Max(t0_x, t1_x), Max(t0_y, t1_y)), Min(Max(t0_z, t1_z), closest_t));
+
+        if (not Any(entry <= exit))
+            continue;
+
+        if (node.count > 0)
+        {
+            triangle_tests += node.count * PACKET_SIZE;
+
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                // Möller–Trumbore, as in Intersect, in the same order of operations so each lane gets the same result
+                // as the scalar version. The start is shared, so 'b' and 'q' are the same for all lanes.
+                const TriangleRecord triangle = LoadTriangle(bvh.triangles, i);
+
+                const SimdFloat e1_x (triangle.e1.x), e1_y (triangle.e1.y), e1_z (triangle.e1.z);
+                const SimdFloat e2_x (triangle.e2.x), e2_y (triangle.e2.y), e2_z (triangle.e2.z);
+
+                const SimdFloat p_x = direction_y * e2_z - e2_y * direction_z;
+                const SimdFloat p_y = direction_z * e2_x - e2_z * direction_x;
+                const SimdFloat p_z = direction_x * e2_y - e2_x * direction_y;
+
+                const SimdFloat determinant = e1_x * p_x + e1_y * p_y + e1_z * p_z;
+                const SimdFloat inverse_determinant = one / determinant;
+
+                const glm::vec3 b = start - triangle.v0;
+                const glm::vec3 q = glm::cross(b, triangle.e1);
+
+                const SimdFloat u = (SimdFloat(b.x) * p_x + SimdFloat(b.y) * p_y + SimdFloat(b.z) * p_z) * inverse_determinant;
+                const SimdFloat v = (direction_x * SimdFloat(q.x) + direction_y * SimdFloat(q.y) + direction_z * SimdFloat(q.z)) * inverse_determinant;
+                const SimdFloat t = SimdFloat(glm::dot(triangle.e2, q)) * inverse_determinant;
+
+                const SimdInt model_index (bvh.indices[i]);
+
+                const SimdFloat closer = (t < closest_t) | ((t == closest_t) & (model_index < closest_model));
+                const SimdFloat hit    =
+                        (determinant != zero) & (u >= zero) & (u <= one) & (v >= zero) & (u + v <= one) & (t >= zero) & closer;
+
+                if (not Any(hit))
+                    continue;
+
+                closest_t     = Select(hit, t, closest_t);
+                closest_index = Select(hit, SimdInt(static_cast<int32_t>(i)), closest_index);
+                closest_model = Select(hit, model_index, closest_model);
+            }
+        }
+        else
+        {
+            // All lanes point the same way, so the first one decides for the packet.
+            uint32_t near = node_index + 1;
+            uint32_t far  = node.offset;
+            if (directions[0][node.axis] < 0.0f)
+                std::swap(near, far);
+
+            stack[stack_size++] = far;
+            stack[stack_size++] = near;
+        }
+    }
+
+    if (statistics)
+    {
+        statistics->rays           += PACKET_SIZE;
+        statistics->node_visits    += node_visits * PACKET_SIZE;
+        statistics->triangle_tests += triangle_tests;
+    }
+
+    alignas(32) float   t_lanes    [PACKET_SIZE];
+    alignas(32) int32_t index_lanes[PACKET_SIZE];
+    StoreU(t_lanes,     closest_t);
+    StoreU(index_lanes, closest_index);
+
+    for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+        if (index_lanes[lane] == -1)
+            results[lane] = {};
+        else
+            results[lane] = { start + t_lanes[lane] * directions[lane], t_lanes[lane], bvh.indices[index_lanes[lane]] };
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "debug.h"
+#include "TestModel.h"
+
+
+// A scripted camera and light path, for rendering without a window. A path file is plain text with one command per
+// line, and '#' starting a comment:
+//
+//     scene cornell                        The Cornell box (LoadTestModel). The default.
+//     scene random <count> [seed]          'count' random triangles (LoadRandomModel).
+//     key <frame> <x y z> <yaw> <x y z>    Camera position, camera yaw (radians) and light position at 'frame'.
+//
+// Frames between two keys are interpolated linearly; frames before the first or after the last key hold still.
+
+
+struct PathKey
+{
+    unsigned  frame           = 0;
+    glm::vec3 camera_position = glm::vec3(0);
+    float     camera_yaw      = 0;
+    glm::vec3 light_position  = glm::vec3(0);
+};
+
+struct Path
+{
+    std::string scene        = "cornell";
+    unsigned    scene_count  = 0;  // Triangles in a random scene.
+    unsigned    scene_seed   = 0;
+
+    std::vector<PathKey> keys;  // Sorted by frame.
+};
+
+
+// 'name' is only used in error messages.
+Path ParsePath(std::istream& input, const std::string& name = "path")
+{
+    Path path;
+
+    std::string line;
+    unsigned line_number = 0;
+    while (std::getline(input, line))
+    {
+        line_number += 1;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream stream(line);
+        std::string command;
+        if (not (stream >> command))
+            continue;
+
+        if (command == "scene")
+        {
+            stream >> path.scene;
+            if (path.scene == "random")
+            {
+                stream >> path.scene_count;
+                if (not (stream >> path.scene_seed))
+                    path.scene_seed = 0;
+                Assert(path.scene_count > 0, "%s:%u: A random scene needs a triangle count.", name.c_str(), line_number);
+            }
+            else
+            {
+                Assert(path.scene == "cornell", "%s:%u: Unknown scene '%s'.", name.c_str(), line_number, path.scene.c_str());
+            }
+        }
+        else if (command == "key")
+        {
+            PathKey key;
+            stream >> key.frame
+                   >> key.camera_position.x >> key.camera_position.y >> key.camera_position.z
+                   >> key.camera_yaw
+                   >> key.light_position.x  >> key.light_position.y  >> key.light_position.z;
+
+            Assert(not stream.fail(), "%s:%u: Expected 'key <frame> <x y z> <yaw> <x y z>'.", name.c_str(), line_number);
+            path.keys.push_back(key);
+        }
+        else
+        {
+            Assert(false, "%s:%u: Unknown command '%s'.", name.c_str(), line_number, command.c_str());
+        }
+    }
+
+    Assert(not path.keys.empty(), "%s: No keys.", name.c_str());
+
+    std::stable_sort(path.keys.begin(), path.keys.end(), [](const PathKey& a, const PathKey& b) { return a.frame < b.frame; });
+    return path;
+}
+
+Path LoadPath(const std::string& filename)
+{
+    std::ifstream file(filename);
+    Assert(file.is_open(), "Couldn't open path file '%s'.", filename.c_str());
+
+    return ParsePath(file, filename);
+}
+
+std::vector<Triangle> LoadScene(const Path& path)
+{
+    if (path.scene == "random")
+        return LoadRandomModel(path.scene_count, path.scene_seed);
+
+    return LoadTestModel();
+}
+
+// Number of frames from the first frame up to and including the last key.
+unsigned FrameCount(const Path& path)
+{
+    return path.keys.back().frame + 1;
+}
+
+// Camera and light at 'frame', interpolated between the keys around it.
+PathKey Sample(const Path& path, const unsigned frame)
+{
+    if (frame <= path.keys.front().frame)
+        return path.keys.front();
+    if (frame >= path.keys.back().frame)
+        return path.keys.back();
+
+    unsigned next = 1;
+    while (path.keys[next].frame < frame)
+        next += 1;
+
+    const PathKey& a = path.keys[next - 1];
+    const PathKey& b = path.keys[next];
+
+    if (b.frame == frame)
+        return b;
+
+    const float t = (frame - a.frame) / static_cast<float>(b.frame - a.frame);
+
+    PathKey key;
+    key.frame           = frame;
+    key.camera_position = glm::mix(a.camera_position, b.camera_position, t);
+    key.camera_yaw      = glm::mix(a.camera_yaw,      b.camera_yaw,      t);
+    key.light_position  = glm::mix(a.light_position,  b.light_position,  t);
+    return key;
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "lab2.h"
+
+
+// Lab2's progressive path tracer. Adds the light bouncing between the walls, which Draw fakes with the constant
+// Light::ambient. Every frame adds a few more samples per pixel to an accumulation buffer, for as long as the camera
+// and light stay put, so the image gets less noisy the longer it's looked at.
+//
+// The surfaces are Lambertian with the triangle's color as the albedo. DirectLight leaves out the 1/π of the
+// Lambertian BRDF, which is the same as a light π times as bright, so the paths just use it as it is for the direct
+// light at every bounce, and the directly lit parts look the same as in Draw.
+
+
+// ---- RANDOM NUMBERS ----
+// Counter-based: a random number is a hash of where it's used (pixel, sample, and how many came before it in that
+// sample), not the next state of a generator shared by a thread. So every pixel gets the same numbers, and the same
+// image, no matter how many threads there are or which one gets its tile.
+
+// Bijective 32-bit integer hash with good avalanche ("lowbias32", by Chris Wellons).
+inline uint32_t Hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+struct RandomStream
+{
+    uint32_t key;
+    uint32_t counter = 0;
+};
+
+// The stream of sample 'sample' of pixel 'pixel'.
+inline RandomStream PixelStream(const uint32_t pixel, const uint32_t sample)
+{
+    return { Hash(pixel ^ Hash(sample + 0x9E3779B9u)) };
+}
+
+// Uniform in [0, 1).
+inline float Uniform(RandomStream& stream)
+{
+    const uint32_t bits = Hash(stream.key + Hash(stream.counter++));
+    return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+
+// ---- SAMPLING ----
+// A direction around 'normal', with probability proportional to the cosine to it. For a Lambertian surface that
+// cancels the cosine and the BRDF's 1/π, leaving just the albedo as the path's weight.
+glm::vec3 CosineWeightedDirection(const glm::vec3& normal, const float u, const float v)
+{
+    using namespace glm;
+
+    // Any two axes perpendicular to the normal (Duff et al. 2017).
+    const float sign = std::copysign(1.0f, normal.z);
+    const float a = -1.0f / (sign + normal.z);
+    const float b = normal.x * normal.y * a;
+    const vec3 tangent   (1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+    const vec3 bitangent (b, sign + normal.y * normal.y * a, -normal.y);
+
+    const float radius = std::sqrt(u);
+    const float angle  = 2.0f * PI * v;
+
+    return tangent   * (radius * std::cos(angle)) +
+           bitangent * (radius * std::sin(angle)) +
+           normal    * std::sqrt(max(0.0f, 1.0f - u));
+}
+
+
+// ---- ACCUMULATION ----
+// The running sum of every sample so far, and how close their mean is to converging. Starts over when the camera or
+// light changes.
+struct Accumulation
+{
+    static constexpr float CONVERGED_ERROR = 0.01f;  // Relative standard error of the mean image that counts as converged.
+
+    Array2D<glm::vec3> sum;  // Radiance, not clamped.
+
+    // The mean of every pixel's luminance and the sum of its squared deviations from it, for the error. Kept with
+    // Welford's method in double, as a float sum of squares cancels out to nothing in pixels that hardly vary.
+    Array2D<double> luminance_means;
+    Array2D<double> luminance_deviations;
+
+    std::vector<double> tile_variances;  // Per tile, summed in order so the error doesn't depend on the threads either.
+    std::vector<double> tile_means;
+
+    unsigned samples = 0;  // Per pixel.
+
+    unsigned  camera_version = 0;
+    glm::vec3 light_position = glm::vec3(0);
+    glm::vec3 light_color    = glm::vec3(0);
+    bool      valid          = false;  // Set to false to start over.
+
+    double seconds           = 0;     // Spent sampling since starting over.
+    double converged_seconds = -1;    // 'seconds' when the error first got below CONVERGED_ERROR, -1 until then.
+    float  error             = std::numeric_limits<float>::infinity();
+
+    // ---- CONSTRUCTORS ----
+    Accumulation(const int width, const int height) :
+            sum(height, width), luminance_means(height, width), luminance_deviations(height, width),
+            tile_variances(static_cast<size_t>(((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE))),
+            tile_means(tile_variances.size()) {}
+};
+
+inline bool IsCurrent(const Accumulation& accumulation, const Camera& camera, const Light& light)
+{
+    return accumulation.valid and accumulation.camera_version == camera.version and
+           accumulation.light_position == light.position and accumulation.light_color == light.color;
+}
+
+// Welford's update of the mean of 'count - 1' values, and the sum of their squared deviations from it, with 'value'.
+inline void AddToMean(double& mean, double& squared_deviations, const unsigned count, const double value)
+{
+    const double deviation = value - mean;
+    mean               += deviation / count;
+    squared_deviations += deviation * (value - mean);
+}
+
+void Reset(Accumulation& accumulation, const Camera& camera, const Light& light)
+{
+    Fill(accumulation.sum, glm::vec3(0));
+    Fill(accumulation.luminance_means,      0.0);
+    Fill(accumulation.luminance_deviations, 0.0);
+
+    accumulation.samples           = 0;
+    accumulation.camera_version    = camera.version;
+    accumulation.light_position    = light.position;
+    accumulation.light_color       = light.color;
+    accumulation.valid             = true;
+    accumulation.seconds           = 0;
+    accumulation.converged_seconds = -1;
+    accumulation.error             = std::numeric_limits<float>::infinity();
+}
+
+inline float Luminance(const glm::vec3& color)
+{
+    return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+}
+
+
+// ---- TRACING ----
+constexpr unsigned MAX_BOUNCES            = 8;
+constexpr unsigned RUSSIAN_ROULETTE_AFTER = 3;  // Bounces that always continue, before paths start being cut short.
+
+// The radiance along one path through the pixel at 'row', 'column', jittered inside it for antialiasing. Paths that
+// leave the scene straight from the camera see 'background'; later ones see nothing.
+[[gnu::hot]]
+glm::vec3 TracePath(
+        const Camera& camera, const Light& light, const int width, const int height, const float focal,
+        const std::vector<ShadingRecord>& shading, const BVH& bvh, const glm::vec3& background,
+        const int row, const int column, RandomStream& random
+)
+{
+    using namespace glm;
+
+    const float x = column - (width/2.0f)  + Uniform(random) - 0.5f;
+    const float y = row    - (height/2.0f) + Uniform(random) - 0.5f;
+
+    vec3 start      = camera.position;
+    vec3 direction  = camera.cached_rotation_matrix * vec3(x, y, -focal);
+    vec3 throughput = vec3(1);
+    vec3 radiance   = vec3(0);
+
+    for (unsigned bounce = 0; bounce < MAX_BOUNCES; ++bounce)
+    {
+        const Intersection hit = ClosestIntersection(start, direction, bvh);
+        if (not hit)
+        {
+            if (bounce == 0)
+                radiance = background;
+            break;
+        }
+
+        const ShadingRecord& surface = shading[hit.triangle_index];
+
+        // Lit from whichever side the ray came from.
+        const vec3 normal = dot(surface.normal, direction) < 0.0f ? surface.normal : -surface.normal;
+
+        // Direct light. The light is at t = 1 along 'to_light'.
+        const vec3 to_light = light.position - hit.position;
+        if (dot(to_light, normal) > 0.0f and not Occluded(hit.position + normal * 0.001f, to_light, 1.0f, bvh))
+            radiance += throughput * DirectLight(hit.position, normal, surface.color, light);
+
+        // Indirect light.
+        throughput *= surface.color;
+        if (bounce >= RUSSIAN_ROULETTE_AFTER)
+        {
+            const float survival = min(max(throughput.r, max(throughput.g, throughput.b)), 0.95f);
+            if (Uniform(random) >= survival)
+                break;
+            throughput /= survival;
+        }
+
+        const float u = Uniform(random);
+        const float v = Uniform(random);
+        start     = hit.position + normal * 0.001f;
+        direction = CosineWeightedDirection(normal, u, v);
+    }
+
+    return radiance;
+}
+
+// Adds 'samples' paths per pixel to the accumulation, after starting over if the camera or light changed, and updates
+// its error. Allocates nothing.
+void Accumulate(
+        const Camera& camera, const Light& light, const float focal,
+        const std::vector<ShadingRecord>& shading, const BVH& bvh,
+        ThreadPool& pool, Accumulation& accumulation, const unsigned samples, const glm::vec3& background = glm::vec3(GREY)
+)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int width  = static_cast<int>(accumulation.sum.columns);
+    const int height = static_cast<int>(accumulation.sum.rows);
+    const int tile_columns = (width + TILE_SIZE - 1) / TILE_SIZE;
+
+    if (not IsCurrent(accumulation, camera, light))
+        Reset(accumulation, camera, light);
+
+    const Clock::time_point start = Clock::now();
+
+    const unsigned first_sample = accumulation.samples;
+    const unsigned total        = first_sample + samples;
+
+    ForEachTile(pool, width, height, [&](const int top, const int left, const int bottom, const int right)
+    {
+        double tile_variance = 0;
+        double tile_mean     = 0;
+
+        for (int row = top; row < bottom; ++row)
+        {
+            for (int column = left; column < right; ++column)
+            {
+                const uint32_t pixel = static_cast<uint32_t>(row * width + column);
+
+                glm::vec3 sum        = accumulation.sum(row, column);
+                double    mean       = accumulation.luminance_means(row, column);
+                double    deviations = accumulation.luminance_deviations(row, column);
+
+                for (unsigned sample = first_sample; sample < total; ++sample)
+                {
+                    RandomStream random = PixelStream(pixel, sample);
+                    const glm::vec3 radiance = TracePath(camera, light, width, height, focal, shading, bvh, background, row, column, random);
+
+                    sum += radiance;
+                    AddToMean(mean, deviations, sample + 1, Luminance(radiance));
+                }
+
+                accumulation.sum(row, column)                  = sum;
+                accumulation.luminance_means(row, column)      = mean;
+                accumulation.luminance_deviations(row, column) = deviations;
+
+                // Variance of this pixel's mean: the sample variance over the sample count.
+                const double variance = total > 1 ? deviations / (total - 1) : 0.0;
+                tile_variance += variance / total;
+                tile_mean     += mean;
+            }
+        }
+
+        const int tile = (top / TILE_SIZE) * tile_columns + left / TILE_SIZE;
+        accumulation.tile_variances[tile] = tile_variance;
+        accumulation.tile_means    [tile] = tile_mean;
+    });
+
+    accumulation.samples = total;
+    accumulation.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+    // The root mean square standard error of the pixels, relative to the mean brightness.
+    double variance = 0;
+    double mean     = 0;
+    for (size_t tile = 0; tile < accumulation.tile_variances.size(); ++tile)
+    {
+        variance += accumulation.tile_variances[tile];
+        mean     += accumulation.tile_means[tile];
+    }
+    // One sample says nothing about the variance.
+    if (total < 2)
+        accumulation.error = std::numeric_limits<float>::infinity();
+    else
+        accumulation.error = mean > 0 ? static_cast<float>(std::sqrt(variance / (width * height)) / (mean / (width * height))) : 0.0f;
+
+    if (accumulation.converged_seconds < 0 and accumulation.error < Accumulation::CONVERGED_ERROR)
+        accumulation.converged_seconds = accumulation.seconds;
+}
+
+// Paths per second over all pixels, since starting over.
+inline double SamplesPerSecond(const Accumulation& accumulation)
+{
+    const double paths = static_cast<double>(accumulation.samples) * accumulation.sum.rows * accumulation.sum.columns;
+    return accumulation.seconds > 0 ? paths / accumulation.seconds : 0;
+}
+
+// The mean of the samples so far, clamped to the displayable range.
+void Resolve(const Accumulation& accumulation, ThreadPool& pool, const Array2DView<Uint32>& target)
+{
+    Assert(
+        accumulation.sum.columns == target.columns and accumulation.sum.rows == target.rows,
+        "The accumulation (%ux%u) and the target (%ux%u) are different sizes.",
+        accumulation.sum.columns, accumulation.sum.rows, target.columns, target.rows
+    );
+
+    const float scale = accumulation.samples > 0 ? 1.0f / accumulation.samples : 0.0f;
+
+    ForEachTile(pool, static_cast<int>(target.columns), static_cast<int>(target.rows),
+        [&](const int top, const int left, const int bottom, const int right)
+    {
+        for (int row = top; row < bottom; ++row)
+            for (int column = left; column < right; ++column)
+                target(row, column) = ColorCode(glm::clamp(accumulation.sum(row, column) * scale, glm::vec3(0), glm::vec3(1)));
+    });
+}
+
+// Path traced counterpart of Draw: adds 'samples' paths per pixel, then shows the mean so far in 'target'.
+void DrawPathTraced(
+        const Camera& camera, const Light& light, const float focal,
+        const std::vector<ShadingRecord>& shading, const BVH& bvh,
+        ThreadPool& pool, Accumulation& accumulation, const Array2DView<Uint32>& target, const unsigned samples = 1
+)
+{
+    Accumulate(camera, light, focal, shading, bvh, pool, accumulation, samples);
+    Resolve(accumulation, pool, target);
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "camera.h"
+#include "light.h"
+#include "binning.h"
+#include "threadpool.h"
+
+
+// Lab3's frames in two stages that overlap: while one frame's tiles are rasterized and presented on the caller's pool,
+// the next frame's geometry (Bin: occlusion culling, the vertex stage, clipping and binning) runs on a pool of its own,
+// driven by a thread of its own. Every frame has its own camera, light and TileBins, in one of two slots, so the stages
+// never share anything but the mesh, which neither writes.
+//
+//     BeginFrame(pipeline, camera, light);           // Frame 0's geometry.
+//     while (running)
+//     {
+//         HandleEvents(camera, light);
+//         BeginFrame(pipeline, camera, light);       // Frame N + 1's geometry, in the background,
+//         DrawFrame(pipeline, draw_bins);            // while frame N is drawn.
+//         Present(window);
+//     }
+//
+// A frame is drawn when the next one has begun, so what's on screen is a frame behind the input, and never more: a
+// third frame can't begin before the first is drawn. Frames are drawn in the order they began, each exactly as
+// DrawBinned and the like would draw it on its own.
+//
+// The two pools can have as many threads as there are cores each. Their threads sleep while they have nothing to do, so
+// whichever stage is still running when the other is done gets the cores to itself.
+
+
+// A frame in the pipeline.
+struct PipelinedFrame
+{
+    Camera   camera;
+    Light    light;
+    TileBins bins;
+};
+
+struct FramePipeline
+{
+    static constexpr unsigned FRAMES = 2;  // In flight at most: one being drawn, and the next in its geometry stage.
+
+    const Mesh& mesh;
+    Viewport    viewport;
+
+    // Frame 'i' is in 'frames[i % FRAMES]'. The TileBins options (occlusion culling, the depth pre-pass...) are set on
+    // every one of them.
+    PipelinedFrame frames[FRAMES];
+
+    // How many frames have begun, been binned, and been drawn. Only the caller writes 'begun' and 'drawn', and only
+    // the geometry thread 'binned'.
+    u64 begun  = 0;
+    u64 binned = 0;
+    u64 drawn  = 0;
+
+    ThreadPool  geometry_pool;  // With 'geometry_thread' as its thread 0.
+    std::thread geometry_thread;
+
+    std::mutex              mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+
+    // ---- CONSTRUCTORS ----
+    FramePipeline(const Mesh& mesh, const Viewport& viewport, unsigned geometry_threads = std::thread::hardware_concurrency());
+
+    // ---- COPY/MOVE CONSTRUCTOR ----
+    FramePipeline(const FramePipeline& other) = delete;
+    FramePipeline& operator= (const FramePipeline& other) = delete;
+
+    // ---- DESTRUCTOR ----
+    ~FramePipeline();
+};
+
+
+// Bins the frames as they begin, in order, until the pipeline stops.
+void GeometryLoop(FramePipeline& pipeline)
+{
+    while (true)
+    {
+        u64 frame;
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            pipeline.condition.wait(lock, [&]() { return pipeline.stopping or pipeline.binned < pipeline.begun; });
+
+            if (pipeline.stopping)
+                return;
+
+            frame = pipeline.binned;
+        }
+
+        PipelinedFrame& slot = pipeline.frames[frame % FramePipeline::FRAMES];
+        Bin(slot.camera, pipeline.viewport, pipeline.mesh, pipeline.geometry_pool, slot.bins);
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline.mutex);
+            pipeline.binned = frame + 1;
+        }
+        pipeline.condition.notify_all();
+    }
+}
+
+
+FramePipeline::FramePipeline(const Mesh& mesh, const Viewport& viewport, const unsigned geometry_threads) :
+        mesh(mesh),
+        viewport(viewport),
+        geometry_pool(geometry_threads)
+{
+    geometry_thread = std::thread(GeometryLoop, std::ref(*this));
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    geometry_thread.join();
+}
+
+
+// Starts the geometry stage of a frame seen with 'camera' and lit by 'light', in the background. At most one frame can
+// be waiting to be drawn.
+void BeginFrame(FramePipeline& pipeline, const Camera& camera, const Light& light)
+{
+    Assert(pipeline.begun - pipeline.drawn < FramePipeline::FRAMES,
+        "Frame %llu began before frame %llu was drawn.",
+        static_cast<unsigned long long>(pipeline.begun), static_cast<unsigned long long>(pipeline.drawn));
+
+    // No one else touches the slot until the frame has begun.
+    PipelinedFrame& slot = pipeline.frames[pipeline.begun % FramePipeline::FRAMES];
+    slot.camera = camera;
+    slot.light  = light;
+
+    {
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        pipeline.begun += 1;
+    }
+    pipeline.condition.notify_all();
+}
+
+// Waits for the geometry stage of the oldest frame that hasn't been drawn, then draws it on the caller's pool with
+// 'draw_bins(camera, light, bins)', e.g. with DrawBins. Returns the frame, which stays as it is until another one
+// begins.
+template <typename DrawBins>
+const PipelinedFrame& DrawFrame(FramePipeline& pipeline, const DrawBins& draw_bins)
+{
+    Assert(pipeline.drawn < pipeline.begun, "No frame has begun to be drawn.");
+
+    {
+        std::unique_lock<std::mutex> lock(pipeline.mutex);
+        pipeline.condition.wait(lock, [&]() { return pipeline.binned > pipeline.drawn; });
+    }
+
+    PipelinedFrame& slot = pipeline.frames[pipeline.drawn % FramePipeline::FRAMES];
+    draw_bins(slot.camera, slot.light, slot.bins);
+
+    pipeline.drawn += 1;
+    return slot;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "TestModel.h"
+
+
+struct Intersection
+{
+    glm::vec3 position       = glm::vec3(0);
+    float     distance       = std::numeric_limits<float>::max();
+    int       triangle_index = -1;
+
+    explicit operator bool() const noexcept { return triangle_index != -1; }
+};
+
+
+// The triangle data needed by the Möller–Trumbore intersection test. Computing the edges once when the scene is
+// loaded, instead of building and inverting a matrix for every ray-triangle pair, leaves two cross products, four dot
+// products and a single division per test.
+// https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/moller-trumbore-ray-triangle-intersection
+struct TriangleRecord
+{
+    glm::vec3 v0;
+    glm::vec3 e1;  // v1 - v0
+    glm::vec3 e2;  // v2 - v0
+
+    TriangleRecord() = default;
+    explicit TriangleRecord(const Triangle& triangle) :
+            v0(triangle.v0), e1(triangle.v1 - triangle.v0), e2(triangle.v2 - triangle.v0) {}
+};
+
+
+std::vector<TriangleRecord> PrecomputeTriangles(const std::vector<Triangle>& triangles)
+{
+    std::vector<TriangleRecord> records;
+    records.reserve(triangles.size());
+
+    for (const Triangle& triangle : triangles)
+        records.emplace_back(triangle);
+
+    return records;
+}
+
+
+// Reference implementation. Solves the system 'start + t * direction = v0 + u * e1 + v * e2' by inverting the matrix
+// for every triangle. Kept to validate and benchmark the precomputed version against.
+Intersection ClosestIntersection(const glm::vec3& start, const glm::vec3& direction, const std::vector<Triangle>& triangles)
+{
+    Intersection closest_intersection;
+
+    for (int i = 0; i < static_cast<int>(triangles.size()); ++i)
+    {
+        const Triangle triangle = triangles[i];
+
+        const glm::vec3 v0 = triangle.v0;
+        const glm::vec3 v1 = triangle.v1;
+        const glm::vec3 v2 = triangle.v2;
+
+        const glm::vec3 e1 = v1 - v0;
+        const glm::vec3 e2 = v2 - v0;
+
+        const glm::vec3 b = start - v0;
+        const glm::mat3 A ( -direction, e1, e2 );
+
+        const glm::vec3 x = glm::inverse( A ) * b;
+
+        const float t = x[0];
+        const float u = x[1];
+        const float v = x[2];
+
+        // CLARIFY! u and v should be able to be 0, right?
+        if (0 <= u and 0 <= v and (u + v) <= 1 and 0 <= t and t < closest_intersection.distance)
+            closest_intersection = {start + t * direction, t, i};
+    }
+
+    return closest_intersection;
+}
+
+
+// Solves the same system as above with Cramer's rule, using the precomputed edges. Returns 't', measured (as before)
+// in lengths of 'direction', or a negative value if the ray misses the triangle.
+[[gnu::hot]] inline
+float Intersect(const TriangleRecord& triangle, const glm::vec3& start, const glm::vec3& direction)
+{
+    using namespace glm;
+
+    const vec3  p           = cross(direction, triangle.e2);
+    const float determinant = dot(triangle.e1, p);
+
+    // Ray is parallel to the triangle.
+    if (determinant == 0.0f)
+        return -1.0f;
+
+    const float inverse_determinant = 1.0f / determinant;
+
+    const vec3  b = start - triangle.v0;
+    const float u = dot(b, p) * inverse_determinant;
+    if (u < 0.0f or u > 1.0f)
+        return -1.0f;
+
+    const vec3  q = cross(b, triangle.e1);
+    const float v = dot(direction, q) * inverse_determinant;
+    if (v < 0.0f or u + v > 1.0f)
+        return -1.0f;
+
+    return dot(triangle.e2, q) * inverse_determinant;
+}
+
+[[gnu::hot]]
+Intersection ClosestIntersection(const glm::vec3& start, const glm::vec3& direction, const std::vector<TriangleRecord>& triangles)
+{
+    float closest_t     = std::numeric_limits<float>::max();
+    int   closest_index = -1;
+
+    for (int i = 0; i < static_cast<int>(triangles.size()); ++i)
+    {
+        const float t = Intersect(triangles[i], start, direction);
+        if (0.0f <= t and t < closest_t)
+        {
+            closest_t     = t;
+            closest_index = i;
+        }
+    }
+
+    if (closest_index == -1)
+        return {};
+
+    return { start + closest_t * direction, closest_t, closest_index };
+}
+
+
+// Any-hit query. Answers whether anything lies between 'start' and 'start + t_max * direction', stopping at the first
+// triangle found instead of looking for the closest one. Enough for shadow rays.
+[[gnu::hot]]
+bool Occluded(const glm::vec3& start, const glm::vec3& direction, const float t_max, const std::vector<TriangleRecord>& triangles)
+{
+    for (const TriangleRecord& triangle : triangles)
+    {
+        const float t = Intersect(triangle, start, direction);
+        if (0.0f <= t and t < t_max)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "light.h"
+#include "lab3.h"
+#include "threadpool.h"
+
+
+// Shadows for Lab3 from a shadow map: the depth of the closest surface the point light sees in every direction, drawn
+// with the rasterizer into the six faces of a cube around the light, each a 90 degree view down one axis. A point is in
+// shadow where something is closer to the light than it is, along the same direction.
+//
+// The faces are drawn with DepthOnlyFragment, as the first pass of a depth pre-pass, from cameras at the light, so they
+// cull, clip and rasterize exactly as Lab3's own view does. They only depend on where the light is, since the mesh
+// doesn't move, so they're drawn again only when it moves.
+//
+// Looking up a point takes the 3 x 3 texels around it in its face and the fraction of them that see it, percentage
+// closer filtering (PCF), which softens the texel steps along the edges of the shadows. Every texel is compared with
+// the depth of the point's own plane at the texel's centre rather than the point's, so a surface at a slant doesn't
+// shadow itself at its neighbouring texels. The only bias needed is for the rasterizer snapping vertices to fixed
+// point: DEPTH_BIAS, and SLOPE_BIAS for surfaces the light grazes, whose depth moves far across a fraction of a texel.
+// Such a surface can still take a texel or two of whatever it meets for its shadow, but it gets next to none of the
+// light anyway.
+
+
+struct ShadowMap
+{
+    static constexpr i32 FACES      = 6;           // +x, -x, +y, -y, +z, -z.
+    static constexpr i32 PCF_RADIUS = 1;           // Texels either side of the one a point is in.
+    static constexpr f32 NEAR       = 0.01f;       // Of the cameras at the light.
+    static constexpr f32 DEPTH_BIAS = 1.0f / 512;  // Relative.
+    static constexpr f32 SLOPE_BIAS = 0.25f;       // In texels, of how fast the depth changes across the surface.
+
+    // 1/z of the closest surface at every texel of every face, as the z-buffer of Draw, where z is the distance from
+    // the light along the face's axis.
+    Array2D<f32> faces[FACES] {
+        Array2D<f32>(0, 0), Array2D<f32>(0, 0), Array2D<f32>(0, 0),
+        Array2D<f32>(0, 0), Array2D<f32>(0, 0), Array2D<f32>(0, 0)
+    };
+    VertexBuffer vertices[FACES];
+
+    i32       size = 0;                   // Texels on a side of a face.
+    glm::vec3 light_position;             // Where the light was when the faces were drawn.
+    bool      valid = false;              // Set to false to force drawing them again.
+};
+
+// Faces of 'size' x 'size' texels. Only allocates when the size changes.
+void Resize(ShadowMap& map, const i32 size)
+{
+    if (map.size == size)
+        return;
+
+    for (Array2D<f32>& face : map.faces)
+        face = Array2D<f32>(static_cast<unsigned>(size), static_cast<unsigned>(size));
+
+    map.size  = size;
+    map.valid = false;
+}
+
+
+// Camera space of the face looking down 'forward' from the light: a rotation, so triangles keep their winding.
+[[gnu::const]] inline
+glm::mat3 FaceRotation(const i32 face)
+{
+    using namespace glm;
+
+    const f32  sign    = face % 2 == 0 ? 1.0f : -1.0f;
+    const vec3 forward = face < 2 ? vec3(sign, 0, 0) : face < 4 ? vec3(0, sign, 0) : vec3(0, 0, sign);
+    const vec3 up      = face < 2 or face >= 4 ? vec3(0, 1, 0) : vec3(0, 0, 1);
+    const vec3 back    = -forward;
+    const vec3 right   = cross(up, back);
+
+    // Rows 'right', 'up' and 'back'; the camera looks down -z.
+    return transpose(mat3(right, up, back));
+}
+
+// The face the direction 'from_light' goes through: along its largest axis.
+inline i32 CubeFace(const glm::vec3& from_light)
+{
+    const glm::vec3 size = glm::abs(from_light);
+
+    if (size.x >= size.y and size.x >= size.z)
+        return from_light.x >= 0 ? 0 : 1;
+    if (size.y >= size.z)
+        return from_light.y >= 0 ? 2 : 3;
+    return from_light.z >= 0 ? 4 : 5;
+}
+
+// The camera at the light that sees 'face': 90 degrees across, onto a square image.
+Camera FaceCamera(const glm::vec3& light_position, const i32 face)
+{
+    Camera camera;
+    camera.position     = light_position;
+    camera.near         = ShadowMap::NEAR;
+    camera.focal_length = camera.film_aperture_width / 2;
+    camera.film_aperture_height   = camera.film_aperture_width;
+    camera.cached_rotation_matrix = FaceRotation(face);
+    return camera;
+}
+
+
+// Draws the faces of 'map' for the light, one per task on the pool, unless they're already drawn for where it is.
+// Returns whether it drew them.
+bool DrawShadowMap(const Light& light, const Mesh& mesh, ThreadPool& pool, ShadowMap& map)
+{
+    if (map.valid and map.light_position == light.position)
+        return false;
+
+    const Viewport viewport {0, 0, map.size, map.size};
+
+    ParallelFor(pool, ShadowMap::FACES, [&](const unsigned face, unsigned)
+    {
+        const Camera  camera = FaceCamera(light.position, static_cast<i32>(face));
+        Array2D<f32>& depths = map.faces[face];
+        VertexBuffer& vertices = map.vertices[face];
+
+        Fill(depths, FarDepth(camera));
+
+        Resize(vertices, mesh);
+        TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+
+        CullingStats   culling;
+        ClippedPolygon polygon;
+
+        for (u32 triangle = 0; triangle < TriangleCount(mesh); ++triangle)
+        {
+            if (not VisibleTriangle(camera, viewport, mesh, vertices, triangle, culling, polygon))
+                continue;
+
+            for (u32 piece = 0; piece < PieceCount(polygon); ++piece)
+                RasterizeBlocks(viewport, polygon.vertices[0], polygon.vertices[piece + 1], polygon.vertices[piece + 2], DepthOnlyFragment { depths });
+        }
+    });
+
+    map.light_position = light.position;
+    map.valid          = true;
+    return true;
+}
+
+
+// How much of the light reaches 'position', on a surface with 'normal': the fraction of the texels around it in the
+// shadow map that see it, from 0 in shadow to 1. A surface facing away from the light gets none of it anyway, and is
+// taken as lit.
+[[gnu::hot]]
+f32 Lit(const ShadowMap& map, const glm::vec3& position, const glm::vec3& normal)
+{
+    using namespace glm;
+
+    static const mat3 rotations[ShadowMap::FACES] = {
+        FaceRotation(0), FaceRotation(1), FaceRotation(2), FaceRotation(3), FaceRotation(4), FaceRotation(5)
+    };
+
+    const vec3 from_light = position - map.light_position;
+    const i32  face       = CubeFace(from_light);
+    const mat3& rotation  = rotations[face];
+
+    // In the face camera's space, where the point is at 'distance' down -z, and its plane is 'n . p = plane'.
+    const vec3 p = rotation * from_light;
+    const vec3 n = rotation * normal;
+    const f32  distance = -p.z;
+    const f32  plane    = dot(n, p);
+
+    if (not (plane < 0.0f) or not (distance > 0.0f))
+        return 1.0f;
+
+    // As Project, with the image plane one unit across either way.
+    const f32 size = static_cast<f32>(map.size);
+    const f32 half   = size / 2 / distance;
+    const i32 column = static_cast<i32>(std::floor(p.x * half + size / 2));
+    const i32 row    = static_cast<i32>(std::floor(p.y * half + size / 2));
+
+    // 1/z of the point's plane where it crosses the ray through a texel's centre, 'receiver_x * x + receiver_y * y +
+    // receiver_0' at texel (x, y), and how far it changes across a texel, at most.
+    const f32 texel      = 2 / size;
+    const f32 scale      = 1 / plane;
+    const f32 receiver_x = n.x * texel * scale;
+    const f32 receiver_y = n.y * texel * scale;
+    const f32 receiver_0 = (n.x * (texel / 2 - 1) + n.y * (texel / 2 - 1) - n.z) * scale;
+    const f32 slope      = (std::abs(receiver_x) + std::abs(receiver_y)) * ShadowMap::SLOPE_BIAS;
+
+    // The texels around the point, clamped to the face.
+    constexpr i32 WIDTH = 2 * ShadowMap::PCF_RADIUS + 1;
+    i32 texel_x[WIDTH], texel_y[WIDTH];
+    for (i32 i = 0; i < WIDTH; ++i)
+    {
+        texel_x[i] = std::min(std::max(column + i - ShadowMap::PCF_RADIUS, 0), map.size - 1);
+        texel_y[i] = std::min(std::max(row    + i - ShadowMap::PCF_RADIUS, 0), map.size - 1);
+    }
+
+    i32 seen = 0;
+    for (const i32 y : texel_y)
+    {
+        const f32* depths = &map.faces[face](y, 0);
+        const f32  row_receiver = receiver_y * static_cast<f32>(y) + receiver_0;
+
+        for (const i32 x : texel_x)
+        {
+            // A plane the light sees at a grazing angle may not cross the texel's ray in front of the light at all, and
+            // then nothing there can be in front of it.
+            const f32 receiver = receiver_x * static_cast<f32>(x) + row_receiver;
+            seen += not (receiver > 0.0f) or not (depths[x] > receiver * (1.0f + ShadowMap::DEPTH_BIAS) + slope);
+        }
+    }
+
+    constexpr i32 samples = (2 * ShadowMap::PCF_RADIUS + 1) * (2 * ShadowMap::PCF_RADIUS + 1);
+    return static_cast<f32>(seen) / samples;
+}
+
+// Lit, or all of the light without a shadow map.
+inline f32 Lit(const ShadowMap* map, const glm::vec3& position, const glm::vec3& normal)
+{
+    return map ? Lit(*map, position, normal) : 1.0f;
+}
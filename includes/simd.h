@@ -0,0 +1,334 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+// Thin wrappers around the widest vector registers the target has, so the kernels can be written once.
+//
+//  * AVX2: 8 lanes.
+//  * SSE4.1: 4 lanes.
+//  * Anything else: 4 lanes emulated with plain arrays, which the compiler may or may not vectorize.
+//
+// Comparisons return masks with all bits of a lane set where true, the way the hardware does it. 'MoveMask' packs
+// them into the low bits of an integer, lane 0 in bit 0.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX2
+constexpr unsigned SIMD_WIDTH = 8;
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define SIMD_SSE
+constexpr unsigned SIMD_WIDTH = 4;
+#else
+#define SIMD_SCALAR
+constexpr unsigned SIMD_WIDTH = 4;
+#endif
+
+constexpr unsigned SIMD_ALL_LANES = (1u << SIMD_WIDTH) - 1;
+constexpr size_t   SIMD_ALIGNMENT = SIMD_WIDTH * sizeof(float);  // What Load and Store expect.
+
+
+#if defined(SIMD_AVX2)
+
+struct SimdFloat
+{
+    __m256 value;
+
+    SimdFloat() = default;
+    SimdFloat(__m256 value) : value(value) {}
+    explicit SimdFloat(float value) : value(_mm256_set1_ps(value)) {}
+};
+
+struct SimdInt
+{
+    __m256i value;
+
+    SimdInt() = default;
+    SimdInt(__m256i value) : value(value) {}
+    explicit SimdInt(int32_t value) : value(_mm256_set1_epi32(value)) {}
+};
+
+inline SimdFloat Load (const float* data) { return _mm256_load_ps(data);  }  // 32 byte aligned.
+inline SimdFloat LoadU(const float* data) { return _mm256_loadu_ps(data); }
+inline void Store (float* data, const SimdFloat& a) { _mm256_store_ps(data, a.value);  }
+inline void StoreU(float* data, const SimdFloat& a) { _mm256_storeu_ps(data, a.value); }
+
+inline SimdInt LoadU(const int32_t* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+inline void StoreU(int32_t* data, const SimdInt& a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), a.value); }
+
+// 0, 1, 2, ... in the lanes.
+inline SimdInt   LaneIndices()      { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+inline SimdFloat LaneIndicesFloat() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+
+inline SimdFloat operator+ (const SimdFloat& a, const SimdFloat& b) { return _mm256_add_ps(a.value, b.value); }
+inline SimdFloat operator- (const SimdFloat& a, const SimdFloat& b) { return _mm256_sub_ps(a.value, b.value); }
+inline SimdFloat operator* (const SimdFloat& a, const SimdFloat& b) { return _mm256_mul_ps(a.value, b.value); }
+inline SimdFloat operator/ (const SimdFloat& a, const SimdFloat& b) { return _mm256_div_ps(a.value, b.value); }
+inline SimdFloat operator- (const SimdFloat& a) { return _mm256_xor_ps(a.value, _mm256_set1_ps(-0.0f)); }  // Flips the sign, as '-x' does.
+inline SimdFloat Min(const SimdFloat& a, const SimdFloat& b) { return _mm256_min_ps(a.value, b.value); }
+inline SimdFloat Max(const SimdFloat& a, const SimdFloat& b) { return _mm256_max_ps(a.value, b.value); }
+
+inline SimdFloat operator<  (const SimdFloat& a, const SimdFloat& b) { return _mm256_cmp_ps(a.value, b.value, _CMP_LT_OQ); }
+inline SimdFloat operator<= (const SimdFloat& a, const SimdFloat& b) { return _mm256_cmp_ps(a.value, b.value, _CMP_LE_OQ); }
+inline SimdFloat operator>  (const SimdFloat& a, const SimdFloat& b) { return _mm256_cmp_ps(a.value, b.value, _CMP_GT_OQ); }
+inline SimdFloat operator>= (const SimdFloat& a, const SimdFloat& b) { return _mm256_cmp_ps(a.value, b.value, _CMP_GE_OQ); }
+inline SimdFloat operator== (const SimdFloat& a, const SimdFloat& b) { return _mm256_cmp_ps(a.value, b.value, _CMP_EQ_OQ); }
+inline SimdFloat operator!= (const SimdFloat& a, const SimdFloat& b) { return _mm256_cmp_ps(a.value, b.value, _CMP_NEQ_UQ); }
+
+inline SimdFloat operator& (const SimdFloat& a, const SimdFloat& b) { return _mm256_and_ps(a.value, b.value); }
+inline SimdFloat operator| (const SimdFloat& a, const SimdFloat& b) { return _mm256_or_ps(a.value,  b.value); }
+inline SimdFloat AndNot(const SimdFloat& a, const SimdFloat& b) { return _mm256_andnot_ps(b.value, a.value); }  // a & ~b
+
+// Lanes of 'a' where 'mask' is set, else of 'b'.
+inline SimdFloat Select(const SimdFloat& mask, const SimdFloat& a, const SimdFloat& b) { return _mm256_blendv_ps(b.value, a.value, mask.value); }
+inline SimdInt   Select(const SimdFloat& mask, const SimdInt&   a, const SimdInt&   b)
+{
+    return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.value), _mm256_castsi256_ps(a.value), mask.value));
+}
+
+inline unsigned MoveMask(const SimdFloat& mask) { return static_cast<unsigned>(_mm256_movemask_ps(mask.value)); }
+
+inline SimdInt operator+ (const SimdInt& a, const SimdInt& b) { return _mm256_add_epi32(a.value, b.value); }
+inline SimdInt operator- (const SimdInt& a, const SimdInt& b) { return _mm256_sub_epi32(a.value, b.value); }
+inline SimdInt operator* (const SimdInt& a, const SimdInt& b) { return _mm256_mullo_epi32(a.value, b.value); }
+inline SimdFloat operator<  (const SimdInt& a, const SimdInt& b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b.value, a.value)); }
+inline SimdFloat operator>  (const SimdInt& a, const SimdInt& b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(a.value, b.value)); }
+inline SimdFloat operator== (const SimdInt& a, const SimdInt& b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a.value, b.value)); }
+inline SimdInt   operator|  (const SimdInt& a, const SimdInt& b) { return _mm256_or_si256(a.value, b.value); }
+
+inline SimdFloat ToFloat(const SimdInt& a)   { return _mm256_cvtepi32_ps(a.value); }
+inline SimdInt   ToInt(const SimdFloat& a)   { return _mm256_cvttps_epi32(a.value); }  // Toward zero, like a cast.
+inline SimdInt   RoundToInt(const SimdFloat& a) { return _mm256_cvtps_epi32(a.value); } // To nearest, like std::nearbyint.
+
+// Stores the lanes where 'mask' is set and leaves the memory of the others alone.
+inline void StoreMasked(float*   data, const SimdFloat& mask, const SimdFloat& a) { _mm256_maskstore_ps(data, _mm256_castps_si256(mask.value), a.value); }
+inline void StoreMasked(int32_t* data, const SimdFloat& mask, const SimdInt&   a) { _mm256_maskstore_epi32(data, _mm256_castps_si256(mask.value), a.value); }
+
+#elif defined(SIMD_SSE)
+
+struct SimdFloat
+{
+    __m128 value;
+
+    SimdFloat() = default;
+    SimdFloat(__m128 value) : value(value) {}
+    explicit SimdFloat(float value) : value(_mm_set1_ps(value)) {}
+};
+
+struct SimdInt
+{
+    __m128i value;
+
+    SimdInt() = default;
+    SimdInt(__m128i value) : value(value) {}
+    explicit SimdInt(int32_t value) : value(_mm_set1_epi32(value)) {}
+};
+
+inline SimdFloat Load (const float* data) { return _mm_load_ps(data);  }  // 16 byte aligned.
+inline SimdFloat LoadU(const float* data) { return _mm_loadu_ps(data); }
+inline void Store (float* data, const SimdFloat& a) { _mm_store_ps(data, a.value);  }
+inline void StoreU(float* data, const SimdFloat& a) { _mm_storeu_ps(data, a.value); }
+
+inline SimdInt LoadU(const int32_t* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+inline void StoreU(int32_t* data, const SimdInt& a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), a.value); }
+
+inline SimdInt   LaneIndices()      { return _mm_setr_epi32(0, 1, 2, 3); }
+inline SimdFloat LaneIndicesFloat() { return _mm_setr_ps(0, 1, 2, 3); }
+
+inline SimdFloat operator+ (const SimdFloat& a, const SimdFloat& b) { return _mm_add_ps(a.value, b.value); }
+inline SimdFloat operator- (const SimdFloat& a, const SimdFloat& b) { return _mm_sub_ps(a.value, b.value); }
+inline SimdFloat operator* (const SimdFloat& a, const SimdFloat& b) { return _mm_mul_ps(a.value, b.value); }
+inline SimdFloat operator/ (const SimdFloat& a, const SimdFloat& b) { return _mm_div_ps(a.value, b.value); }
+inline SimdFloat operator- (const SimdFloat& a) { return _mm_xor_ps(a.value, _mm_set1_ps(-0.0f)); }  // Flips the sign, as '-x' does.
+inline SimdFloat Min(const SimdFloat& a, const SimdFloat& b) { return _mm_min_ps(a.value, b.value); }
+inline SimdFloat Max(const SimdFloat& a, const SimdFloat& b) { return _mm_max_ps(a.value, b.value); }
+
+inline SimdFloat operator<  (const SimdFloat& a, const SimdFloat& b) { return _mm_cmplt_ps(a.value,  b.value); }
+inline SimdFloat operator<= (const SimdFloat& a, const SimdFloat& b) { return _mm_cmple_ps(a.value,  b.value); }
+inline SimdFloat operator>  (const SimdFloat& a, const SimdFloat& b) { return _mm_cmpgt_ps(a.value,  b.value); }
+inline SimdFloat operator>= (const SimdFloat& a, const SimdFloat& b) { return _mm_cmpge_ps(a.value,  b.value); }
+inline SimdFloat operator== (const SimdFloat& a, const SimdFloat& b) { return _mm_cmpeq_ps(a.value,  b.value); }
+inline SimdFloat operator!= (const SimdFloat& a, const SimdFloat& b) { return _mm_cmpneq_ps(a.value, b.value); }
+
+inline SimdFloat operator& (const SimdFloat& a, const SimdFloat& b) { return _mm_and_ps(a.value, b.value); }
+inline SimdFloat operator| (const SimdFloat& a, const SimdFloat& b) { return _mm_or_ps(a.value,  b.value); }
+inline SimdFloat AndNot(const SimdFloat& a, const SimdFloat& b) { return _mm_andnot_ps(b.value, a.value); }  // a & ~b
+
+inline SimdFloat Select(const SimdFloat& mask, const SimdFloat& a, const SimdFloat& b) { return _mm_blendv_ps(b.value, a.value, mask.value); }
+inline SimdInt   Select(const SimdFloat& mask, const SimdInt&   a, const SimdInt&   b)
+{
+    return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b.value), _mm_castsi128_ps(a.value), mask.value));
+}
+
+inline unsigned MoveMask(const SimdFloat& mask) { return static_cast<unsigned>(_mm_movemask_ps(mask.value)); }
+
+inline SimdInt operator+ (const SimdInt& a, const SimdInt& b) { return _mm_add_epi32(a.value, b.value); }
+inline SimdInt operator- (const SimdInt& a, const SimdInt& b) { return _mm_sub_epi32(a.value, b.value); }
+inline SimdInt operator* (const SimdInt& a, const SimdInt& b) { return _mm_mullo_epi32(a.value, b.value); }
+inline SimdFloat operator<  (const SimdInt& a, const SimdInt& b) { return _mm_castsi128_ps(_mm_cmplt_epi32(a.value, b.value)); }
+inline SimdFloat operator>  (const SimdInt& a, const SimdInt& b) { return _mm_castsi128_ps(_mm_cmpgt_epi32(a.value, b.value)); }
+inline SimdFloat operator== (const SimdInt& a, const SimdInt& b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a.value, b.value)); }
+inline SimdInt   operator|  (const SimdInt& a, const SimdInt& b) { return _mm_or_si128(a.value, b.value); }
+
+inline SimdFloat ToFloat(const SimdInt& a)   { return _mm_cvtepi32_ps(a.value); }
+inline SimdInt   ToInt(const SimdFloat& a)   { return _mm_cvttps_epi32(a.value); }     // Toward zero, like a cast.
+inline SimdInt   RoundToInt(const SimdFloat& a) { return _mm_cvtps_epi32(a.value); }    // To nearest, like std::nearbyint.
+
+// SSE's only masked store (maskmovdqu) bypasses the cache, so blend with what's there instead. Unlike AVX2's, this
+// writes the lanes that aren't set too (with what they held), so no one else may be writing them at the same time.
+inline void StoreMasked(float*   data, const SimdFloat& mask, const SimdFloat& a) { StoreU(data, Select(mask, a, LoadU(data))); }
+inline void StoreMasked(int32_t* data, const SimdFloat& mask, const SimdInt&   a) { StoreU(data, Select(mask, a, LoadU(data))); }
+
+#else
+
+struct SimdFloat
+{
+    float value[SIMD_WIDTH];
+
+    SimdFloat() = default;
+    explicit SimdFloat(float x) { for (unsigned i = 0; i < SIMD_WIDTH; ++i) value[i] = x; }
+};
+
+struct SimdInt
+{
+    int32_t value[SIMD_WIDTH];
+
+    SimdInt() = default;
+    explicit SimdInt(int32_t x) { for (unsigned i = 0; i < SIMD_WIDTH; ++i) value[i] = x; }
+};
+
+#define SIMD_LANEWISE(Result, expression) \
+    Result result; for (unsigned i = 0; i < SIMD_WIDTH; ++i) result.value[i] = (expression); return result;
+
+// Masks are stored as floats with all bits set, like the hardware does, so they can be combined with '&' and '|'.
+inline float   MaskBits(const bool condition) { const uint32_t bits = condition ? 0xFFFFFFFFu : 0u; float mask; std::memcpy(&mask, &bits, 4); return mask; }
+inline uint32_t FloatBits(const float value)   { uint32_t bits; std::memcpy(&bits, &value, 4); return bits; }
+inline float   BitsFloat(const uint32_t bits)  { float value;   std::memcpy(&value, &bits, 4); return value; }
+
+inline SimdFloat Load (const float* data) { SIMD_LANEWISE(SimdFloat, data[i]) }
+inline SimdFloat LoadU(const float* data) { SIMD_LANEWISE(SimdFloat, data[i]) }
+inline void Store (float* data, const SimdFloat& a) { for (unsigned i = 0; i < SIMD_WIDTH; ++i) data[i] = a.value[i]; }
+inline void StoreU(float* data, const SimdFloat& a) { for (unsigned i = 0; i < SIMD_WIDTH; ++i) data[i] = a.value[i]; }
+
+inline SimdInt LoadU(const int32_t* data) { SIMD_LANEWISE(SimdInt, data[i]) }
+inline void StoreU(int32_t* data, const SimdInt& a) { for (unsigned i = 0; i < SIMD_WIDTH; ++i) data[i] = a.value[i]; }
+
+inline SimdInt   LaneIndices()      { SIMD_LANEWISE(SimdInt,   static_cast<int32_t>(i)) }
+inline SimdFloat LaneIndicesFloat() { SIMD_LANEWISE(SimdFloat, static_cast<float>(i))   }
+
+inline SimdFloat operator+ (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, a.value[i] + b.value[i]) }
+inline SimdFloat operator- (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, a.value[i] - b.value[i]) }
+inline SimdFloat operator* (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, a.value[i] * b.value[i]) }
+inline SimdFloat operator/ (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, a.value[i] / b.value[i]) }
+inline SimdFloat operator- (const SimdFloat& a) { SIMD_LANEWISE(SimdFloat, -a.value[i]) }
+inline SimdFloat Min(const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, a.value[i] < b.value[i] ? a.value[i] : b.value[i]) }
+inline SimdFloat Max(const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, a.value[i] > b.value[i] ? a.value[i] : b.value[i]) }
+
+inline SimdFloat operator<  (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] <  b.value[i])) }
+inline SimdFloat operator<= (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] <= b.value[i])) }
+inline SimdFloat operator>  (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] >  b.value[i])) }
+inline SimdFloat operator>= (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] >= b.value[i])) }
+inline SimdFloat operator== (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] == b.value[i])) }
+inline SimdFloat operator!= (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] != b.value[i])) }
+
+inline SimdFloat operator& (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, BitsFloat(FloatBits(a.value[i]) &  FloatBits(b.value[i]))) }
+inline SimdFloat operator| (const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, BitsFloat(FloatBits(a.value[i]) |  FloatBits(b.value[i]))) }
+inline SimdFloat AndNot(const SimdFloat& a, const SimdFloat& b)     { SIMD_LANEWISE(SimdFloat, BitsFloat(FloatBits(a.value[i]) & ~FloatBits(b.value[i]))) }
+
+inline SimdFloat Select(const SimdFloat& mask, const SimdFloat& a, const SimdFloat& b) { SIMD_LANEWISE(SimdFloat, FloatBits(mask.value[i]) ? a.value[i] : b.value[i]) }
+inline SimdInt   Select(const SimdFloat& mask, const SimdInt&   a, const SimdInt&   b) { SIMD_LANEWISE(SimdInt,   FloatBits(mask.value[i]) ? a.value[i] : b.value[i]) }
+
+inline unsigned MoveMask(const SimdFloat& mask)
+{
+    unsigned bits = 0;
+    for (unsigned i = 0; i < SIMD_WIDTH; ++i)
+        bits |= (FloatBits(mask.value[i]) >> 31) << i;
+    return bits;
+}
+
+inline SimdInt operator+ (const SimdInt& a, const SimdInt& b) { SIMD_LANEWISE(SimdInt, a.value[i] + b.value[i]) }
+inline SimdInt operator- (const SimdInt& a, const SimdInt& b) { SIMD_LANEWISE(SimdInt, a.value[i] - b.value[i]) }
+inline SimdInt operator* (const SimdInt& a, const SimdInt& b) { SIMD_LANEWISE(SimdInt, a.value[i] * b.value[i]) }
+inline SimdFloat operator<  (const SimdInt& a, const SimdInt& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] <  b.value[i])) }
+inline SimdFloat operator>  (const SimdInt& a, const SimdInt& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] >  b.value[i])) }
+inline SimdFloat operator== (const SimdInt& a, const SimdInt& b) { SIMD_LANEWISE(SimdFloat, MaskBits(a.value[i] == b.value[i])) }
+inline SimdInt   operator|  (const SimdInt& a, const SimdInt& b) { SIMD_LANEWISE(SimdInt,   a.value[i] | b.value[i]) }
+
+inline SimdFloat ToFloat(const SimdInt& a) { SIMD_LANEWISE(SimdFloat, static_cast<float>(a.value[i])) }
+inline SimdInt   ToInt(const SimdFloat& a) { SIMD_LANEWISE(SimdInt,   static_cast<int32_t>(a.value[i])) }
+inline SimdInt   RoundToInt(const SimdFloat& a) { SIMD_LANEWISE(SimdInt, static_cast<int32_t>(std::nearbyint(a.value[i]))) }
+
+inline void StoreMasked(float*   data, const SimdFloat& mask, const SimdFloat& a) { for (unsigned i = 0; i < SIMD_WIDTH; ++i) if (FloatBits(mask.value[i])) data[i] = a.value[i]; }
+inline void StoreMasked(int32_t* data, const SimdFloat& mask, const SimdInt&   a) { for (unsigned i = 0; i < SIMD_WIDTH; ++i) if (FloatBits(mask.value[i])) data[i] = a.value[i]; }
+
+#undef SIMD_LANEWISE
+
+#endif
+
+
+inline SimdFloat operator+= (SimdFloat& a, const SimdFloat& b) { return a = a + b; }
+inline SimdFloat operator-= (SimdFloat& a, const SimdFloat& b) { return a = a - b; }
+inline SimdFloat operator*= (SimdFloat& a, const SimdFloat& b) { return a = a * b; }
+inline SimdInt   operator+= (SimdInt&   a, const SimdInt&   b) { return a = a + b; }
+
+inline bool Any(const SimdFloat& mask) { return MoveMask(mask) != 0; }
+inline bool All(const SimdFloat& mask) { return MoveMask(mask) == SIMD_ALL_LANES; }
+
+// Lanes set in the low bits of 'bits' as a mask.
+inline SimdFloat LaneMask(const unsigned bits)
+{
+    int32_t lanes[SIMD_WIDTH];
+    for (unsigned i = 0; i < SIMD_WIDTH; ++i)
+        lanes[i] = (bits >> i) & 1u ? -1 : 0;
+
+    return LoadU(lanes) == SimdInt(-1);
+}
+
+
+// Allocates on SIMD_ALIGNMENT byte boundaries, so every SIMD_WIDTH'th element of an AlignedVector can be Load'ed.
+// C++14 has no aligned operator new, so over-allocate and keep the offset to the real block just before the data.
+template<typename T>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    // ---- CONSTRUCTORS ----
+    AlignedAllocator() = default;
+    template<typename U> AlignedAllocator(const AlignedAllocator<U>&) noexcept {}
+
+    T* allocate(const size_t count)
+    {
+        // Through operator new rather than malloc, so allocations.h counts these too.
+        unsigned char* block = static_cast<unsigned char*>(::operator new(count * sizeof(T) + SIMD_ALIGNMENT + sizeof(size_t)));
+
+        const size_t    start   = reinterpret_cast<size_t>(block + sizeof(size_t));
+        unsigned char*  aligned = block + sizeof(size_t) + (SIMD_ALIGNMENT - start % SIMD_ALIGNMENT) % SIMD_ALIGNMENT;
+        const size_t    offset  = static_cast<size_t>(aligned - block);
+        std::memcpy(aligned - sizeof(size_t), &offset, sizeof(size_t));
+
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* data, size_t) noexcept
+    {
+        unsigned char* aligned = reinterpret_cast<unsigned char*>(data);
+
+        size_t offset;
+        std::memcpy(&offset, aligned - sizeof(size_t), sizeof(size_t));
+        ::operator delete(aligned - offset);
+    }
+};
+
+template<typename T, typename U>
+bool operator== (const AlignedAllocator<T>&, const AlignedAllocator<U>&) noexcept { return true; }
+template<typename T, typename U>
+bool operator!= (const AlignedAllocator<T>&, const AlignedAllocator<U>&) noexcept { return false; }
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
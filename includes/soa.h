@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "TestModel.h"
+#include "raytracer.h"
+#include "simd.h"
+
+
+// Triangles as a structure of arrays (SoA): one aligned array per coordinate of 'v0', 'e1' and 'e2', so SIMD_WIDTH
+// consecutive triangles load straight into the lanes of nine vector registers, and the intersection kernel tests one
+// ray against all of them at once.
+//
+// Only the geometry the intersection test needs lives here. Everything needed after a hit is found, like the normal
+// and color, goes in a side table indexed by 'triangle_index' (see ShadingRecord), so traversal never pulls it into
+// the cache.
+//
+// The arrays are always padded to a multiple of SIMD_WIDTH with triangles no ray can hit (all zeros: the determinant
+// is 0).
+struct TriangleLanes
+{
+    AlignedVector<float> v0[3];
+    AlignedVector<float> e1[3];  // v1 - v0
+    AlignedVector<float> e2[3];  // v2 - v0
+};
+
+struct ShadingRecord
+{
+    glm::vec3 normal;
+    glm::vec3 color;
+};
+
+
+inline uint32_t Size(const TriangleLanes& lanes)
+{
+    return static_cast<uint32_t>(lanes.v0[0].size());
+}
+
+void Append(TriangleLanes& lanes, const TriangleRecord& triangle)
+{
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        lanes.v0[axis].push_back(triangle.v0[axis]);
+        lanes.e1[axis].push_back(triangle.e1[axis]);
+        lanes.e2[axis].push_back(triangle.e2[axis]);
+    }
+}
+
+// Appends unhittable triangles up to the next multiple of SIMD_WIDTH.
+void Pad(TriangleLanes& lanes)
+{
+    TriangleRecord unhittable;
+    unhittable.v0 = unhittable.e1 = unhittable.e2 = glm::vec3(0);
+
+    while (Size(lanes) % SIMD_WIDTH != 0)
+        Append(lanes, unhittable);
+}
+
+void Reserve(TriangleLanes& lanes, const size_t count)
+{
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        lanes.v0[axis].reserve(count);
+        lanes.e1[axis].reserve(count);
+        lanes.e2[axis].reserve(count);
+    }
+}
+
+// Gathers a single triangle back out of the lanes.
+inline TriangleRecord LoadTriangle(const TriangleLanes& lanes, const uint32_t i)
+{
+    TriangleRecord triangle;
+    triangle.v0 = glm::vec3(lanes.v0[0][i], lanes.v0[1][i], lanes.v0[2][i]);
+    triangle.e1 = glm::vec3(lanes.e1[0][i], lanes.e1[1][i], lanes.e1[2][i]);
+    triangle.e2 = glm::vec3(lanes.e2[0][i], lanes.e2[1][i], lanes.e2[2][i]);
+    return triangle;
+}
+
+
+TriangleLanes PrecomputeTriangleLanes(const std::vector<Triangle>& triangles)
+{
+    TriangleLanes lanes;
+    Reserve(lanes, triangles.size() + SIMD_WIDTH);
+
+    for (const Triangle& triangle : triangles)
+        Append(lanes, TriangleRecord(triangle));
+
+    Pad(lanes);
+    return lanes;
+}
+
+std::vector<ShadingRecord> ShadingTable(const std::vector<Triangle>& triangles)
+{
+    std::vector<ShadingRecord> shading;
+    shading.reserve(triangles.size());
+
+    for (const Triangle& triangle : triangles)
+        shading.push_back({ triangle.normal, triangle.color });
+
+    return shading;
+}
+
+
+// Intersect (see raytracer.h) for the SIMD_WIDTH triangles starting at 'first', which must be a multiple of
+// SIMD_WIDTH. Same operations in the same order, so every lane gets exactly the scalar result: 't', or -1 for a miss.
+[[gnu::hot]] inline
+SimdFloat Intersect(const TriangleLanes& lanes, const uint32_t first, const glm::vec3& start, const glm::vec3& direction)
+{
+    const SimdFloat zero (0.0f);
+    const SimdFloat one  (1.0f);
+
+    const SimdFloat direction_x (direction.x), direction_y (direction.y), direction_z (direction.z);
+
+    const SimdFloat e1_x = Load(&lanes.e1[0][first]), e1_y = Load(&lanes.e1[1][first]), e1_z = Load(&lanes.e1[2][first]);
+    const SimdFloat e2_x = Load(&lanes.e2[0][first]), e2_y = Load(&lanes.e2[1][first]), e2_z = Load(&lanes.e2[2][first]);
+
+    const SimdFloat p_x = direction_y * e2_z - e2_y * direction_z;
+    const SimdFloat p_y = direction_z * e2_x - e2_z * direction_x;
+    const SimdFloat p_z = direction_x * e2_y - e2_x * direction_y;
+
+    const SimdFloat determinant = e1_x * p_x + e1_y * p_y + e1_z * p_z;
+    const SimdFloat inverse_determinant = one / determinant;
+
+    const SimdFloat b_x = SimdFloat(start.x) - Load(&lanes.v0[0][first]);
+    const SimdFloat b_y = SimdFloat(start.y) - Load(&lanes.v0[1][first]);
+    const SimdFloat b_z = SimdFloat(start.z) - Load(&lanes.v0[2][first]);
+
+    const SimdFloat u = (b_x * p_x + b_y * p_y + b_z * p_z) * inverse_determinant;
+
+    const SimdFloat q_x = b_y * e1_z - e1_y * b_z;
+    const SimdFloat q_y = b_z * e1_x - e1_z * b_x;
+    const SimdFloat q_z = b_x * e1_y - e1_x * b_y;
+
+    const SimdFloat v = (direction_x * q_x + direction_y * q_y + direction_z * q_z) * inverse_determinant;
+    const SimdFloat t = (e2_x * q_x + e2_y * q_y + e2_z * q_z) * inverse_determinant;
+
+    const SimdFloat hit = (determinant != zero) & (u >= zero) & (u <= one) & (v >= zero) & (u + v <= one);
+    return Select(hit, t, SimdFloat(-1.0f));
+}
+
+
+// Same result as the linear scan over TriangleRecords, SIMD_WIDTH triangles per iteration.
+[[gnu::hot]]
+Intersection ClosestIntersection(const glm::vec3& start, const glm::vec3& direction, const TriangleLanes& lanes)
+{
+    const SimdFloat zero (0.0f);
+
+    // Every lane keeps its own closest hit. Within a lane the indices only grow, so keeping the first of equally close
+    // hits keeps the lowest index, like the scalar scan.
+    SimdFloat closest_t     (std::numeric_limits<float>::max());
+    SimdInt   closest_index (-1);
+
+    SimdInt index = LaneIndices();
+    const SimdInt step (static_cast<int32_t>(SIMD_WIDTH));
+
+    for (uint32_t first = 0; first < Size(lanes); first += SIMD_WIDTH)
+    {
+        const SimdFloat t = Intersect(lanes, first, start, direction);
+        const SimdFloat closer = (t >= zero) & (t < closest_t);
+
+        closest_t     = Select(closer, t,     closest_t);
+        closest_index = Select(closer, index, closest_index);
+        index += step;
+    }
+
+    alignas(32) float   t_lanes    [SIMD_WIDTH];
+    alignas(32) int32_t index_lanes[SIMD_WIDTH];
+    StoreU(t_lanes,     closest_t);
+    StoreU(index_lanes, closest_index);
+
+    float best_t     = std::numeric_limits<float>::max();
+    int   best_index = -1;
+    for (unsigned lane = 0; lane < SIMD_WIDTH; ++lane)
+    {
+        if (index_lanes[lane] == -1)
+            continue;
+
+        if (best_index == -1 or t_lanes[lane] < best_t or (t_lanes[lane] == best_t and index_lanes[lane] < best_index))
+        {
+            best_t     = t_lanes[lane];
+            best_index = index_lanes[lane];
+        }
+    }
+
+    if (best_index == -1)
+        return {};
+
+    return { start + best_t * direction, best_t, best_index };
+}
+
+// Any-hit query, see the linear version in raytracer.h.
+[[gnu::hot]]
+bool Occluded(const glm::vec3& start, const glm::vec3& direction, const float t_max, const TriangleLanes& lanes)
+{
+    const SimdFloat zero (0.0f);
+    const SimdFloat limit (t_max);
+
+    for (uint32_t first = 0; first < Size(lanes); first += SIMD_WIDTH)
+    {
+        const SimdFloat t = Intersect(lanes, first, start, direction);
+        if (Any((t >= zero) & (t < limit)))
+            return true;
+    }
+
+    return false;
+}
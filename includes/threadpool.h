@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A fixed set of threads that runs batches of independent tasks.
+//
+// Every thread owns a queue. A batch is split into contiguous chunks, one per queue, so neighbouring tasks (e.g. tiles)
+// tend to run on the same thread. A thread takes tasks from the back of its own queue and, once it's empty, steals
+// from the front of the others. That keeps the threads busy even when some tasks are a lot more expensive than others.
+// The calling thread takes part as thread 0, so a pool of one thread runs everything on the caller.
+//
+// Running a batch doesn't allocate: the job is only referenced for the duration of ParallelFor, and every queue is a
+// range of task indices rather than a container.
+struct ThreadPool
+{
+    // A reference to the caller's function object, with its type erased.
+    struct Job
+    {
+        void (*invoke)(const void* function, unsigned task, unsigned thread) = nullptr;
+        const void* function = nullptr;
+    };
+
+    // The tasks in [front, back). The owner pops from the back, thieves from the front.
+    struct Queue
+    {
+        std::mutex mutex;
+        unsigned   front = 0;
+        unsigned   back  = 0;
+    };
+
+    // Collected per thread and reset by ResetStatistics. Only the owning thread writes to its entry.
+    struct ThreadStatistics
+    {
+        unsigned tasks  = 0;
+        unsigned steals = 0;
+        double   busy   = 0;  // Seconds spent running tasks.
+    };
+
+    unsigned thread_count;
+
+    std::vector<std::thread>      threads;
+    std::unique_ptr<Queue[]>      queues;
+    std::vector<ThreadStatistics> statistics;
+
+    Job job;
+    std::atomic<unsigned> remaining { 0 };
+
+    std::mutex              mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+    uint64_t generation = 0;
+    bool     stopping   = false;
+
+
+    // ---- CONSTRUCTORS ----
+    explicit ThreadPool(unsigned thread_count = std::thread::hardware_concurrency());
+
+    // ---- COPY/MOVE CONSTRUCTOR ----
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator= (const ThreadPool& other) = delete;
+
+    // ---- DESTRUCTOR ----
+    ~ThreadPool();
+};
+
+
+// Pops a task from the thread's own queue, or steals one from another. Returns false when all queues are empty.
+bool NextTask(ThreadPool& pool, const unsigned thread, unsigned& task, bool& stolen)
+{
+    for (unsigned i = 0; i < pool.thread_count; ++i)
+    {
+        const unsigned victim = (thread + i) % pool.thread_count;
+        ThreadPool::Queue& queue = pool.queues[victim];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.front == queue.back)
+            continue;
+
+        if (victim == thread)
+            task = --queue.back;
+        else
+            task = queue.front++;
+
+        stolen = victim != thread;
+        return true;
+    }
+
+    return false;
+}
+
+void RunTasks(ThreadPool& pool, const unsigned thread)
+{
+    using Clock = std::chrono::steady_clock;
+
+    ThreadPool::ThreadStatistics& statistics = pool.statistics[thread];
+
+    unsigned task;
+    bool     stolen;
+    while (NextTask(pool, thread, task, stolen))
+    {
+        const Clock::time_point start = Clock::now();
+        pool.job.invoke(pool.job.function, task, thread);
+        statistics.busy   += std::chrono::duration<double>(Clock::now() - start).count();
+        statistics.tasks  += 1;
+        statistics.steals += stolen;
+
+        if (pool.remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.done_condition.notify_all();
+        }
+    }
+}
+
+void WorkerLoop(ThreadPool& pool, const unsigned thread)
+{
+    uint64_t seen_generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.start_condition.wait(lock, [&]() { return pool.stopping or pool.generation != seen_generation; });
+
+            if (pool.stopping)
+                return;
+
+            seen_generation = pool.generation;
+        }
+
+        RunTasks(pool, thread);
+    }
+}
+
+
+ThreadPool::ThreadPool(const unsigned thread_count) :
+        thread_count(thread_count > 0 ? thread_count : 1),
+        queues(new Queue[thread_count > 0 ? thread_count : 1]),
+        statistics(thread_count > 0 ? thread_count : 1)
+{
+    for (unsigned thread = 1; thread < this->thread_count; ++thread)
+        threads.emplace_back(WorkerLoop, std::ref(*this), thread);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_condition.notify_all();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+
+void RunBatch(ThreadPool& pool, const unsigned task_count, const ThreadPool::Job job)
+{
+    if (task_count == 0)
+        return;
+
+    pool.job = job;
+    pool.remaining = task_count;
+
+    // The owner pops from the back of its chunk, so each thread starts with the last task of its chunk and the
+    // thieves take the first ones.
+    const unsigned chunk = (task_count + pool.thread_count - 1) / pool.thread_count;
+    for (unsigned thread = 0; thread < pool.thread_count; ++thread)
+    {
+        std::lock_guard<std::mutex> lock(pool.queues[thread].mutex);
+
+        pool.queues[thread].front = std::min(thread * chunk, task_count);
+        pool.queues[thread].back  = std::min(pool.queues[thread].front + chunk, task_count);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.generation += 1;
+    }
+    pool.start_condition.notify_all();
+
+    RunTasks(pool, 0);
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done_condition.wait(lock, [&]() { return pool.remaining == 0; });
+}
+
+// Runs 'function(task, thread)' for every task in [0, task_count) and returns when all of them are done. 'thread' is
+// in [0, pool.thread_count) and can be used to index per-thread scratch data.
+template <typename Function>
+void ParallelFor(ThreadPool& pool, const unsigned task_count, const Function& function)
+{
+    ThreadPool::Job job;
+    job.function = &function;
+    job.invoke   = [](const void* function, const unsigned task, const unsigned thread)
+    {
+        (*static_cast<const Function*>(function))(task, thread);
+    };
+
+    RunBatch(pool, task_count, job);
+}
+
+
+void ResetStatistics(ThreadPool& pool)
+{
+    for (ThreadPool::ThreadStatistics& statistics : pool.statistics)
+        statistics = {};
+}
+
+// One line per thread. Threads with a lot less busy time than the others point at an uneven split of the work.
+void PrintStatistics(const ThreadPool& pool, const char* task_name = "tasks")
+{
+    for (unsigned thread = 0; thread < pool.thread_count; ++thread)
+    {
+        const ThreadPool::ThreadStatistics& statistics = pool.statistics[thread];
+        printf(
+            "\tThread %2u | %5u %s (%4u stolen) | Busy %8.3f ms\n",
+            thread, statistics.tasks, task_name, statistics.steals, statistics.busy * 1000.0
+        );
+    }
+}
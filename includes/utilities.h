@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstring>
+
 constexpr float PI = 3.14159265358979323846264338327950288f;
 
 
@@ -14,13 +16,14 @@ struct Array2D
 
 
     // ---- CONSTRUCTORS ----
+    // Allocated with new[] to match the delete[] in the destructor.
     Array2D(unsigned rows, unsigned columns) : rows(rows), columns(columns)
     {
-        data = static_cast<T*>(malloc(rows * columns * sizeof(T)));
+        data = new T[rows * columns];
     }
     Array2D(unsigned rows, unsigned columns, T fill) : rows(rows), columns(columns)
     {
-        data = static_cast<T*>(malloc(rows * columns * sizeof(T)));
+        data = new T[rows * columns];
         for (unsigned i = 0; i < rows * columns; ++i)
             data[i] = fill;
     }
@@ -30,7 +33,7 @@ struct Array2D
     {
         Assert(false, "Don't copy! If you really want it, do it yourself!");
 
-        data = static_cast<T*>(malloc(rows * columns * sizeof(T)));
+        data = new T[rows * columns];
 
         for (unsigned i = 0; i < rows * columns; ++i)
             data[i] = other.data[i];
@@ -49,7 +52,7 @@ struct Array2D
     {
         Assert(false, "Don't copy! If you really want it, do it yourself!");
 
-        data = malloc(rows * columns * sizeof(T));
+        data = new T[rows * columns];
 
         for (unsigned i = 0; i < rows * columns; ++i)
             data[i] = other.data[i];
@@ -83,4 +86,41 @@ template <typename T>
 void Clear(Array2D<T>& array)
 {
     std::memset(array.data, 0, array.rows * array.columns * sizeof(T));
-}
\ No newline at end of file
+}
+
+// Rows x columns elements owned by someone else, like an Array2D or a locked SDL texture, with rows 'stride'
+// elements apart. Lets a renderer write straight into the caller's memory.
+template <typename T>
+struct Array2DView
+{
+    using Type = T;
+
+    Type* data;
+    unsigned rows;
+    unsigned columns;
+    unsigned stride;
+
+    inline T& operator() (unsigned row, unsigned column) const noexcept { return data[row * stride + column]; }
+    inline T& operator() (int      row, int      column) const noexcept { return data[row * stride + column]; }
+};
+
+template <typename T>
+Array2DView<T> View(const Array2D<T>& array)
+{
+    return { array.data, array.rows, array.columns, array.columns };
+}
+
+template <typename T>
+void Fill(const Array2DView<T>& view, T value)
+{
+    for (unsigned row = 0; row < view.rows; ++row)
+        for (unsigned column = 0; column < view.columns; ++column)
+            view(row, column) = value;
+}
+
+template <typename T>
+void Clear(const Array2DView<T>& view)
+{
+    for (unsigned row = 0; row < view.rows; ++row)
+        std::memset(&view(row, 0u), 0, view.columns * sizeof(T));
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "lab3.h"
+#include "shadows.h"
+
+
+// Perspective correct interpolation of what's given at a triangle's vertices, the varyings: world positions, normals,
+// texture coordinates, colors, N floats of any of them. Only the barycentric coordinates of the triangle's second and
+// third vertex are planes over the pixels, as in the G-buffer of deferred.h, divided by z so they're linear in screen
+// space. Every varying is then two multiplies and two adds from them at a pixel, so a shader pays for the ones it uses
+// and no more, with N fixed at compile time so the loops over them unroll.
+
+
+template <unsigned N>
+struct Varyings
+{
+    f32 values[N];
+};
+
+template <unsigned N>
+struct VaryingInterpolator
+{
+    static_assert(N > 0, "Nothing to interpolate.");
+
+    ScreenPlane barycentrics[2];  // Of the second and third vertex, divided by z (see PerspectivePlane).
+    f32         at_first[N];      // The varyings at the first vertex,
+    f32         to_second[N];     // and how much they change from it to the second and the third.
+    f32         to_third[N];
+
+    // At the centre of the pixel (x, y), where the triangle's 1/z is 'depth'.
+    inline void At(const i32 x, const i32 y, const f32 depth, Varyings<N>& varyings) const noexcept
+    {
+        const f32 z  = 1.0f / depth;
+        const f32 b1 = barycentrics[0].At(x, y) * z;
+        const f32 b2 = barycentrics[1].At(x, y) * z;
+
+        for (unsigned i = 0; i < N; ++i)
+            varyings.values[i] = at_first[i] + b1 * to_second[i] + b2 * to_third[i];
+    }
+    // At the SIMD_WIDTH pixels from (x, y) rightwards, the same as At on each of them.
+    inline void At(const i32 x, const i32 y, const SimdFloat& depth, SimdFloat (&varyings)[N]) const noexcept
+    {
+        const SimdFloat z  = SimdFloat(1.0f) / depth;
+        const SimdFloat b1 = barycentrics[0].At(x, barycentrics[0].Row(y)) * z;
+        const SimdFloat b2 = barycentrics[1].At(x, barycentrics[1].Row(y)) * z;
+
+        for (unsigned i = 0; i < N; ++i)
+            varyings[i] = SimdFloat(at_first[i]) + b1 * SimdFloat(to_second[i]) + b2 * SimdFloat(to_third[i]);
+    }
+};
+
+// The interpolator for a piece of a triangle (see ClipTriangle) with 'vertices' at the triangle's own vertices.
+template <unsigned N>
+VaryingInterpolator<N> Interpolator(
+        const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2, const PieceBarycentrics& piece,
+        const Varyings<N> (&vertices)[3]
+)
+{
+    VaryingInterpolator<N> interpolator;
+    interpolator.barycentrics[0] = PerspectivePlane(p0, p1, p2, piece.vertices[0].x, piece.vertices[1].x, piece.vertices[2].x);
+    interpolator.barycentrics[1] = PerspectivePlane(p0, p1, p2, piece.vertices[0].y, piece.vertices[1].y, piece.vertices[2].y);
+
+    for (unsigned i = 0; i < N; ++i)
+    {
+        interpolator.at_first[i]  = vertices[0].values[i];
+        interpolator.to_second[i] = vertices[1].values[i] - vertices[0].values[i];
+        interpolator.to_third[i]  = vertices[2].values[i] - vertices[0].values[i];
+    }
+
+    return interpolator;
+}
+
+
+// The world position of the mesh's 'vertex', as a varying.
+inline Varyings<3> WorldPosition(const Mesh& mesh, const u32 vertex)
+{
+    return { { mesh.positions[0][vertex], mesh.positions[1][vertex], mesh.positions[2][vertex] } };
+}
+
+// Depth tests a fragment of a piece of the mesh's triangle, and shades it with PixelShader at the world position
+// interpolated from its vertices where it's closer. With EQUAL_DEPTH, it's the color pass after a depth pre-pass
+// instead, and shades where the depth is the one in the z-buffer, as DepthEqualFragment. Counts the fragments it shades
+// into 'shaded', when there is one, and shades them in the shadows of 'shadows', when there is a shadow map.
+template <bool EQUAL_DEPTH = false>
+struct LitFragment
+{
+    Array2D<f32>&           z_buffer;
+    const Array2DView<u32>& framebuffer;
+    const Light&            light;
+    glm::vec3               normal;
+    glm::vec3               color;
+    VaryingInterpolator<3>  world_position;
+    u64*                    shaded  = nullptr;
+    const ShadowMap*        shadows = nullptr;
+
+    inline void Shade(const i32 x, const i32 y, const f32 depth, const Varyings<3>& position) const noexcept
+    {
+        const f32 z = 1.0f / depth;
+        const glm::vec3 world (position.values[0], position.values[1], position.values[2]);
+        framebuffer(y, x) = ColorCode(PixelShader(Pixel(x, y, z, world / z), light, normal, color, Lit(shadows, world, normal)));
+    }
+
+    inline void operator() (const i32 x, const i32 y, const f32 depth) const noexcept
+    {
+        if (EQUAL_DEPTH ? not (z_buffer(y, x) == depth) : not (z_buffer(y, x) < depth))
+            return;
+
+        if (not EQUAL_DEPTH)
+            z_buffer(y, x) = depth;
+
+        Varyings<3> position;
+        world_position.At(x, y, depth, position);
+        Shade(x, y, depth, position);
+
+        if (shaded)
+            *shaded += 1;
+    }
+    // SIMD_WIDTH pixels from (x, y) rightwards at once, for RasterizeBlocks. Interpolates in SIMD, and shades the lanes
+    // that pass one by one.
+    inline void operator() (const i32 x, const i32 y, const SimdFloat& depth, const SimdFloat& covered) const noexcept
+    {
+        f32* depths = &z_buffer(y, x);
+
+        const SimdFloat passed = covered & (EQUAL_DEPTH ? LoadU(depths) == depth : LoadU(depths) < depth);
+        unsigned lanes = MoveMask(passed);
+        if (lanes == 0)
+            return;
+
+        if (not EQUAL_DEPTH)
+            StoreMasked(depths, passed, depth);
+
+        SimdFloat positions[3];
+        world_position.At(x, y, depth, positions);
+
+        alignas(SIMD_ALIGNMENT) f32 depth_lanes[SIMD_WIDTH];
+        alignas(SIMD_ALIGNMENT) f32 position_lanes[3][SIMD_WIDTH];
+        Store(depth_lanes, depth);
+        for (unsigned i = 0; i < 3; ++i)
+            Store(position_lanes[i], positions[i]);
+
+        if (shaded)
+            *shaded += static_cast<u64>(__builtin_popcount(lanes));
+
+        for (unsigned lane = 0; lanes != 0; ++lane, lanes >>= 1)
+            if (lanes & 1u)
+                Shade(x + static_cast<i32>(lane), y, depth_lanes[lane], { { position_lanes[0][lane], position_lanes[1][lane], position_lanes[2][lane] } });
+    }
+};
+
+// The fragment functor of LitFragment for a piece of the mesh's 'triangle'.
+template <bool EQUAL_DEPTH = false>
+LitFragment<EQUAL_DEPTH> LitFragmentFor(
+        const Mesh& mesh, const Light& light, const u32 triangle,
+        const RasterVertex& p0, const RasterVertex& p1, const RasterVertex& p2, const PieceBarycentrics& piece,
+        Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer, u64* shaded = nullptr, const ShadowMap* shadows = nullptr
+)
+{
+    const Varyings<3> positions[3] = {
+        WorldPosition(mesh, mesh.indices[3 * triangle + 0]),
+        WorldPosition(mesh, mesh.indices[3 * triangle + 1]),
+        WorldPosition(mesh, mesh.indices[3 * triangle + 2])
+    };
+
+    return {
+        z_buffer, framebuffer, light, mesh.normals[triangle], mesh.shading_colors[triangle],
+        Interpolator(p0, p1, p2, piece, positions), shaded, shadows
+    };
+}
+
+
+// Draw, lit with PixelShader at every fragment that passes the depth test, at the world position the varyings give.
+// The forward counterpart of DrawDeferred. Returns what culling dropped.
+CullingStats DrawLit(
+        const Camera& camera, const Light& light, const Viewport& viewport, const Mesh& mesh, VertexBuffer& vertices,
+        Array2D<f32>& z_buffer, const Array2DView<u32>& framebuffer, const ShadowMap* shadows = nullptr
+)
+{
+    Clear(framebuffer);
+    Fill(z_buffer, FarDepth(camera));
+
+    Resize(vertices, mesh);
+    TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+
+    CullingStats   culling;
+    ClippedPolygon polygon;
+
+    for (u32 triangle = 0; triangle < TriangleCount(mesh); ++triangle)
+    {
+        if (not VisibleTriangle(camera, viewport, mesh, vertices, triangle, culling, polygon))
+            continue;
+
+        for (u32 piece = 0; piece < PieceCount(polygon); ++piece)
+        {
+            const RasterVertex& p0 = polygon.vertices[0];
+            const RasterVertex& p1 = polygon.vertices[piece + 1];
+            const RasterVertex& p2 = polygon.vertices[piece + 2];
+            RasterizeBlocks(viewport, p0, p1, p2,
+                LitFragmentFor(mesh, light, triangle, p0, p1, p2, Barycentrics(polygon, piece), z_buffer, framebuffer, nullptr, shadows));
+        }
+    }
+
+    return culling;
+}
@@ -0,0 +1,387 @@
+// Renders Lab2 or Lab3 along a scripted camera and light path without opening a window, and reports how long every
+// frame took and how many heap allocations it made. Meant for machines without a display, and for measuring
+// throughput reproducibly.
+//
+// Usage: Headless <lab2|lab3> <path file> [options]
+//     --frames <count>       Frames to render. Defaults to up to and including the path's last key.
+//     --size <width> <height>
+//     --threads <count>      Defaults to all of them.
+//     --samples <count>      Path trace Lab2 (see includes/pathtracer.h), with this many samples per pixel per frame.
+//                            Samples keep accumulating while the camera and light stay put.
+//     --deferred             Shade Lab3 deferred, with PixelShader once per pixel (see includes/deferred.h).
+//     --depth-prepass        Fill Lab3's z-buffer before shading anything, so every pixel is shaded once (see
+//                            includes/binning.h).
+//     --occlusion-culling    Cull the clusters of Lab3's mesh hidden behind its largest triangles before the vertex stage
+//                            (see includes/occlusion.h).
+//     --lit                  Shade Lab3 forward with PixelShader, at the world positions the varyings give (see
+//                            includes/varyings.h).
+//     --pipelined            Run the geometry of Lab3's next frame while the current one is drawn, on a second pool of
+//                            as many threads (see includes/pipeline.h).
+//     --shadows <size>       Shade Lab3 --deferred or --lit in the shadows of a shadow map with faces of this many texels
+//                            on a side (see includes/shadows.h).
+//     --output <directory>   Write every frame to '<directory>/frame_0000.ppm' etc. Only timings are reported without it.
+//
+// See includes/path.h for the path file format, and paths/ for examples.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocations.h"
+#include "SDLhelper.h"
+#include "TestModel.h"
+#include "utilities.h"
+#include "camera.h"
+#include "light.h"
+#include "path.h"
+#include "lab2.h"
+#include "lab3.h"
+#include "binning.h"
+#include "pipeline.h"
+#include "shadows.h"
+#include "pathtracer.h"
+
+
+struct Options
+{
+    std::string lab;
+    std::string path_file;
+    std::string output_directory;  // Empty for timing only.
+
+    unsigned frames  = 0;          // 0 for FrameCount(path).
+    int      width   = 0;          // 0 for the lab's own size.
+    int      height  = 0;
+    unsigned threads = std::thread::hardware_concurrency();
+    unsigned samples = 0;          // 0 for Lab2's ray tracer rather than the path tracer.
+    bool     deferred = false;     // Lab3 only.
+    bool     depth_prepass = false;  // Lab3 only.
+    bool     lit = false;          // Lab3 only.
+    bool     occlusion_culling = false;  // Lab3 only.
+    bool     pipelined = false;    // Lab3 only.
+    int      shadow_map_size = 0;  // Lab3 only. 0 for no shadows.
+};
+
+Options ParseOptions(const int argc, char* argv[])
+{
+    Assert(argc >= 3, "Usage: %s <lab2|lab3> <path file> [--frames N] [--size W H] [--threads N] [--samples N] [--deferred] [--depth-prepass] [--lit] [--occlusion-culling] [--pipelined] [--shadows SIZE] [--output DIR]", argv[0]);
+
+    Options options;
+    options.lab       = argv[1];
+    options.path_file = argv[2];
+
+    Assert(options.lab == "lab2" or options.lab == "lab3", "Unknown lab '%s', expected lab2 or lab3.", options.lab.c_str());
+
+    for (int i = 3; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const int arguments_left = argc - i - 1;
+
+        if (option == "--frames" and arguments_left >= 1)
+            options.frames = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (option == "--size" and arguments_left >= 2)
+        {
+            options.width  = std::atoi(argv[++i]);
+            options.height = std::atoi(argv[++i]);
+        }
+        else if (option == "--threads" and arguments_left >= 1)
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (option == "--samples" and arguments_left >= 1)
+            options.samples = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (option == "--deferred")
+            options.deferred = true;
+        else if (option == "--depth-prepass")
+            options.depth_prepass = true;
+        else if (option == "--lit")
+            options.lit = true;
+        else if (option == "--occlusion-culling")
+            options.occlusion_culling = true;
+        else if (option == "--pipelined")
+            options.pipelined = true;
+        else if (option == "--shadows" and arguments_left >= 1)
+            options.shadow_map_size = std::atoi(argv[++i]);
+        else if (option == "--output" and arguments_left >= 1)
+            options.output_directory = argv[++i];
+        else
+            Assert(false, "Unknown option '%s', or it's missing its arguments.", option.c_str());
+    }
+
+    return options;
+}
+
+
+// Binary PPM (P6). Drops the alpha channel.
+void WritePPM(const std::string& filename, const Uint32* pixels, const int width, const int height)
+{
+    std::ofstream file(filename, std::ios::binary);
+    Assert(file.is_open(), "Couldn't write '%s'.", filename.c_str());
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const Uint32 pixel = pixels[y * width + x];
+            row[x * 3 + 0] = static_cast<unsigned char>(pixel >> 16);
+            row[x * 3 + 1] = static_cast<unsigned char>(pixel >> 8);
+            row[x * 3 + 2] = static_cast<unsigned char>(pixel);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+}
+
+std::string FrameFilename(const std::string& directory, const unsigned frame)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "frame_%04u.ppm", frame);
+    return directory + "/" + name;
+}
+
+
+// Moves the camera and light to where the path has them at 'frame'. Bumps the camera's version only if it moved, so
+// Lab2 keeps its primary hits while just the light moves.
+void Place(Camera& camera, Light& light, const PathKey& key)
+{
+    if (key.camera_position != camera.position or key.camera_yaw != camera.yaw or camera.version == 0)
+    {
+        camera.position = key.camera_position;
+        SetYaw(camera, key.camera_yaw);
+        camera.version += 1;
+    }
+
+    light.position = key.light_position;
+}
+
+
+// 'allocations' is per frame. The first 'warm_up' frames warm up (the thread pool, Lab2's primary hits, every slot of
+// Lab3's pipeline), so only the rest are expected to be allocation free, but for Lab3's tile bins growing the first
+// time a view puts more triangles on screen than any before it.
+void ReportTimings(const std::vector<double>& seconds, const std::vector<uint64_t>& allocations, const size_t warm_up)
+{
+    if (seconds.empty())
+        return;
+
+    std::vector<double> sorted = seconds;
+    std::sort(sorted.begin(), sorted.end());
+
+    double total = 0;
+    for (const double frame : seconds)
+        total += frame;
+
+    printf(
+        "Frames %zu | Total %.3f s | Mean %.3f ms | Median %.3f ms | Min %.3f ms | Max %.3f ms | %.2f frames/s\n",
+        seconds.size(), total, total / seconds.size() * 1000.0, sorted[sorted.size() / 2] * 1000.0,
+        sorted.front() * 1000.0, sorted.back() * 1000.0, seconds.size() / total
+    );
+
+    uint64_t warm_up_allocations = 0;
+    uint64_t steady_allocations  = 0;
+    for (size_t frame = 0; frame < allocations.size(); ++frame)
+        (frame < warm_up ? warm_up_allocations : steady_allocations) += allocations[frame];
+
+    if (warm_up == 1)
+        printf("Allocations | First frame %llu", static_cast<unsigned long long>(warm_up_allocations));
+    else
+        printf("Allocations | First %zu frames %llu", warm_up, static_cast<unsigned long long>(warm_up_allocations));
+    printf(" | Later frames %llu\n", static_cast<unsigned long long>(steady_allocations));
+}
+
+
+int main(int argc, char* argv[])
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Options options = ParseOptions(argc, argv);
+
+    const Path path = LoadPath(options.path_file);
+    const std::vector<Triangle> model = LoadScene(path);
+
+    const bool     lab2   = options.lab == "lab2";
+    const int      width  = options.width  > 0 ? options.width  : (lab2 ? 300 : 400);
+    const int      height = options.height > 0 ? options.height : (lab2 ? 300 : 400);
+    const unsigned frames = options.frames > 0 ? options.frames : FrameCount(path);
+
+    printf(
+        "%s | %s | %zu triangles | %dx%d | %u frames\n",
+        options.lab.c_str(), options.path_file.c_str(), model.size(), width, height, frames
+    );
+
+    Camera camera;
+    Light  light;
+    ThreadPool pool(options.threads);
+
+    // Lab2.
+    const float focal_length = width / 2.0f;
+    BVH bvh;
+    std::vector<ShadingRecord> shading;
+    PrimaryHits primary_hits(lab2 ? width : 0, lab2 ? height : 0);
+    Accumulation accumulation(lab2 ? width : 0, lab2 ? height : 0);
+
+    // Lab3.
+    const Viewport viewport {0, 0, width, height};
+    Array2D<f32> z_buffer(lab2 ? 0 : height, lab2 ? 0 : width);
+    const Mesh mesh = lab2 ? Mesh() : IndexedMesh(model);
+    TileBins bins;
+    GBuffer  gbuffer;
+    ShadowMap shadows;
+    Resize(shadows, options.shadow_map_size);
+    const ShadowMap* shadow_map = options.shadow_map_size > 0 ? &shadows : nullptr;
+    unsigned shadow_maps_drawn = 0;
+    bins.depth_prepass     = options.depth_prepass;
+    bins.occlusion_culling = options.occlusion_culling;
+
+    // With --pipelined, every frame is binned into one of the pipeline's slots instead of 'bins'.
+    std::unique_ptr<FramePipeline> pipeline;
+    if (options.pipelined and not lab2)
+    {
+        pipeline.reset(new FramePipeline(mesh, viewport, options.threads));
+        for (PipelinedFrame& frame : pipeline->frames)
+        {
+            frame.bins.depth_prepass     = options.depth_prepass;
+            frame.bins.occlusion_culling = options.occlusion_culling;
+        }
+    }
+
+    Array2D<Uint32> image(height, width);
+    const Array2DView<Uint32> target = View(image);
+
+    // Lab3's tiles, once the frame seen with 'frame_camera' is binned.
+    const auto draw_bins = [&](const Camera& frame_camera, const Light& frame_light, TileBins& frame_bins)
+    {
+        if (shadow_map and (options.deferred or options.lit))
+            shadow_maps_drawn += DrawShadowMap(frame_light, mesh, pool, shadows);
+
+        if (options.deferred)
+            DrawBinsDeferred(frame_camera, frame_light, viewport, mesh, pool, frame_bins, gbuffer, target, shadow_map);
+        else if (options.lit)
+            DrawBinsLit(frame_camera, frame_light, viewport, mesh, pool, frame_bins, z_buffer, target, shadow_map);
+        else
+            DrawBins(frame_camera, viewport, pool, frame_bins, z_buffer, target);
+    };
+
+    if (lab2)
+    {
+        const Clock::time_point start = Clock::now();
+        bvh     = BuildBVH(model);
+        shading = ShadingTable(model);
+        printf("BVH built in %.3f ms\n", std::chrono::duration<double>(Clock::now() - start).count() * 1000.0);
+    }
+    else
+    {
+        light.color = glm::vec3(1.0f, 1.0f, 1.0f) * 1.4f;
+    }
+
+    std::vector<double> seconds;
+    std::vector<uint64_t> allocations;
+    OcclusionStats occlusion;
+    ShadingStats   shaded;
+    ClusterStats   clusters;
+    seconds.reserve(frames);
+    allocations.reserve(frames);
+
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        Place(camera, light, Sample(path, frame));
+
+        const uint64_t allocations_before = AllocationCount();
+        const Clock::time_point start = Clock::now();
+
+        const TileBins* frame_bins = &bins;
+
+        if (lab2 and options.samples > 0)
+            DrawPathTraced(camera, light, focal_length, shading, bvh, pool, accumulation, target, options.samples);
+        else if (lab2)
+            Draw(camera, light, focal_length, shading, bvh, pool, primary_hits, target);
+        else if (pipeline)
+        {
+            // The first frame's geometry has nothing to overlap with. After that, every frame's began while the one
+            // before was drawn, and the next one's begins now.
+            if (frame == 0)
+                BeginFrame(*pipeline, camera, light);
+
+            if (frame + 1 < frames)
+            {
+                Camera next_camera = camera;
+                Light  next_light  = light;
+                Place(next_camera, next_light, Sample(path, frame + 1));
+                BeginFrame(*pipeline, next_camera, next_light);
+            }
+
+            frame_bins = &DrawFrame(*pipeline, draw_bins).bins;
+        }
+        else
+        {
+            Bin(camera, viewport, mesh, pool, bins);
+            draw_bins(camera, light, bins);
+        }
+
+        if (not lab2)
+        {
+            occlusion += Occlusion(*frame_bins);
+            shaded    += Shading(*frame_bins);
+            clusters  += frame_bins->cluster_culling;
+        }
+
+        seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        allocations.push_back(AllocationCount() - allocations_before);
+        printf("Frame %4u | %9.3f ms | %llu allocations",
+            frame, seconds.back() * 1000.0, static_cast<unsigned long long>(allocations.back()));
+        if (not lab2)
+        {
+            const CullingStats culling = Culling(*frame_bins);
+            printf(" | Culled %llu of %llu triangles (%llu back facing, %llu outside the frustum, %llu occluded) | Clipped %llu",
+                static_cast<unsigned long long>(Culled(culling)),          static_cast<unsigned long long>(culling.submitted),
+                static_cast<unsigned long long>(culling.back_facing),      static_cast<unsigned long long>(culling.outside_frustum),
+                static_cast<unsigned long long>(culling.occluded),         static_cast<unsigned long long>(culling.clipped));
+        }
+        printf("\n");
+
+        if (not options.output_directory.empty())
+            WritePPM(FrameFilename(options.output_directory, frame), image.data, width, height);
+    }
+
+    ReportTimings(seconds, allocations, pipeline ? FramePipeline::FRAMES : 1);
+
+    if (not lab2)
+    {
+        printf(
+            "Hierarchical z | Culled %llu of %llu triangles and %llu of %llu blocks | %.0f pixels per frame\n",
+            static_cast<unsigned long long>(occlusion.triangles_culled), static_cast<unsigned long long>(occlusion.triangles),
+            static_cast<unsigned long long>(occlusion.blocks_culled),    static_cast<unsigned long long>(occlusion.blocks),
+            static_cast<double>(occlusion.pixels_culled) / frames
+        );
+        if (options.occlusion_culling)
+            printf(
+                "Occlusion culling | Culled %llu of %llu clusters | %.1f occluders per frame\n",
+                static_cast<unsigned long long>(clusters.culled), static_cast<unsigned long long>(clusters.clusters),
+                static_cast<double>(clusters.occluders) / frames
+            );
+        printf(
+            "Shading (%s%s) | %.3f fragments shaded per pixel\n",
+            options.deferred ? "deferred" : options.depth_prepass ? "depth pre-pass" : "forward",
+            options.lit and not options.deferred ? ", lit" : "", ShadedPerPixel(shaded)
+        );
+        if (shadow_maps_drawn > 0)
+            printf(
+                "Shadows | %dx%d texels a face | Drawn in %u of %u frames\n",
+                options.shadow_map_size, options.shadow_map_size, shadow_maps_drawn, frames
+            );
+    }
+
+    if (lab2 and options.samples > 0)
+    {
+        printf(
+            "Path tracing | %u samples per pixel | %.3f M samples/s | Error %.4f | ",
+            accumulation.samples, SamplesPerSecond(accumulation) / 1e6, accumulation.error
+        );
+        if (accumulation.converged_seconds >= 0)
+            printf("Converged to %.2f after %.3f s\n", Accumulation::CONVERGED_ERROR, accumulation.converged_seconds);
+        else
+            printf("Not converged to %.2f yet\n", Accumulation::CONVERGED_ERROR);
+    }
+}
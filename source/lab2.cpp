@@ -11,173 +11,12 @@
 #include "SDLhelper.h"
 #include "TestModel.h"
 #include "utilities.h"
+#include "camera.h"
+#include "light.h"
+#include "lab2.h"
+#include "pathtracer.h"
 
 
-struct Camera
-{
-    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
-
-    glm::vec3 right    = glm::vec3(1.0f, 0.0f,  0.0f);
-    glm::vec3 up       = glm::vec3(0.0f, 1.0f,  0.0f);
-    glm::vec3 forward  = glm::vec3(0.0f, 0.0f, -1.0f);
-
-    float yaw = 0;
-
-    glm::mat3 cached_rotation_matrix = glm::mat3();  // Initialized as identity matrix.
-};
-
-struct Light
-{
-    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
-    glm::vec3 color    = glm::vec3(1.0f, 1.0f, 1.0f) * 14.0f;
-    glm::vec3 ambient  = glm::vec3(1.0f, 1.0f, 1.0f) *  0.5f;
-};
-
-struct Intersection
-{
-    glm::vec3 position       = glm::vec3(0);
-    float     distance       = std::numeric_limits<float>::max();
-    int       triangle_index = -1;
-
-    explicit operator bool() const noexcept { return triangle_index != -1; }
-};
-
-
-[[gnu::const]] inline
-glm::mat3 RotationMatrixX(const float radians)
-{
-    return glm::mat3(
-            glm::vec3(1,      0,           0     ),
-            glm::vec3(0,  cos(radians), -sin(radians)),
-            glm::vec3(0,  sin(radians),  cos(radians))
-    );
-}
-
-[[gnu::const]] inline
-glm::mat3 RotationMatrixY(const float radians)
-{
-    return glm::mat3(
-            glm::vec3( cos(radians),  0,  sin(radians)),
-            glm::vec3(    0,          1,       0      ),
-            glm::vec3(-sin(radians),  0,  cos(radians))
-    );
-}
-
-[[gnu::const]] inline
-glm::mat3 RotationMatrixZ(const float radians)
-{
-    return glm::mat3(
-            glm::vec3(cos(radians), -sin(radians),  0),
-            glm::vec3(sin(radians),  cos(radians),  0),
-            glm::vec3(      0,            0,        1)
-    );
-}
-
-
-glm::vec3 DirectLight(const glm::vec3& point, const glm::vec3& normal, const glm::vec3& color, const Light& light)
-{
-    using namespace glm;
-
-    const vec3  point_to_light = light.position - point;
-    const vec3  direction_to_light = normalize(point_to_light);
-    const float radius = length(point_to_light);
-
-    const float factor = max(dot(direction_to_light, normal), 0.0f);
-
-    const vec3 result = (color * light.color * factor) / (4.0f * PI * radius * radius);
-
-    return result;
-}
-
-
-Intersection ClosestIntersection(const glm::vec3& start, const glm::vec3& direction, const std::vector<Triangle>& triangles)
-{
-    Intersection closest_intersection;
-
-    for (int i = 0; i < triangles.size(); ++i)
-    {
-        const Triangle triangle = triangles[i];
-
-        const glm::vec3 v0 = triangle.v0;
-        const glm::vec3 v1 = triangle.v1;
-        const glm::vec3 v2 = triangle.v2;
-
-        const glm::vec3 e1 = v1 - v0;
-        const glm::vec3 e2 = v2 - v0;
-
-        const glm::vec3 b = start - v0;
-        const glm::mat3 A ( -direction, e1, e2 );
-
-        const glm::vec3 x = glm::inverse( A ) * b;
-
-        const float t = x[0];
-        const float u = x[1];
-        const float v = x[2];
-
-        // CLARIFY! u and v should be able to be 0, right?
-        if (0 <= u and 0 <= v and (u + v) <= 1 and 0 <= t and t < closest_intersection.distance)
-            closest_intersection = {start + t * direction, t, i};
-    }
-
-    return closest_intersection;
-};
-
-
-Array2D<Uint32> Draw(
-        const Camera& camera, const Light& light,
-        const int width, const int height,
-        const float focal, const std::vector<Triangle>& triangles,
-        const Uint32 background_color = ColorCode(GREY)
-)
-{
-    using namespace glm;
-
-    Array2D<Uint32> framebuffer(height, width);
-
-    for (int row = 0; row < height; ++row)
-    {
-        for (int column = 0; column < width; ++column)
-        {
-            const vec3 direction = camera.cached_rotation_matrix * vec3(column - (width/2.0f), row - (height/2.0f), -focal);
-
-            // Primary ray.
-            const Intersection intersection = ClosestIntersection(camera.position, direction, triangles);
-            if (!intersection)
-            {
-                framebuffer(row, column) = background_color;
-                continue;
-            }
-
-            // Shadow ray.
-            const vec3 intersection_to_light = light.position - intersection.position;
-            const vec3 direction_to_light    = normalize(intersection_to_light);
-            // Move a short distance away so it doesn't collide with itself.
-            const vec3 start_position        = intersection.position + direction_to_light * 0.001f;
-
-            const Intersection blocking_intersection = ClosestIntersection(start_position, intersection_to_light, triangles);
-
-            const Triangle triangle = triangles[intersection.triangle_index];
-
-            const float factor  = max(dot(direction_to_light, triangle.normal), 0.0f);
-            const vec3  diffuse = triangle.color * light.ambient * factor;
-
-            // If there is an object before we reach the light, don't calculate light.
-            if (blocking_intersection.distance < length(intersection_to_light))
-            {
-                framebuffer(row, column) = ColorCode(diffuse);
-            }
-            else
-            {
-                const vec3 specular = DirectLight(intersection.position, triangle.normal, triangle.color, light);
-                const vec3 color = clamp(diffuse + specular, vec3(0), vec3(1));
-                framebuffer(row, column) = ColorCode(color);
-            }
-        }
-    }
-
-    return framebuffer;
-}
-
 bool UpdateCamera(Camera& camera, const Uint8* key_state, const float delta)
 {
     const float camera_movement_speed = 5.0f * delta;
@@ -196,12 +35,8 @@ bool UpdateCamera(Camera& camera, const Uint8* key_state, const float delta)
 
     if (updated)
     {
-        const glm::mat3 rotation = RotationMatrixY(camera.yaw);
-        camera.right   =  glm::vec3(rotation[0][0], rotation[0][1], rotation[0][2]);
-        camera.up      = -glm::vec3(rotation[1][0], rotation[1][1], rotation[1][2]);
-        camera.forward = -glm::vec3(rotation[2][0], rotation[2][1], rotation[2][2]);
-
-        camera.cached_rotation_matrix = rotation;
+        SetYaw(camera, camera.yaw);
+        camera.version += 1;
     }
 
     return updated;
@@ -224,7 +59,10 @@ bool UpdateLight(Light& light, const Uint8* key_state, const float delta)
 }
 
 
-int main()
+// Usage: Lab2 [thread count]
+// Besides moving around: M switches to progressive path tracing and back, K between single rays and packets, and
+// T prints how the threads shared the work.
+int main(int argc, char* argv[])
 {
     constexpr int width  = 300;
     constexpr int height = 300;
@@ -234,8 +72,7 @@ int main()
     InitializeSDL2();
 
     Window window = CreateWindow("Lab2", width, height);
-    Array2D<Uint32> framebuffer(height, width);
-    
+
     Camera camera;
     Clock  clock;
     Light  light;
@@ -244,10 +81,20 @@ int main()
     camera.position = glm::vec3(0.0f, 0.0f, 2.0f);
 
     const std::vector<Triangle> model = LoadTestModel();
+    const BVH bvh = BuildBVH(model);
+    const std::vector<ShadingRecord> shading = ShadingTable(model);
+
+    const unsigned thread_count = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : std::thread::hardware_concurrency();
+    ThreadPool pool(thread_count);
 
     bool running = true;
     unsigned frame = 0;
     bool needs_update = true;
+    bool report_threads = false;
+    TraceMode trace_mode = TraceMode::PACKETS;
+    PrimaryHits primary_hits(width, height);
+    bool path_tracing = false;
+    Accumulation accumulation(width, height);
 
     while (running)
     {
@@ -265,6 +112,20 @@ int main()
                     Clear(window, WHITE);
                 if (event.key.keysym.sym == SDLK_p)
                     ScreenShot(window);
+                if (event.key.keysym.sym == SDLK_t)
+                    report_threads = not report_threads;
+                if (event.key.keysym.sym == SDLK_m)
+                {
+                    path_tracing = not path_tracing;
+                    accumulation.valid = false;
+                    needs_update = true;
+                }
+                if (event.key.keysym.sym == SDLK_k)
+                {
+                    trace_mode = trace_mode == TraceMode::PACKETS ? TraceMode::SINGLE : TraceMode::PACKETS;
+                    primary_hits.valid = false;
+                    needs_update = true;
+                }
             }
         }
 
@@ -284,12 +145,30 @@ int main()
 
         // --- RENDER ----
         printf(
-            "Frame: %i | Position (%f, %f, %f) | Y-Rotation %f | Light (%f, %f, %f) | Delta %f\n",
+            "Frame: %i | Position (%f, %f, %f) | Y-Rotation %f | Light (%f, %f, %f) | Delta %f | Primary rays %s\n",
             ++frame, camera.position.x, camera.position.y, camera.position.z, camera.yaw,
-            light.position.x, light.position.y, light.position.z, delta_time
+            light.position.x, light.position.y, light.position.z, delta_time,
+            IsCurrent(primary_hits, camera) ? "cached" : "traced"
         );
-        Array2D<Uint32> colors = Draw(camera, light, width, height, focal_length, model);
-        FillWindow(window, colors.data);
+        ResetStatistics(pool);
+        // Into the window's own buffer rather than the texture, so screenshots keep working.
+        if (path_tracing)
+        {
+            DrawPathTraced(camera, light, focal_length, shading, bvh, pool, accumulation, ScreenView(window));
+            printf(
+                "Path tracing: %u samples | %.2f M samples/s | Error %.4f | Converged after %.3f s\n",
+                accumulation.samples, SamplesPerSecond(accumulation) / 1e6, accumulation.error, accumulation.converged_seconds
+            );
+
+            // Keep adding samples while nothing moves.
+            needs_update = true;
+        }
+        else
+        {
+            Draw(camera, light, focal_length, shading, bvh, pool, primary_hits, ScreenView(window), trace_mode);
+        }
+        if (report_threads)
+            PrintStatistics(pool, "tiles");
         Render(window);
 
     }
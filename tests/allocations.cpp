@@ -0,0 +1,214 @@
+#include "allocations.h"
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "utilities.h"
+#include "camera.h"
+#include "light.h"
+#include "lab2.h"
+#include "lab3.h"
+#include "binning.h"
+#include "pipeline.h"
+
+
+// Across the front of the box, as paths/cornell.path pans, then into it: the triangles on screen keep changing, and
+// cover more tiles every frame.
+Camera WalkingCamera(const unsigned frame)
+{
+    const f32 pan  = std::min(frame, 8u) / 8.0f;
+    const f32 walk = frame > 8 ? (frame - 8) / 4.0f : 0.0f;
+
+    Camera camera;
+    camera.position = glm::vec3(-0.4f + 0.8f * pan, 0.0f, 2.5f - 1.5f * walk);
+    SetYaw(camera, -0.15f + 0.3f * pan);
+    return camera;
+}
+
+
+Test(CountsAllocations)
+{
+    const uint64_t before = AllocationCount();
+    {
+        std::vector<int> numbers(100, 1);
+        Array2D<float> array(4, 4, 2.0f);
+
+        // Used, so the compiler can't drop the allocations.
+        volatile float sink = numbers[99] + array(3u, 3u);
+        Check(sink, ==, 3.0f);
+    }
+    Check(AllocationCount() - before, ==, 2);
+}
+
+Test(Lab2DrawsWithoutAllocating)
+{
+    constexpr int width  = 64;
+    constexpr int height = 64;
+
+    const std::vector<Triangle> model = LoadTestModel();
+    const BVH bvh = BuildBVH(model);
+    const std::vector<ShadingRecord> shading = ShadingTable(model);
+
+    for (const TraceMode mode : { TraceMode::SINGLE, TraceMode::PACKETS })
+    {
+        ThreadPool  pool(3);
+        PrimaryHits hits(width, height);
+        Array2D<Uint32> image(height, width);
+
+        Camera camera;
+        Light  light;
+        camera.position = glm::vec3(0.0f, 0.0f, 2.0f);
+        light.position  = glm::vec3(0.0f, 0.0f, 1.0f);
+
+        // Warm up.
+        Draw(camera, light, width / 2.0f, shading, bvh, pool, hits, View(image), mode);
+
+        const uint64_t before = AllocationCount();
+        for (unsigned frame = 0; frame < 4; ++frame)
+        {
+            // Alternate between moving the light (cached primary hits) and the camera (traced).
+            if (frame % 2 == 0)
+                light.position.x += 0.1f;
+            else
+            {
+                camera.position.x += 0.1f;
+                camera.version += 1;
+            }
+            Draw(camera, light, width / 2.0f, shading, bvh, pool, hits, View(image), mode);
+        }
+        Check(AllocationCount() - before, ==, 0);
+    }
+}
+
+Test(Lab2DrawsIntoViews)
+{
+    constexpr int width  = 32;
+    constexpr int height = 32;
+
+    const std::vector<Triangle> model = LoadTestModel();
+    const BVH bvh = BuildBVH(model);
+    const std::vector<ShadingRecord> shading = ShadingTable(model);
+
+    ThreadPool  pool(2);
+    PrimaryHits hits(width, height);
+
+    Camera camera;
+    Light  light;
+    camera.position = glm::vec3(0.0f, 0.0f, 2.0f);
+    light.position  = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    Array2D<Uint32> image(height, width);
+    Draw(camera, light, width / 2.0f, shading, bvh, pool, hits, View(image));
+
+    // The same image into the middle of a wider buffer, as from a locked texture with padded rows.
+    constexpr unsigned stride = width + 7;
+    Array2D<Uint32> padded(height, stride, 0xDEADBEEFu);
+    const Array2DView<Uint32> view { padded.data, height, width, stride };
+    hits.valid = false;
+    Draw(camera, light, width / 2.0f, shading, bvh, pool, hits, view);
+
+    unsigned mismatches = 0;
+    unsigned padding_written = 0;
+    for (unsigned y = 0; y < height; ++y)
+    {
+        for (unsigned x = 0; x < width; ++x)
+            mismatches += padded(y, x) != image(y, x);
+        for (unsigned x = width; x < stride; ++x)
+            padding_written += padded(y, x) != 0xDEADBEEFu;
+    }
+    Check(mismatches, ==, 0);
+    Check(padding_written, ==, 0);
+}
+
+Test(Lab3DrawsIntoViews)
+{
+    constexpr int width  = 48;
+    constexpr int height = 48;
+
+    const std::vector<Triangle> model = LoadTestModel();
+    const Viewport viewport {0, 0, width, height};
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    VertexBuffer vertices;
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width, 0xDEADBEEFu);
+    Draw(camera, viewport, IndexedMesh(model), vertices, z_buffer, View(image));
+
+    unsigned untouched = 0;
+    for (unsigned i = 0; i < image.rows * image.columns; ++i)
+        untouched += image.data[i] == 0xDEADBEEFu;
+    Check(untouched, ==, 0);
+}
+
+Test(Lab3DrawsWithoutAllocating)
+{
+    constexpr int width  = 64;
+    constexpr int height = 64;
+
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+    const Viewport viewport {0, 0, width, height};
+
+    ThreadPool pool(3);
+    TileBins   bins;
+    Array2D<f32> z_buffer(height, width);
+    Array2D<u32> image(height, width);
+
+    // Warm up along the walk, which grows the bins to the busiest view.
+    for (unsigned frame = 0; frame <= 12; ++frame)
+        DrawBinned(WalkingCamera(frame), viewport, mesh, pool, bins, z_buffer, View(image));
+
+    // Then back, every view binning the triangles to other tiles than the last.
+    const uint64_t before = AllocationCount();
+    for (unsigned frame = 12; frame-- > 0; )
+        DrawBinned(WalkingCamera(frame), viewport, mesh, pool, bins, z_buffer, View(image));
+    Check(AllocationCount() - before, ==, 0);
+}
+
+Test(Lab3PipelinesWithoutAllocating)
+{
+    constexpr int width  = 64;
+    constexpr int height = 64;
+
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+    const Viewport viewport {0, 0, width, height};
+
+    ThreadPool    pool(3);
+    FramePipeline pipeline(mesh, viewport, 3);
+    Array2D<f32>  z_buffer(height, width);
+    Array2D<u32>  image(height, width);
+
+    Light light;
+
+    const auto draw_bins = [&](const Camera& frame_camera, const Light&, TileBins& bins)
+    {
+        DrawBins(frame_camera, viewport, pool, bins, z_buffer, View(image));
+    };
+
+    // Warm up every slot along the walk, which grows its bins to the busiest view. Twice, a frame apart, so every slot
+    // bins every view, and every frame drawn before counting.
+    BeginFrame(pipeline, WalkingCamera(0), light);
+    for (unsigned frame = 1; frame <= 2 * 13; ++frame)
+    {
+        BeginFrame(pipeline, WalkingCamera(frame % 13), light);
+        DrawFrame(pipeline, draw_bins);
+    }
+    DrawFrame(pipeline, draw_bins);
+
+    // Then along it again, every view binning the triangles to other tiles than the last.
+    const uint64_t before = AllocationCount();
+    BeginFrame(pipeline, WalkingCamera(0), light);
+    for (unsigned frame = 1; frame <= 12; ++frame)
+    {
+        BeginFrame(pipeline, WalkingCamera(frame), light);
+        DrawFrame(pipeline, draw_bins);
+    }
+    DrawFrame(pipeline, draw_bins);
+    Check(AllocationCount() - before, ==, 0);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
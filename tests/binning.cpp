@@ -0,0 +1,215 @@
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "binning.h"
+#include "TestViews.h"
+
+
+// Pixels where the binned rasterizer on 'thread_count' threads doesn't give exactly what Draw does.
+unsigned Mismatches(
+        const Camera& camera, const std::vector<Triangle>& model, const int width, const int height, const unsigned thread_count,
+        const bool depth_prepass = false
+)
+{
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    VertexBuffer vertices;
+    Array2D<f32> serial_depth(height, width);
+    Array2D<u32> serial_image(height, width);
+    Draw(camera, viewport, mesh, vertices, serial_depth, View(serial_image));
+
+    ThreadPool pool(thread_count);
+    TileBins bins;
+    bins.depth_prepass = depth_prepass;
+    Array2D<f32> binned_depth(height, width);
+    Array2D<u32> binned_image(height, width);
+
+    // Twice, so the second frame runs on bins left over from the first.
+    DrawBinned(camera, viewport, mesh, pool, bins, binned_depth, View(binned_image));
+    DrawBinned(camera, viewport, mesh, pool, bins, binned_depth, View(binned_image));
+
+    unsigned mismatches = 0;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            mismatches += serial_image(y, x) != binned_image(y, x) or
+                          std::memcmp(&serial_depth(y, x), &binned_depth(y, x), sizeof(f32)) != 0;
+
+    return mismatches;
+}
+
+
+Test(CornellBoxMatchesSerial)
+{
+    const std::vector<Triangle> model = LoadTestModel();
+
+    Camera camera;
+    for (const float x : { 0.0f, -0.4f, 0.7f })
+    {
+        camera.position = glm::vec3(x, 0.1f, 3.0f);
+        SetYaw(camera, x / 2);
+
+        for (const unsigned thread_count : { 1u, 3u, 8u })
+        {
+            Check(Mismatches(camera, model, 400, 400, thread_count), ==, 0);
+            Check(Mismatches(camera, model, 400, 400, thread_count, true), ==, 0);
+        }
+    }
+
+    Check(Mismatches(InsideCamera(), model, 400, 400, 3), ==, 0);
+    Check(Mismatches(InsideCamera(), model, 400, 400, 3, true), ==, 0);
+}
+
+Test(OddSizesMatchSerial)
+{
+    const std::vector<Triangle> model = LoadTestModel();
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    // Partial tiles along the right and bottom edges.
+    Check(Mismatches(camera, model, 97, 97, 4), ==, 0);
+    Check(Mismatches(camera, model, 33, 33, 2), ==, 0);
+}
+
+Test(RandomModelMatchesSerial)
+{
+    const std::vector<Triangle> model = LoadRandomModel(3000, 5);
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    Check(Mismatches(camera, model, 200, 200, 4), ==, 0);
+    Check(Mismatches(camera, model, 200, 200, 4, true), ==, 0);
+}
+
+Test(CullsLikeSerial)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+    const Viewport viewport {0, 0, 64, 64};
+
+    VertexBuffer vertices;
+    Array2D<f32> z_buffer(64, 64);
+    Array2D<u32> image(64, 64);
+    ThreadPool pool(3);
+    TileBins bins;
+
+    Camera camera;
+    camera.position = glm::vec3(0.3f, 0.0f, 0.5f);
+    SetYaw(camera, 0.7f);
+
+    const CullingStats serial = Draw(camera, viewport, mesh, vertices, z_buffer, View(image));
+    DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    const CullingStats binned = Culling(bins);
+
+    Check(binned.submitted,       ==, serial.submitted);
+    Check(binned.back_facing,     ==, serial.back_facing);
+    Check(binned.outside_frustum, ==, serial.outside_frustum);
+    Check(binned.clipped,         ==, serial.clipped);
+    Check(Culled(binned), >, 0);
+    Check(binned.clipped, >, 0);
+}
+
+Test(HierarchicalZCullsHiddenTriangles)
+{
+    // A wall over the whole view in front of a cloud of triangles, drawn first.
+    using glm::vec3;
+    const vec3 a (-4.0f, -4.0f, 1.5f), b (4.0f, -4.0f, 1.5f), c (4.0f, 4.0f, 1.5f), d (-4.0f, 4.0f, 1.5f);
+    const vec3 white (1.0f);
+
+    std::vector<Triangle> model = { Triangle(a, b, c, white), Triangle(a, c, d, white) };
+    for (const Triangle& triangle : LoadRandomModel(2000, 7))
+        model.push_back(triangle);
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    constexpr int width  = 128;
+    constexpr int height = 128;
+    const Viewport viewport {0, 0, width, height};
+    const Mesh mesh = IndexedMesh(model);
+
+    VertexBuffer vertices;
+    Array2D<f32> serial_depth(height, width);
+    Array2D<u32> serial_image(height, width);
+    Draw(camera, viewport, mesh, vertices, serial_depth, View(serial_image));
+
+    ThreadPool pool(2);
+    TileBins bins;
+    Array2D<f32> binned_depth(height, width);
+    Array2D<u32> binned_image(height, width);
+    DrawBinned(camera, viewport, mesh, pool, bins, binned_depth, View(binned_image));
+
+    unsigned mismatches = 0;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            mismatches += serial_image(y, x) != binned_image(y, x);
+    Check(mismatches, ==, 0);
+
+    // Everything but the wall is behind it, in every tile. A few slivers are tested with the depth their plane has at a
+    // corner of their bounding box, far from the triangle, and aren't culled.
+    const OcclusionStats stats = Occlusion(bins);
+    Check(stats.triangles_culled, >=, (stats.triangles - 2 * TileCount(bins)) * 99 / 100);
+    Check(stats.pixels_culled, >, 0);
+
+    bins.hierarchical_z = false;
+    DrawBinned(camera, viewport, mesh, pool, bins, binned_depth, View(binned_image));
+    Check(Occlusion(bins).triangles, ==, 0);
+}
+
+Test(DepthPrepassShadesEveryPixelOnce)
+{
+    // Walls over the whole view drawn back to front, then a cloud of triangles, some in front of the last one.
+    using glm::vec3;
+    std::vector<Triangle> model;
+    for (const float z : { -1.0f, -0.5f, 0.0f, 0.5f })
+    {
+        const vec3 a (-4.0f, -4.0f, z), b (4.0f, -4.0f, z), c (4.0f, 4.0f, z), d (-4.0f, 4.0f, z);
+        model.push_back(Triangle(a, b, c, vec3(0.5f)));
+        model.push_back(Triangle(a, c, d, vec3(0.5f)));
+    }
+    for (const Triangle& triangle : LoadRandomModel(2000, 7))
+        model.push_back(triangle);
+
+    const Mesh mesh = IndexedMesh(model);
+
+    constexpr int size = 128;
+    const Viewport viewport {0, 0, size, size};
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    ThreadPool pool(3);
+    TileBins bins;
+    Light light;
+    GBuffer gbuffer;
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> image(size, size);
+
+    DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    const ShadingStats forward = Shading(bins);
+
+    bins.depth_prepass = true;
+    DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(image));
+    const ShadingStats prepass = Shading(bins);
+
+    DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, View(image));
+    const ShadingStats deferred = Shading(bins);
+
+    u64 covered = 0;
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            covered += z_buffer(y, x) != FarDepth(camera);
+
+    Check(covered,         ==, static_cast<u64>(size * size));
+    Check(forward.pixels,  ==, covered);
+    Check(prepass.shaded,  ==, covered);
+    Check(deferred.shaded, ==, covered);
+    Check(forward.shaded,  >=, 4 * covered);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,147 @@
+#include <random>
+
+#include "test.h"
+#include "TestModel.h"
+#include "bvh.h"
+
+
+Test(EveryTriangleInOneLeaf)
+{
+    const std::vector<Triangle> model = LoadRandomModel(5000, 1);
+    const BVH bvh = BuildBVH(model);
+
+    std::vector<int> references(model.size(), 0);
+
+    unsigned leaves = 0;
+    for (const BVHNode& node : bvh.nodes)
+    {
+        if (node.count == 0)
+            continue;
+
+        leaves += 1;
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            references[bvh.indices[i]] += 1;
+    }
+
+    unsigned referenced_once = 0;
+    for (const int count : references)
+        referenced_once += count == 1;
+
+    Check(referenced_once, ==, model.size());
+    Check(bvh.nodes.size(), ==, 2 * leaves - 1);
+}
+
+Test(ChildrenInsideParent)
+{
+    const std::vector<Triangle> model = LoadRandomModel(5000, 2);
+    const BVH bvh = BuildBVH(model);
+
+    unsigned outside = 0;
+    for (uint32_t i = 0; i < bvh.nodes.size(); ++i)
+    {
+        const BVHNode& node = bvh.nodes[i];
+        if (node.count > 0)
+            continue;
+
+        for (const uint32_t child : { i + 1, node.offset })
+        {
+            const Bounds& bounds = bvh.nodes[child].bounds;
+            outside += glm::any(glm::lessThan(bounds.min, node.bounds.min)) or glm::any(glm::greaterThan(bounds.max, node.bounds.max));
+        }
+    }
+
+    Check(outside, ==, 0);
+}
+
+Test(MatchesLinearScan)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const std::vector<Triangle>       model   = LoadRandomModel(2000, 3);
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(model);
+    const BVH bvh = BuildBVH(model);
+
+    std::mt19937 generator(4);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    TraversalStatistics statistics;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const glm::vec3 start     (unit(generator) * 2, unit(generator) * 2, unit(generator) * 2);
+        const glm::vec3 direction (unit(generator),     unit(generator),     unit(generator));
+
+        const Intersection linear       = ClosestIntersection(start, direction, records);
+        const Intersection hierarchical = ClosestIntersection(start, direction, bvh, &statistics);
+
+        Check(hierarchical.triangle_index, ==, linear.triangle_index);
+        Check(hierarchical.distance,       ==, linear.distance);
+    }
+
+    Check(statistics.rays, ==, 2000);
+    Check(statistics.triangle_tests, <, 2000 * model.size() / 10);
+}
+
+Test(CornellBox)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const std::vector<Triangle>       model   = LoadTestModel();
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(model);
+    const BVH bvh = BuildBVH(model);
+
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+
+    for (int row = 0; row < 100; ++row)
+    {
+        for (int column = 0; column < 100; ++column)
+        {
+            const glm::vec3 direction (column - 49.5f, row - 49.5f, -50.0f);
+
+            const Intersection linear       = ClosestIntersection(origin, direction, records);
+            const Intersection hierarchical = ClosestIntersection(origin, direction, bvh);
+
+            // Includes the rays into the corners, which hit two walls at the same distance.
+            Check(hierarchical.triangle_index, ==, linear.triangle_index);
+            Check(hierarchical.distance,       ==, linear.distance);
+        }
+    }
+}
+
+Test(OccludedMatchesClosestIntersection)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const std::vector<Triangle>       model   = LoadRandomModel(2000, 5);
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(model);
+    const BVH bvh = BuildBVH(model);
+
+    std::mt19937 generator(6);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    unsigned occluded = 0;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const glm::vec3 start     (unit(generator), unit(generator), unit(generator));
+        const glm::vec3 direction (unit(generator), unit(generator), unit(generator));
+        const float     t_max = unit(generator) + 1.0f;
+
+        const bool expected = ClosestIntersection(start, direction, records).distance < t_max;
+
+        Check(Occluded(start, direction, t_max, records), ==, expected);
+        Check(Occluded(start, direction, t_max, bvh),     ==, expected);
+
+        occluded += expected;
+    }
+
+    // Make sure both outcomes were actually tested.
+    Check(occluded, >, 0);
+    Check(occluded, <, 2000);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
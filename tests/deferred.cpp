@@ -0,0 +1,156 @@
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "binning.h"
+#include "TestViews.h"
+
+
+Camera CornerCamera()
+{
+    Camera camera;
+    camera.position = glm::vec3(-0.3f, 0.1f, 2.5f);
+    SetYaw(camera, -0.2f);
+    return camera;
+}
+
+
+Test(GBufferHoldsTheFrontTriangle)
+{
+    // Every triangle in its own color, so the forward image says which one is in front.
+    Mesh mesh = IndexedMesh(LoadTestModel());
+    for (u32 triangle = 0; triangle < TriangleCount(mesh); ++triangle)
+        mesh.colors[triangle] = triangle + 1;
+
+    constexpr int size = 96;
+    const Viewport viewport {0, 0, size, size};
+    const Camera camera = CornerCamera();
+    Light light;
+
+    VertexBuffer vertices;
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> forward(size, size);
+    Draw(camera, viewport, mesh, vertices, z_buffer, View(forward));
+
+    ThreadPool pool(2);
+    GBuffer gbuffer;
+    Array2D<u32> deferred(size, size);
+    DrawDeferred(camera, light, viewport, mesh, vertices, gbuffer, pool, View(deferred));
+
+    unsigned wrong_triangles = 0;
+    unsigned wrong_depths    = 0;
+    unsigned drawn           = 0;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            const u32 triangle = gbuffer.triangles(y, x);
+            wrong_triangles += (triangle == GBuffer::NO_TRIANGLE ? 0u : triangle + 1) != forward(y, x);
+            wrong_depths    += std::memcmp(&gbuffer.depths(y, x), &z_buffer(y, x), sizeof(f32)) != 0;
+            drawn           += triangle != GBuffer::NO_TRIANGLE;
+        }
+    }
+    Check(wrong_triangles, ==, 0);
+    Check(wrong_depths,    ==, 0);
+    Check(drawn, >, size * size / 2);
+}
+
+Test(BarycentricsGiveTheSurface)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 64;
+    const Viewport viewport {0, 0, size, size};
+    Light light;
+
+    ThreadPool pool(1);
+    VertexBuffer vertices;
+    GBuffer gbuffer;
+    Array2D<u32> image(size, size);
+
+    for (const Camera& camera : { CornerCamera(), InsideCamera() })
+    {
+        DrawDeferred(camera, light, viewport, mesh, vertices, gbuffer, pool, View(image));
+
+        // The position the barycentric coordinates give is on the triangle's plane, and inside it up to a pixel's worth.
+        unsigned off_plane   = 0;
+        unsigned off_surface = 0;
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                const u32 triangle = gbuffer.triangles(y, x);
+                if (triangle == GBuffer::NO_TRIANGLE)
+                    continue;
+
+                const f32 z  = 1.0f / gbuffer.depths(y, x);
+                const f32 b1 = gbuffer.barycentrics[0](y, x) * z;
+                const f32 b2 = gbuffer.barycentrics[1](y, x) * z;
+                const f32 b0 = 1.0f - b1 - b2;
+
+                const glm::vec3 v0 = Position(mesh, mesh.indices[3 * triangle + 0]);
+                const glm::vec3 v1 = Position(mesh, mesh.indices[3 * triangle + 1]);
+                const glm::vec3 v2 = Position(mesh, mesh.indices[3 * triangle + 2]);
+                const glm::vec3 position = b0 * v0 + b1 * v1 + b2 * v2;
+
+                off_plane   += std::abs(glm::dot(mesh.normals[triangle], position - v0)) > 1e-4f;
+                off_surface += std::min({b0, b1, b2}) < -0.05f or std::max({b0, b1, b2}) > 1.05f;
+            }
+        }
+        Check(off_plane,   ==, 0);
+        Check(off_surface, ==, 0);
+    }
+}
+
+Test(BinnedMatchesSerial)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 100;
+    const Viewport viewport {0, 0, size, size};
+
+    const Light light = TestLight();
+
+    VertexBuffer vertices;
+    GBuffer serial_gbuffer;
+    GBuffer binned_gbuffer;
+    Array2D<u32> serial(size, size);
+    Array2D<u32> binned(size, size);
+    TileBins bins;
+
+    std::vector<Camera> cameras;
+    for (const float x : { 0.0f, -0.4f, 0.7f })
+    {
+        Camera camera;
+        camera.position = glm::vec3(x, 0.1f, 3.0f);
+        SetYaw(camera, x / 2);
+        cameras.push_back(camera);
+    }
+    cameras.push_back(InsideCamera());
+
+    for (const Camera& camera : cameras)
+    {
+        for (const unsigned thread_count : { 1u, 3u })
+        {
+            ThreadPool pool(thread_count);
+            DrawDeferred(camera, light, viewport, mesh, vertices, serial_gbuffer, pool, View(serial));
+
+            for (const bool hierarchical_z : { true, false })
+            {
+                bins.hierarchical_z = hierarchical_z;
+                DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, binned_gbuffer, View(binned));
+
+                unsigned mismatches = 0;
+                for (int y = 0; y < size; ++y)
+                    for (int x = 0; x < size; ++x)
+                        mismatches += serial(y, x) != binned(y, x);
+                Check(mismatches, ==, 0);
+            }
+        }
+    }
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -10,7 +10,7 @@ Test(CollisionError)
     const ivec2 start2 (399, 399);
     const ivec2 stop2  (399, 0);
 
-    const Intersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
+    const LineIntersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
 
     Check(result.type, ==, IntersectionType::INTERSECTION);
 
@@ -26,7 +26,7 @@ Test(Collision)
     const ivec2 start2 (100, 0);
     const ivec2 stop2  (0, 100);
 
-    const Intersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
+    const LineIntersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
 
     Check(result.type, ==, IntersectionType::INTERSECTION);
 
@@ -41,7 +41,7 @@ Test(CollisionEdge)
     const ivec2 start2 (400, 400);
     const ivec2 stop2  (0,   400);
 
-    const Intersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
+    const LineIntersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
 
     Check(result.type, ==, IntersectionType::INTERSECTION);
 
@@ -58,8 +58,8 @@ Test(CollisionEdge2)
     const ivec2 stop2  (399,   0);
     const ivec2 stop3  (0,   399);
 
-    const Intersection<ivec2> result1 = LineLineIntersection(start1, stop1, start2, stop2);
-    const Intersection<ivec2> result2 = LineLineIntersection(start1, stop1, start2, stop3);
+    const LineIntersection<ivec2> result1 = LineLineIntersection(start1, stop1, start2, stop2);
+    const LineIntersection<ivec2> result2 = LineLineIntersection(start1, stop1, start2, stop3);
 
     Check(result1.type, ==, IntersectionType::NON_PARALLEL_NON_INTERSECTION);
     Check(result2.type, ==, IntersectionType::PARALLEL_NON_INTERSECTION);
@@ -72,7 +72,7 @@ Test(Collinear)
     const ivec2 start2 (0, 0);
     const ivec2 stop2  (100, 100);
 
-    const Intersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
+    const LineIntersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
 
     Check(result.type, ==, IntersectionType::COLLINEAR);
 }
@@ -85,7 +85,7 @@ Test(Parallel)
     const ivec2 start2 (10, 0);
     const ivec2 stop2  (10, 100);
 
-    const Intersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
+    const LineIntersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
 
     Check(result.type, ==, IntersectionType::PARALLEL_NON_INTERSECTION);
 }
@@ -97,7 +97,7 @@ Test(NonIntersecting)
     const ivec2 start2 (0,  100);
     const ivec2 stop2  (100, 100);
 
-    const Intersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
+    const LineIntersection<ivec2> result = LineLineIntersection(start1, stop1, start2, stop2);
 
     Check(result.type, ==, IntersectionType::NON_PARALLEL_NON_INTERSECTION);
 }
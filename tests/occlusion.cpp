@@ -0,0 +1,238 @@
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "binning.h"
+#include "TestViews.h"
+
+
+// The 12 triangles of a cube facing outwards.
+void AddCube(std::vector<Triangle>& model, const glm::vec3& centre, const float half, const glm::vec3& color)
+{
+    using glm::vec3;
+    const vec3 x (1, 0, 0), y (0, 1, 0), z (0, 0, 1);
+
+    // Every face's outward normal, and two directions along it with that as their cross product. Each face shares an
+    // edge with the one before it, so the cube is one cluster.
+    const vec3 faces[6][3] = { { x, y, z }, { y, z, x }, { -x, z, y }, { -y, x, z }, { z, x, y }, { -z, y, x } };
+    for (const auto& face : faces)
+    {
+        const vec3 middle = centre + face[0] * half;
+        const vec3 a = middle + (-face[1] - face[2]) * half;
+        const vec3 b = middle + ( face[1] - face[2]) * half;
+        const vec3 c = middle + ( face[1] + face[2]) * half;
+        const vec3 d = middle + (-face[1] + face[2]) * half;
+        model.push_back(Triangle(a, b, c, color));
+        model.push_back(Triangle(a, c, d, color));
+    }
+}
+
+// A wall in front of the camera at (0, 0, 3), and a grid of cubes behind it: the middle ones hidden behind the wall,
+// the rest beside it, and the outermost off screen.
+std::vector<Triangle> WallModel()
+{
+    using glm::vec3;
+    std::vector<Triangle> model;
+
+    const vec3 a (-0.6f, -0.6f, 1.5f), b (0.6f, -0.6f, 1.5f), c (0.6f, 0.6f, 1.5f), d (-0.6f, 0.6f, 1.5f);
+    model.push_back(Triangle(a, b, c, vec3(0.75f)));
+    model.push_back(Triangle(a, c, d, vec3(0.75f)));
+
+    for (int row = -3; row <= 3; ++row)
+        for (int column = -3; column <= 3; ++column)
+            AddCube(model, vec3(0.8f * column, 0.8f * row, -1.0f), 0.15f, vec3(0.2f + 0.1f * (row + 3), 0.3f, 0.2f + 0.1f * (column + 3)));
+
+    return model;
+}
+
+
+Test(ClustersFollowTheObjects)
+{
+    // The room, then the two blocks.
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+    Check(mesh.clusters.size(), ==, 3);
+
+    u32 next = 0;
+    unsigned outside = 0;
+    for (const Cluster& cluster : mesh.clusters)
+    {
+        Check(cluster.first_triangle, ==, next);
+        next = cluster.last_triangle;
+
+        for (u32 triangle = cluster.first_triangle; triangle < cluster.last_triangle; ++triangle)
+        {
+            for (u32 i = 0; i < 3; ++i)
+            {
+                const u32 vertex = mesh.indices[3 * triangle + i];
+                const glm::vec3 position = Position(mesh, vertex);
+                outside += vertex < cluster.first_vertex or vertex >= cluster.last_vertex or
+                           glm::any(glm::lessThan(position, cluster.min)) or glm::any(glm::greaterThan(position, cluster.max));
+            }
+        }
+    }
+    Check(next,    ==, TriangleCount(mesh));
+    Check(outside, ==, 0);
+
+    // Every cube of its own, after the wall.
+    Check(IndexedMesh(WallModel()).clusters.size(), ==, 1 + 7 * 7);
+}
+
+Test(OccludersOnlyCoverWhatTheyDraw)
+{
+    constexpr int size = 96;
+    const Viewport viewport {0, 0, size, size};
+
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<i32> position (-20 * SUBPIXEL_STEPS, (size + 20) * SUBPIXEL_STEPS);
+    std::uniform_real_distribution<f32> depth (1.5f, 20.0f);
+
+    OcclusionBuffer buffer;
+    Resize(buffer, viewport);
+    Array2D<f32> z_buffer(size, size);
+
+    unsigned covered_cells = 0;
+    unsigned wrong_cells   = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        RasterVertex p0 { position(generator), position(generator), depth(generator) };
+        RasterVertex p1 { position(generator), position(generator), depth(generator) };
+        RasterVertex p2 { position(generator), position(generator), depth(generator) };
+        if (EdgeFunction(p0, p1, p2.x, p2.y) > 0)
+            std::swap(p1, p2);
+
+        Fill(buffer.depths, 0.0f);
+        Fill(z_buffer, 0.0f);
+        DrawOccluder(buffer, viewport, p0, p1, p2);
+        Rasterize(viewport, p0, p1, p2, [&](const i32 x, const i32 y, const f32 depth) { z_buffer(y, x) = depth; });
+
+        // Every pixel of a covered cell is drawn, and no farther than the cell says.
+        for (i32 row = 0; row < size / OcclusionBuffer::CELL_SIZE; ++row)
+        {
+            for (i32 column = 0; column < size / OcclusionBuffer::CELL_SIZE; ++column)
+            {
+                const f32 cell = buffer.depths(row, column);
+                if (cell == 0.0f)
+                    continue;
+
+                bool wrong = false;
+                for (i32 y = row * OcclusionBuffer::CELL_SIZE; y < (row + 1) * OcclusionBuffer::CELL_SIZE; ++y)
+                    for (i32 x = column * OcclusionBuffer::CELL_SIZE; x < (column + 1) * OcclusionBuffer::CELL_SIZE; ++x)
+                        wrong |= z_buffer(y, x) == 0.0f or z_buffer(y, x) < cell;
+
+                wrong_cells   += wrong;
+                covered_cells += 1;
+            }
+        }
+    }
+    Check(wrong_cells,   ==, 0);
+    Check(covered_cells, >,  1000);
+}
+
+Test(CullsClustersBehindAWall)
+{
+    const std::vector<Triangle> model = WallModel();
+    const Mesh mesh = IndexedMesh(model);
+
+    constexpr int size = 128;
+    const Viewport viewport {0, 0, size, size};
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    VertexBuffer vertices;
+    Array2D<f32> serial_depth(size, size);
+    Array2D<u32> serial_image(size, size);
+    const CullingStats serial = Draw(camera, viewport, mesh, vertices, serial_depth, View(serial_image));
+
+    ThreadPool pool(3);
+    TileBins bins;
+    bins.occlusion_culling = true;
+    Array2D<f32> binned_depth(size, size);
+    Array2D<u32> binned_image(size, size);
+
+    for (const bool depth_prepass : { false, true })
+    {
+        bins.depth_prepass = depth_prepass;
+        DrawBinned(camera, viewport, mesh, pool, bins, binned_depth, View(binned_image));
+
+        unsigned mismatches = 0;
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                mismatches += serial_image(y, x) != binned_image(y, x) or
+                              std::memcmp(&serial_depth(y, x), &binned_depth(y, x), sizeof(f32)) != 0;
+        Check(mismatches, ==, 0);
+    }
+
+    // At least the 3 x 3 cubes behind the wall, and not the ones beside it.
+    Check(bins.cluster_culling.clusters,  ==, mesh.clusters.size());
+    Check(bins.cluster_culling.occluders, ==, 2);
+    Check(bins.cluster_culling.culled,    >=, 9);
+    Check(bins.cluster_culling.culled,    <,  mesh.clusters.size() - 8);
+
+    // What's culled with the clusters is counted with the triangles, and nothing else changes.
+    const CullingStats binned = Culling(bins);
+    Check(binned.submitted, ==, serial.submitted);
+    Check(binned.occluded,  >=, 9 * 12);
+    Check(Culled(binned),   >=, Culled(serial));
+    Check(binned.clipped,   ==, serial.clipped);
+
+    bins.occlusion_culling = false;
+    DrawBinned(camera, viewport, mesh, pool, bins, binned_depth, View(binned_image));
+    Check(Culling(bins).occluded,      ==, 0);
+    Check(bins.cluster_culling.culled, ==, 0);
+}
+
+Test(CornellBoxMatchesWithoutIt)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 100;
+    const Viewport viewport {0, 0, size, size};
+
+    const Light light = TestLight();
+
+    ThreadPool pool(3);
+    TileBins bins;
+    GBuffer gbuffer;
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> without(size, size);
+    Array2D<u32> with(size, size);
+
+    // In front of the box, inside it, and behind the blocks looking out through the front.
+    std::vector<Camera> cameras(3);
+    cameras[0].position = glm::vec3(-0.4f, 0.1f, 3.0f);
+    SetYaw(cameras[0], -0.2f);
+    cameras[1].position = glm::vec3(0.3f, 0.0f, 0.5f);
+    SetYaw(cameras[1], 0.7f);
+    cameras[2].position = glm::vec3(0.0f, 0.2f, -0.9f);
+    SetYaw(cameras[2], PI);
+
+    for (const Camera& camera : cameras)
+    {
+        for (const bool deferred : { false, true })
+        {
+            bins.occlusion_culling = false;
+            if (deferred)
+                DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, View(without));
+            else
+                DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(without));
+
+            bins.occlusion_culling = true;
+            if (deferred)
+                DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, View(with));
+            else
+                DrawBinned(camera, viewport, mesh, pool, bins, z_buffer, View(with));
+
+            unsigned mismatches = 0;
+            for (int y = 0; y < size; ++y)
+                for (int x = 0; x < size; ++x)
+                    mismatches += without(y, x) != with(y, x);
+            Check(mismatches, ==, 0);
+        }
+    }
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,92 @@
+#include <random>
+
+#include "test.h"
+#include "TestModel.h"
+#include "packet.h"
+
+
+// The number of lanes that don't get exactly what the scalar traversal returns for their ray.
+unsigned Mismatches(const glm::vec3& start, const glm::vec3 directions[PACKET_SIZE], const BVH& bvh)
+{
+    Intersection packet[PACKET_SIZE];
+    ClosestIntersection(start, directions, bvh, packet);
+
+    unsigned mismatches = 0;
+    for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+        const Intersection single = ClosestIntersection(start, directions[lane], bvh);
+        mismatches += packet[lane].triangle_index != single.triangle_index or packet[lane].distance != single.distance;
+    }
+
+    return mismatches;
+}
+
+
+Test(CornellBoxPrimaryRays)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const BVH bvh = BuildBVH(LoadTestModel());
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+
+    for (int row = 0; row < 100; row += PACKET_HEIGHT)
+    {
+        for (int column = 0; column < 100; column += PACKET_WIDTH)
+        {
+            glm::vec3 directions[PACKET_SIZE];
+            for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+                directions[lane] = glm::vec3(column + lane % PACKET_WIDTH - 49.5f, row + lane / PACKET_WIDTH - 49.5f, -50.0f);
+
+            Check(Mismatches(origin, directions, bvh), ==, 0);
+        }
+    }
+}
+
+Test(RandomCoherentRays)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const BVH bvh = BuildBVH(LoadRandomModel(2000, 7));
+
+    std::mt19937 generator(8);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        const glm::vec3 start (unit(generator) * 2, unit(generator) * 2, 2.0f);
+
+        // Directions scattered around a common one, all pointing into -z.
+        glm::vec3 directions[PACKET_SIZE];
+        for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+            directions[lane] = glm::vec3(unit(generator) * 0.1f, unit(generator) * 0.1f, -1.0f);
+
+        Check(Mismatches(start, directions, bvh), ==, 0);
+    }
+}
+
+Test(DivergentRaysFallBack)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const BVH bvh = BuildBVH(LoadRandomModel(2000, 9));
+
+    std::mt19937 generator(10);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        const glm::vec3 start (unit(generator), unit(generator), unit(generator));
+
+        glm::vec3 directions[PACKET_SIZE];
+        for (unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+            directions[lane] = glm::vec3(unit(generator), unit(generator), unit(generator));
+
+        Check(Mismatches(start, directions, bvh), ==, 0);
+    }
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,55 @@
+#include <sstream>
+
+#include "test.h"
+#include "path.h"
+
+
+Test(ParsesScenesAndKeys)
+{
+    std::istringstream input(
+        "# A comment.\n"
+        "scene random 500 7\n"
+        "\n"
+        "key 10   1 2 3   0.5   4 5 6   # Out of order.\n"
+        "key 0    0 0 0   0     0 0 0\n"
+    );
+    const Path path = ParsePath(input);
+
+    Check(path.scene,       ==, "random");
+    Check(path.scene_count, ==, 500);
+    Check(path.scene_seed,  ==, 7);
+    Check(path.keys.size(), ==, 2);
+    Check(path.keys[0].frame, ==, 0);
+    Check(path.keys[1].frame, ==, 10);
+    Check(path.keys[1].camera_yaw, ==, 0.5f);
+    Check(path.keys[1].light_position.z, ==, 6.0f);
+    Check(FrameCount(path), ==, 11);
+}
+
+Test(InterpolatesBetweenKeys)
+{
+    std::istringstream input(
+        "key 10   0 0 0   0   0 0 0\n"
+        "key 20   2 4 6   1   8 8 8\n"
+    );
+    const Path path = ParsePath(input);
+
+    const PathKey before  = Sample(path, 0);
+    const PathKey middle  = Sample(path, 15);
+    const PathKey exact   = Sample(path, 20);
+    const PathKey after   = Sample(path, 30);
+
+    Check(before.camera_position.x, ==, 0.0f);
+    Check(middle.camera_position.x, ==, 1.0f);
+    Check(middle.camera_position.z, ==, 3.0f);
+    Check(middle.camera_yaw,        ==, 0.5f);
+    Check(middle.light_position.y,  ==, 4.0f);
+    Check(exact.camera_position.y,  ==, 4.0f);
+    Check(after.light_position.x,   ==, 8.0f);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,148 @@
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "pathtracer.h"
+
+
+Test(UniformNumbers)
+{
+    double sum = 0;
+    unsigned out_of_range = 0;
+    for (uint32_t pixel = 0; pixel < 100; ++pixel)
+    {
+        RandomStream random = PixelStream(pixel, 0);
+        for (unsigned i = 0; i < 100; ++i)
+        {
+            const float number = Uniform(random);
+            out_of_range += number < 0.0f or number >= 1.0f;
+            sum += number;
+        }
+    }
+
+    Check(out_of_range, ==, 0);
+    Check(std::abs(sum / 10000 - 0.5), <, 0.01);
+
+    // Same place, same number.
+    RandomStream a = PixelStream(7, 3);
+    RandomStream b = PixelStream(7, 3);
+    RandomStream c = PixelStream(7, 4);
+    Check(Uniform(a), ==, Uniform(b));
+    Check(Uniform(a), !=, Uniform(c));
+}
+
+Test(DirectionsAreInTheHemisphere)
+{
+    const glm::vec3 normals[] = {
+        glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(1, 0, 0), glm::normalize(glm::vec3(-1, 2, 3))
+    };
+
+    unsigned wrong = 0;
+    for (const glm::vec3& normal : normals)
+    {
+        RandomStream random = PixelStream(0, 0);
+        for (unsigned i = 0; i < 1000; ++i)
+        {
+            const float u = Uniform(random);
+            const float v = Uniform(random);
+            const glm::vec3 direction = CosineWeightedDirection(normal, u, v);
+
+            wrong += std::abs(glm::length(direction) - 1.0f) > 1e-4f or glm::dot(direction, normal) < 0.0f;
+        }
+    }
+
+    Check(wrong, ==, 0);
+}
+
+Test(KeepsTheVarianceOfPixelsThatHardlyVary)
+{
+    // Bright, and a hundredth apart, for many samples: a sum of squares in float would have cancelled the variance out.
+    double mean       = 0;
+    double deviations = 0;
+    constexpr unsigned count = 100000;
+    for (unsigned sample = 0; sample < count; ++sample)
+        AddToMean(mean, deviations, sample + 1, sample % 2 == 0 ? 99.995f : 100.005f);
+
+    const double variance = deviations / (count - 1);
+    Check(std::abs(mean - 100.0), <, 1e-4);
+    Check(std::abs(variance / (0.005 * 0.005) - 1.0), <, 0.01);
+}
+
+Test(SameImageOnAnyThreadCount)
+{
+    constexpr int width  = 40;
+    constexpr int height = 40;
+
+    const std::vector<Triangle> model = LoadTestModel();
+    const BVH bvh = BuildBVH(model);
+    const std::vector<ShadingRecord> shading = ShadingTable(model);
+
+    Camera camera;
+    Light  light;
+    camera.position = glm::vec3(0.0f, 0.0f, 2.0f);
+    light.position  = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    ThreadPool serial(1);
+    Accumulation reference(width, height);
+    for (unsigned frame = 0; frame < 2; ++frame)
+        Accumulate(camera, light, width / 2.0f, shading, bvh, serial, reference, 2);
+
+    for (const unsigned thread_count : { 2u, 3u, 8u })
+    {
+        ThreadPool pool(thread_count);
+        Accumulation accumulation(width, height);
+
+        // Different batches, same samples.
+        Accumulate(camera, light, width / 2.0f, shading, bvh, pool, accumulation, 1);
+        Accumulate(camera, light, width / 2.0f, shading, bvh, pool, accumulation, 3);
+
+        const size_t size = width * height;
+        Check(accumulation.samples, ==, 4);
+        Check(std::memcmp(accumulation.sum.data, reference.sum.data, size * sizeof(glm::vec3)), ==, 0);
+        Check(std::memcmp(accumulation.luminance_means.data, reference.luminance_means.data, size * sizeof(double)), ==, 0);
+        Check(std::memcmp(accumulation.luminance_deviations.data, reference.luminance_deviations.data, size * sizeof(double)), ==, 0);
+        Check(accumulation.error, ==, reference.error);
+    }
+}
+
+Test(ConvergesAndStartsOver)
+{
+    constexpr int width  = 24;
+    constexpr int height = 24;
+
+    const std::vector<Triangle> model = LoadTestModel();
+    const BVH bvh = BuildBVH(model);
+    const std::vector<ShadingRecord> shading = ShadingTable(model);
+
+    Camera camera;
+    Light  light;
+    camera.position = glm::vec3(0.0f, 0.0f, 2.0f);
+    light.position  = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    ThreadPool pool(2);
+    Accumulation accumulation(width, height);
+
+    Accumulate(camera, light, width / 2.0f, shading, bvh, pool, accumulation, 4);
+    const float early_error = accumulation.error;
+    Accumulate(camera, light, width / 2.0f, shading, bvh, pool, accumulation, 60);
+
+    Check(accumulation.samples, ==, 64);
+    Check(accumulation.error, <, early_error / 2);
+    Check(SamplesPerSecond(accumulation), >, 0);
+
+    // Moving the light throws the samples away.
+    light.position.x += 0.1f;
+    Accumulate(camera, light, width / 2.0f, shading, bvh, pool, accumulation, 1);
+    Check(accumulation.samples, ==, 1);
+    Check(accumulation.converged_seconds, <, 0);
+
+    // And so does moving the camera.
+    camera.version += 1;
+    Accumulate(camera, light, width / 2.0f, shading, bvh, pool, accumulation, 2);
+    Check(accumulation.samples, ==, 2);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
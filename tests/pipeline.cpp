@@ -0,0 +1,178 @@
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "binning.h"
+#include "pipeline.h"
+#include "TestViews.h"
+
+
+// Along the front of the box and into it, with the light moving too.
+void TestPath(std::vector<Camera>& cameras, std::vector<Light>& lights)
+{
+    for (unsigned frame = 0; frame < 6; ++frame)
+    {
+        Camera camera;
+        camera.position = glm::vec3(-0.4f + 0.15f * frame, 0.1f, 3.0f - 0.5f * frame);
+        SetYaw(camera, -0.2f + 0.15f * frame);
+        cameras.push_back(camera);
+
+        Light light = TestLight();
+        light.position.y += 0.1f * frame;
+        lights.push_back(light);
+    }
+}
+
+
+Test(MatchesDrawingEveryFrameOnItsOwn)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 100;
+    const Viewport viewport {0, 0, size, size};
+
+    std::vector<Camera> cameras;
+    std::vector<Light>  lights;
+    TestPath(cameras, lights);
+
+    ThreadPool pool(3);
+    TileBins   bins;
+    GBuffer    gbuffer;
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> expected(size, size);
+    Array2D<u32> pipelined(size, size);
+
+    enum class Shading { FLAT, PREPASS, LIT, DEFERRED };
+
+    for (const unsigned geometry_threads : { 1u, 3u })
+    {
+        for (const Shading shading : { Shading::FLAT, Shading::PREPASS, Shading::LIT, Shading::DEFERRED })
+        {
+            FramePipeline pipeline(mesh, viewport, geometry_threads);
+            for (PipelinedFrame& frame : pipeline.frames)
+            {
+                frame.bins.occlusion_culling = true;
+                frame.bins.depth_prepass     = shading == Shading::PREPASS;
+            }
+            bins.occlusion_culling = true;
+            bins.depth_prepass     = shading == Shading::PREPASS;
+
+            const auto draw_bins = [&](const Camera& camera, const Light& light, TileBins& frame_bins)
+            {
+                if (shading == Shading::DEFERRED)
+                    DrawBinsDeferred(camera, light, viewport, mesh, pool, frame_bins, gbuffer, View(pipelined));
+                else if (shading == Shading::LIT)
+                    DrawBinsLit(camera, light, viewport, mesh, pool, frame_bins, z_buffer, View(pipelined));
+                else
+                    DrawBins(camera, viewport, pool, frame_bins, z_buffer, View(pipelined));
+            };
+
+            BeginFrame(pipeline, cameras[0], lights[0]);
+
+            unsigned mismatches = 0;
+            for (size_t frame = 0; frame < cameras.size(); ++frame)
+            {
+                if (frame + 1 < cameras.size())
+                    BeginFrame(pipeline, cameras[frame + 1], lights[frame + 1]);
+
+                DrawFrame(pipeline, draw_bins);
+
+                if (shading == Shading::DEFERRED)
+                    DrawBinnedDeferred(cameras[frame], lights[frame], viewport, mesh, pool, bins, gbuffer, View(expected));
+                else if (shading == Shading::LIT)
+                    DrawBinnedLit(cameras[frame], lights[frame], viewport, mesh, pool, bins, z_buffer, View(expected));
+                else
+                    DrawBinned(cameras[frame], viewport, mesh, pool, bins, z_buffer, View(expected));
+
+                for (int y = 0; y < size; ++y)
+                    for (int x = 0; x < size; ++x)
+                        mismatches += expected(y, x) != pipelined(y, x);
+            }
+            Check(mismatches, ==, 0);
+            Check(pipeline.drawn, ==, cameras.size());
+        }
+    }
+}
+
+Test(DrawsTheFramesInOrder)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 64;
+    const Viewport viewport {0, 0, size, size};
+
+    std::vector<Camera> cameras;
+    std::vector<Light>  lights;
+    TestPath(cameras, lights);
+
+    ThreadPool    pool(2);
+    FramePipeline pipeline(mesh, viewport, 2);
+    Array2D<f32>  z_buffer(size, size);
+    Array2D<u32>  image(size, size);
+
+    const auto draw_bins = [&](const Camera& camera, const Light&, TileBins& bins)
+    {
+        DrawBins(camera, viewport, pool, bins, z_buffer, View(image));
+    };
+
+    // Every frame drawn with the camera and light it began with, and stats of its own.
+    unsigned out_of_order = 0;
+    BeginFrame(pipeline, cameras[0], lights[0]);
+    for (size_t frame = 0; frame < cameras.size(); ++frame)
+    {
+        if (frame + 1 < cameras.size())
+            BeginFrame(pipeline, cameras[frame + 1], lights[frame + 1]);
+
+        const PipelinedFrame& drawn = DrawFrame(pipeline, draw_bins);
+        out_of_order += drawn.camera.position != cameras[frame].position or drawn.light.position != lights[frame].position;
+        out_of_order += Culling(drawn.bins).submitted != TriangleCount(mesh);
+    }
+    Check(out_of_order,    ==, 0);
+    Check(pipeline.begun,  ==, cameras.size());
+    Check(pipeline.binned, ==, cameras.size());
+    Check(pipeline.drawn,  ==, cameras.size());
+}
+
+Test(BinsTheNextFrameWhileDrawing)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 64;
+    const Viewport viewport {0, 0, size, size};
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+    Light light;
+
+    ThreadPool    pool(1);
+    FramePipeline pipeline(mesh, viewport, 1);
+    Array2D<f32>  z_buffer(size, size);
+    Array2D<u32>  image(size, size);
+
+    // Frame 0 is only drawn once the geometry of frame 1 is done, which it can't be if the two stages don't overlap.
+    BeginFrame(pipeline, camera, light);
+    BeginFrame(pipeline, camera, light);
+
+    bool overlapped = false;
+    DrawFrame(pipeline, [&](const Camera& frame_camera, const Light&, TileBins& bins)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            overlapped = pipeline.condition.wait_for(lock, std::chrono::seconds(10), [&]() { return pipeline.binned == 2; });
+        }
+
+        DrawBins(frame_camera, viewport, pool, bins, z_buffer, View(image));
+    });
+    Check(overlapped, ==, true);
+
+    DrawFrame(pipeline, [&](const Camera& frame_camera, const Light&, TileBins& bins)
+    {
+        DrawBins(frame_camera, viewport, pool, bins, z_buffer, View(image));
+    });
+    Check(pipeline.drawn, ==, 2);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
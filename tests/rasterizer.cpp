@@ -0,0 +1,516 @@
+#include <random>
+
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "lab3.h"
+
+
+// Draws 'count' random triangles of up to 'size' pixels, with vertices anywhere between pixel centres, with both
+// rasterizers and returns the number of pixels (depth or color) that differ.
+unsigned BlockMismatches(const Viewport& viewport, const int width, const int height, const int size, const unsigned count, const unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> x      (-size / 2 * SUBPIXEL_STEPS, (width  + size / 2) * SUBPIXEL_STEPS);
+    std::uniform_int_distribution<int> y      (-size / 2 * SUBPIXEL_STEPS, (height + size / 2) * SUBPIXEL_STEPS);
+    std::uniform_int_distribution<int> offset (-size * SUBPIXEL_STEPS, size * SUBPIXEL_STEPS);
+    std::uniform_real_distribution<f32> depth (1.0f, 100.0f);
+
+    Array2D<f32> scalar_depth(height, width, 0.0f);
+    Array2D<u32> scalar_image(height, width, 0u);
+    Array2D<f32> block_depth (height, width, 0.0f);
+    Array2D<u32> block_image (height, width, 0u);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const RasterVertex p0 { x(generator), y(generator), depth(generator) };
+        const RasterVertex p1 { p0.x + offset(generator), p0.y + offset(generator), depth(generator) };
+        const RasterVertex p2 { p0.x + offset(generator), p0.y + offset(generator), depth(generator) };
+
+        Rasterize      (viewport, p0, p1, p2, DepthTestFragment { scalar_depth, View(scalar_image), i + 1 });
+        RasterizeBlocks(viewport, p0, p1, p2, DepthTestFragment { block_depth,  View(block_image),  i + 1 });
+    }
+
+    unsigned mismatches = 0;
+    for (int row = 0; row < height; ++row)
+        for (int column = 0; column < width; ++column)
+            mismatches += scalar_image(row, column) != block_image(row, column) or
+                          std::memcmp(&scalar_depth(row, column), &block_depth(row, column), sizeof(f32)) != 0;
+
+    return mismatches;
+}
+
+
+// Counts the fragments of every pixel, from both the scalar and the SIMD calls of RasterizeBlocks.
+struct CountFragment
+{
+    Array2D<u32>& counts;
+    const Viewport& viewport;
+
+    void operator() (const i32 x, const i32 y, f32) const noexcept
+    {
+        counts(static_cast<unsigned>(y - viewport.top), static_cast<unsigned>(x - viewport.left)) += 1;
+    }
+    void operator() (const i32 x, const i32 y, const SimdFloat&, const SimdFloat& covered) const noexcept
+    {
+        const unsigned bits = MoveMask(covered);
+        for (unsigned lane = 0; lane < SIMD_WIDTH; ++lane)
+            if (bits & (1u << lane))
+                (*this)(x + static_cast<i32>(lane), y, 0.0f);
+    }
+};
+
+
+Test(IncrementalEdgesCoverTheRightPixels)
+{
+    // Both windings of a triangle off the pixel grid, compared with evaluating the edge functions at every pixel
+    // centre. Pixels exactly on the edges get the top-left rule.
+    const RasterVertex a { 51, 32, 10.0f }, b { 640, 152, 10.0f }, c { 200, 536, 10.0f };
+    const Viewport viewport {0, 0, 48, 48};
+
+    for (const bool flipped : { false, true })
+    {
+        const RasterVertex& p1 = flipped ? c : b;
+        const RasterVertex& p2 = flipped ? b : c;
+
+        Array2D<u32> covered(48, 48, 0u);
+        Rasterize(viewport, a, p1, p2, [&](const i32 x, const i32 y, f32) { covered(y, x) += 1; });
+
+        const auto Inside = [](const RasterVertex& v0, const RasterVertex& v1, const i64 x, const i64 y)
+        {
+            const i64 edge = EdgeFunction(v0, v1, x, y);
+            const i64 dx = v1.y - v0.y;
+            const i64 dy = v0.x - v1.x;
+            return edge < 0 or (edge == 0 and (dx < 0 or (dx == 0 and dy < 0)));
+        };
+
+        unsigned wrong = 0;
+        for (int y = 0; y < 48; ++y)
+        {
+            for (int x = 0; x < 48; ++x)
+            {
+                const i64 sample_x = x * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+                const i64 sample_y = y * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+                const bool inside = Inside(p1, p2, sample_x, sample_y) and Inside(p2, a, sample_x, sample_y) and Inside(a, p1, sample_x, sample_y);
+                wrong += covered(y, x) != (inside ? 1u : 0u);
+            }
+        }
+        Check(wrong, ==, 0);
+    }
+}
+
+Test(SharedEdgesAreDrawnOnce)
+{
+    // A square cut into triangles around jittered vertices, some of them exactly on pixel centres, so plenty of
+    // pixel centres fall exactly on shared edges. Every pixel inside gets exactly one fragment, from both rasterizers.
+    constexpr int cells = 6;
+    constexpr int cell  = 9 * SUBPIXEL_STEPS;
+    const Viewport viewport {0, 0, 64, 64};
+
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> jitter(-3 * SUBPIXEL_STEPS, 3 * SUBPIXEL_STEPS);
+
+    RasterVertex grid[cells + 1][cells + 1];
+    for (int row = 0; row <= cells; ++row)
+    {
+        for (int column = 0; column <= cells; ++column)
+        {
+            const bool border = row == 0 or column == 0 or row == cells or column == cells;
+            const bool snapped = (row + column) % 3 == 0;
+            const int x = 4 * SUBPIXEL_STEPS + column * cell + (border ? 0 : snapped ? 0 : jitter(generator));
+            const int y = 4 * SUBPIXEL_STEPS + row    * cell + (border ? 0 : snapped ? 0 : jitter(generator));
+            grid[row][column] = { snapped ? x + SUBPIXEL_HALF : x, snapped ? y + SUBPIXEL_HALF : y, 5.0f };
+        }
+    }
+
+    Array2D<u32> scalar(64, 64, 0u);
+    Array2D<u32> blocks(64, 64, 0u);
+    for (int row = 0; row < cells; ++row)
+    {
+        for (int column = 0; column < cells; ++column)
+        {
+            const RasterVertex& a = grid[row][column];
+            const RasterVertex& b = grid[row][column + 1];
+            const RasterVertex& c = grid[row + 1][column + 1];
+            const RasterVertex& d = grid[row + 1][column];
+
+            // The winding the rasterizers fill.
+            for (const RasterVertex* triangle : { &a, &c })
+            {
+                const RasterVertex& p1 = triangle == &a ? b : d;
+                const RasterVertex& p2 = triangle == &a ? c : a;
+                Rasterize      (viewport, *triangle, p1, p2, [&](const i32 x, const i32 y, f32) { scalar(y, x) += 1; });
+                RasterizeBlocks(viewport, *triangle, p1, p2, CountFragment { blocks, viewport });
+            }
+        }
+    }
+
+    // The outline is on pixel centres along the top and left, so those are in, and the ones along the bottom and
+    // right are out.
+    const int first = 4;
+    const int last  = 4 + cells * 9 - 1;
+
+    unsigned wrong_scalar = 0;
+    unsigned wrong_blocks = 0;
+    unsigned drawn        = 0;
+    for (int y = 0; y < 64; ++y)
+    {
+        for (int x = 0; x < 64; ++x)
+        {
+            const u32 expected = first <= x and x <= last and first <= y and y <= last ? 1u : 0u;
+            wrong_scalar += scalar(y, x) != expected;
+            wrong_blocks += blocks(y, x) != expected;
+            drawn        += scalar(y, x);
+        }
+    }
+    Check(drawn, ==, (last - first + 1) * (last - first + 1));
+    Check(wrong_scalar, ==, 0);
+    Check(wrong_blocks, ==, 0);
+}
+
+Test(HugeTrianglesDontOverflow)
+{
+    // Vertices as far out as raster positions go, around a viewport far from the origin. The edge functions there are
+    // well out of i32's range.
+    constexpr i32 far = MAX_RASTER_COORDINATE * SUBPIXEL_STEPS;
+    const Viewport viewport {100000, -70000, 100064, -70000 + 48};
+
+    const RasterVertex a { -far, -far, 10.0f }, b { far, -far, 10.0f }, c { far, far, 10.0f };
+
+    Array2D<u32> scalar(48, 64, 0u);
+    Array2D<u32> blocks(48, 64, 0u);
+    Rasterize      (viewport, a, b, c, [&](const i32 x, const i32 y, f32) { scalar(static_cast<unsigned>(y - viewport.top), static_cast<unsigned>(x - viewport.left)) += 1; });
+    RasterizeBlocks(viewport, a, b, c, CountFragment { blocks, viewport });
+
+    // Right of the diagonal y = x, which the viewport is well clear of.
+    unsigned wrong_scalar = 0;
+    unsigned wrong_blocks = 0;
+    for (unsigned i = 0; i < 48 * 64; ++i)
+    {
+        wrong_scalar += scalar.data[i] != 1u;
+        wrong_blocks += blocks.data[i] != 1u;
+    }
+    Check(wrong_scalar, ==, 0);
+    Check(wrong_blocks, ==, 0);
+
+    // And a long edge straight through it, against the edge functions in i64 at every pixel.
+    const RasterVertex d { -far, -far, 10.0f }, e { far, far - 1000 * SUBPIXEL_STEPS, 10.0f }, f { far, -far, 10.0f };
+    const Viewport near_diagonal {70000, 69220, 70064, 69268};
+
+    Clear(blocks);
+    RasterizeBlocks(near_diagonal, d, f, e, CountFragment { blocks, near_diagonal });
+
+    unsigned wrong = 0;
+    unsigned inside_count = 0;
+    for (int y = near_diagonal.top; y < near_diagonal.bottom; ++y)
+    {
+        for (int x = near_diagonal.left; x < near_diagonal.right; ++x)
+        {
+            const i64 sample_x = i64(x) * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+            const i64 sample_y = i64(y) * SUBPIXEL_STEPS + SUBPIXEL_HALF;
+            const bool inside = EdgeFunction(f, e, sample_x, sample_y) <= 0 and EdgeFunction(e, d, sample_x, sample_y) <= 0 and
+                                EdgeFunction(d, f, sample_x, sample_y) <= 0;
+            inside_count += inside;
+            wrong += blocks(static_cast<unsigned>(y - near_diagonal.top), static_cast<unsigned>(x - near_diagonal.left)) != (inside ? 1u : 0u);
+        }
+    }
+    Check(inside_count, >, 0);
+    Check(inside_count, <, 48 * 64);
+    Check(wrong, ==, 0);
+}
+
+Test(DepthIsInterpolatedInverseZ)
+{
+    // A triangle at a constant depth has 1/z everywhere.
+    const Viewport viewport {0, 0, 32, 32};
+
+    unsigned wrong = 0;
+    unsigned fragments = 0;
+    Rasterize(viewport, AtPixel(0, 0, 4.0f), AtPixel(30, 0, 4.0f), AtPixel(0, 30, 4.0f), [&](i32, i32, const f32 depth)
+    {
+        fragments += 1;
+        wrong += std::abs(depth - 0.25f) > 1e-6f;
+    });
+
+    Check(fragments, >, 400);
+    Check(wrong, ==, 0);
+}
+
+Test(BlocksMatchScalar)
+{
+    // Sizes that aren't multiples of the block size or SIMD width, and a viewport that doesn't start at the origin,
+    // so the rows sticking out of it go through the scalar path.
+    Check(BlockMismatches({0, 0, 64, 64},  64, 64,   6, 3000, 1), ==, 0);
+    Check(BlockMismatches({0, 0, 61, 37},  61, 37,  30, 500,  2), ==, 0);
+    Check(BlockMismatches({3, 5, 50, 41},  61, 47, 200, 100,  3), ==, 0);
+    Check(BlockMismatches({0, 0, 100, 100}, 100, 100, 1000, 20, 4), ==, 0);
+}
+
+Test(CullsWhatTheCameraCantSee)
+{
+    using glm::vec3;
+
+    Camera camera;
+    const Frustum frustum = ViewFrustum(camera);
+
+    // Facing the camera (which looks down -z) at a distance of 5, and the same triangle turned around.
+    const vec3 a (-1.0f, -1.0f, -5.0f), b (1.0f, -1.0f, -5.0f), c (0.0f, 1.0f, -5.0f);
+    const vec3 color (1.0f);
+    Check(Cull(frustum, Triangle(a, b, c, color)) == Visibility::VISIBLE,     ==, true);
+    Check(Cull(frustum, Triangle(a, c, b, color)) == Visibility::BACK_FACING, ==, true);
+
+    // Behind the camera (turned to face it), beyond the far plane, and off to the side.
+    const vec3 behind (0.0f, 0.0f, 10.0f), beyond (0.0f, 0.0f, -2000.0f), right (100.0f, 0.0f, 0.0f);
+    Check(Cull(frustum, Triangle(a + behind, c + behind, b + behind, color)) == Visibility::OUTSIDE_FRUSTUM, ==, true);
+    Check(Cull(frustum, Triangle(a + beyond, b + beyond, c + beyond, color)) == Visibility::OUTSIDE_FRUSTUM, ==, true);
+    Check(Cull(frustum, Triangle(a + right,  b + right,  c + right,  color)) == Visibility::OUTSIDE_FRUSTUM, ==, true);
+
+    // Through the near plane, from behind the camera, and out of the guard band. Both are drawn, clipped.
+    Check(Cull(frustum, Triangle(a, b, vec3(0.0f, 1.0f, 1.0f), color)) == Visibility::CLIPPED, ==, true);
+    Check(Cull(frustum, Triangle(a, b, vec3(0.0f, 1000.0f, -5.0f), color)) == Visibility::CLIPPED, ==, true);
+}
+
+Test(DrawCountsCulledTriangles)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+    const Viewport viewport {0, 0, 40, 40};
+
+    VertexBuffer vertices;
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+
+    Array2D<f32> z_buffer(40, 40);
+    Array2D<u32> image(40, 40);
+
+    // From in front of the open box, the outsides of the walls face away; turned around, all of it is behind.
+    const CullingStats facing = Draw(camera, viewport, mesh, vertices, z_buffer, View(image));
+    Check(facing.submitted, ==, TriangleCount(mesh));
+    Check(facing.back_facing, >, 0);
+    Check(facing.outside_frustum + facing.clipped, ==, 0);
+
+    SetYaw(camera, PI);
+    const CullingStats away = Draw(camera, viewport, mesh, vertices, z_buffer, View(image));
+    Check(Culled(away), ==, TriangleCount(mesh));
+}
+
+Test(IndexedMeshSharesVertices)
+{
+    const std::vector<Triangle> model = LoadTestModel();
+    const Mesh mesh = IndexedMesh(model);
+
+    // The box's corners are in several walls each.
+    Check(TriangleCount(mesh), ==, model.size());
+    Check(mesh.vertex_count, <, 3 * model.size() / 2);
+    Check(mesh.positions[0].size() % SIMD_WIDTH, ==, 0);
+
+    for (u32 i = 0; i < TriangleCount(mesh); ++i)
+    {
+        Check(Position(mesh, mesh.indices[3 * i + 0]) == model[i].v0, ==, true);
+        Check(Position(mesh, mesh.indices[3 * i + 1]) == model[i].v1, ==, true);
+        Check(Position(mesh, mesh.indices[3 * i + 2]) == model[i].v2, ==, true);
+    }
+}
+
+Test(TransformVerticesMatchesVertexShader)
+{
+    const Mesh mesh = IndexedMesh(LoadRandomModel(500, 3));
+    const Viewport viewport {0, 0, 61, 61};
+
+    VertexBuffer vertices;
+    Resize(vertices, mesh);
+
+    Camera camera;
+    for (const float x : { 0.0f, -0.4f, 0.7f })
+    {
+        camera.position = glm::vec3(x, 0.1f, 3.0f - 2 * x);
+        SetYaw(camera, x * 3);
+        const Frustum frustum = ViewFrustum(camera);
+
+        TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+
+        unsigned mismatches = 0;
+        for (u32 vertex = 0; vertex < mesh.vertex_count; ++vertex)
+        {
+            const glm::vec3 position = Position(mesh, vertex);
+            const RasterVertex batched = Raster(vertices, vertex);
+            const RasterVertex scalar  = VertexShader(viewport, Vertex(position), camera);
+            mismatches += batched.x != scalar.x or batched.y != scalar.y or std::memcmp(&batched.z, &scalar.z, sizeof(f32)) != 0 or
+                          vertices.outcodes[vertex] != Outcode(frustum, camera.cached_rotation_matrix * (position - camera.position));
+        }
+        Check(mismatches, ==, 0);
+    }
+}
+
+Test(ClipsTrianglesThroughTheNearPlane)
+{
+    using glm::vec3;
+
+    // A floor under the camera, from behind it to far in front: only what's in front of the near plane is drawn.
+    const vec3 a (-50.0f, -1.0f, 10.0f), b (50.0f, -1.0f, 10.0f), c (50.0f, -1.0f, -50.0f), d (-50.0f, -1.0f, -50.0f);
+    const Mesh mesh = IndexedMesh({ Triangle(a, b, c, vec3(1.0f)), Triangle(a, c, d, vec3(1.0f)) });
+
+    constexpr int size = 64;
+    const Viewport viewport {0, 0, size, size};
+
+    Camera camera;
+    camera.near = 0.5f;
+
+    VertexBuffer vertices;
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> image(size, size);
+    const CullingStats stats = Draw(camera, viewport, mesh, vertices, z_buffer, View(image));
+    Check(stats.clipped, ==, 2);
+
+    // Raster y grows with camera y, so the floor is on the rows before the horizon, all the way to the edge of the
+    // image, and nothing drawn is closer than the near plane.
+    unsigned missing = 0;
+    unsigned too_close = 0;
+    unsigned above_horizon = 0;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            const bool drawn = z_buffer(y, x) != FarDepth(camera);
+            missing       += y < size / 4 and not drawn;
+            above_horizon += y >= size / 2 and drawn;
+            too_close     += drawn and z_buffer(y, x) > 1.0f / camera.near;
+        }
+    }
+    Check(missing,       ==, 0);
+    Check(above_horizon, ==, 0);
+    Check(too_close,     ==, 0);
+}
+
+Test(GuardBandClippingKeepsEdgesStraight)
+{
+    using glm::vec3;
+
+    // A quad over the whole view at a distance of 5, reaching far out of the guard band, with the diagonal between its
+    // two triangles across the view. Clamped rather than clipped, the diagonal would turn towards the corners of the
+    // fixed point range.
+    const f32 z = -5.0f, far = 100000.0f;
+    const vec3 centre (0.3f, 0.2f, z);
+    const vec3 a = centre + vec3(-far, -0.7f * far, 0.0f), b = centre + vec3(far, -far, 0.0f);
+    const vec3 c = centre + vec3( far,  0.7f * far, 0.0f), d = centre + vec3(-far, far, 0.0f);
+    const Mesh mesh = IndexedMesh({ Triangle(a, b, c, vec3(1.0f)), Triangle(a, c, d, vec3(0.5f)) });
+
+    constexpr int size = 64;
+    const Viewport viewport {0, 0, size, size};
+    const Camera camera;
+
+    VertexBuffer vertices;
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> image(size, size);
+    const CullingStats stats = Draw(camera, viewport, mesh, vertices, z_buffer, View(image));
+    Check(stats.clipped, ==, 2);
+
+    // Which triangle a pixel is in is decided by the diagonal, away from it by more than a pixel.
+    const Frustum frustum = ViewFrustum(camera);
+    const f32 pixel = 2 * frustum.right * -z / size;
+    const auto Side = [&](const f32 x, const f32 y) { return (c.x - a.x) * (y - a.y) - (c.y - a.y) * (x - a.x); };
+    const f32 diagonal = glm::length(glm::vec2(c - a));
+
+    unsigned missing   = 0;
+    unsigned wrong     = 0;
+    unsigned depths    = 0;
+    unsigned each[2]   = { 0, 0 };
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            missing += image(y, x) == 0;
+            depths  += std::abs(1.0f / z_buffer(y, x) - 5.0f) > 1e-3f;
+
+            const f32 side = Side(((x + 0.5f) / size * 2 - 1) * frustum.right * -z, ((y + 0.5f) / size * 2 - 1) * frustum.top * -z);
+            if (std::abs(side) > pixel * diagonal)
+            {
+                const int triangle = (side > 0) == (Side(b.x, b.y) > 0) ? 0 : 1;
+                wrong          += image(y, x) != mesh.colors[triangle];
+                each[triangle] += 1;
+            }
+        }
+    }
+    Check(missing, ==, 0);
+    Check(wrong,   ==, 0);
+    Check(depths,  ==, 0);
+    Check(each[0], >, size * size / 4);
+    Check(each[1], >, size * size / 4);
+}
+
+Test(ClippedEdgesAreShared)
+{
+    // A fan of triangles around a point just in front of the camera, on a tilted plane, reaching far out of the guard
+    // band and cut in two by the near plane. The pieces of neighbours must still meet without gaps or overlaps.
+    using glm::vec3;
+
+    const vec3 centre (0.2f, -0.1f, -0.8f);
+    const vec3 along  (1.0f, 0.0f, 0.0f);
+    const vec3 up     (0.0f, 0.6f, -0.8f);
+    const vec3 normal = glm::cross(along, up);
+
+    std::vector<Triangle> model;
+    constexpr int spokes = 12;
+    for (int i = 0; i < spokes; ++i)
+    {
+        const f32 angle0 = 2 * PI * i / spokes;
+        const f32 angle1 = 2 * PI * (i + 1) / spokes;
+        const vec3 v0 = centre + (std::cos(angle0) * along + std::sin(angle0) * up) * 4000.0f;
+        const vec3 v1 = centre + (std::cos(angle1) * along + std::sin(angle1) * up) * 4000.0f;
+
+        // Facing the camera.
+        Triangle triangle (centre, v0, v1, vec3(1.0f));
+        if (glm::dot(triangle.normal, centre) >= 0)
+            triangle = Triangle(centre, v1, v0, vec3(1.0f));
+        model.push_back(triangle);
+    }
+    const Mesh mesh = IndexedMesh(model);
+
+    constexpr int size = 64;
+    const Viewport viewport {0, 0, size, size};
+    const Camera camera;
+    const Frustum frustum = ViewFrustum(camera);
+
+    VertexBuffer vertices;
+    Resize(vertices, mesh);
+    TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+
+    Array2D<int> hits(size, size);
+    Clear(hits);
+    CullingStats stats;
+    ClippedPolygon polygon;
+    for (u32 triangle = 0; triangle < TriangleCount(mesh); ++triangle)
+    {
+        if (not VisibleTriangle(camera, viewport, mesh, vertices, triangle, stats, polygon))
+            continue;
+
+        for (u32 piece = 0; piece < PieceCount(polygon); ++piece)
+            Rasterize(viewport, polygon.vertices[0], polygon.vertices[piece + 1], polygon.vertices[piece + 2],
+                      [&](const i32 x, const i32 y, f32) { hits(y, x) += 1; });
+    }
+    Check(stats.clipped, >, 0);
+
+    // Every pixel whose ray meets the plane beyond the near plane is drawn once, and the rest not at all. Pixels right
+    // at the near plane could go either way.
+    unsigned wrong   = 0;
+    unsigned checked = 0;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            const vec3 direction (((x + 0.5f) / size * 2 - 1) * frustum.right, ((y + 0.5f) / size * 2 - 1) * frustum.top, -1.0f);
+            const f32 distance = glm::dot(normal, centre) / glm::dot(normal, direction);
+            if (std::abs(distance - camera.near) < 0.02f)
+                continue;
+
+            checked += 1;
+            wrong   += hits(y, x) != (distance > camera.near ? 1 : 0);
+        }
+    }
+    Check(wrong,   ==, 0);
+    Check(checked, >, size * size * 9 / 10);
+}
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,73 @@
+#include "test.h"
+#include "TestModel.h"
+#include "raytracer.h"
+
+
+Test(PrecomputedHit)
+{
+    const std::vector<Triangle> triangles { Triangle(glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(0, 1, 0), glm::vec3(1)) };
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(triangles);
+
+    const Intersection result = ClosestIntersection(glm::vec3(0, 0, 2), glm::vec3(0, 0, -1), records);
+
+    Check(result.triangle_index, ==, 0);
+    Check(result.distance, ==, 2.0f);
+    Check(result.position.z, ==, 0.0f);
+}
+
+Test(PrecomputedMiss)
+{
+    const std::vector<Triangle> triangles { Triangle(glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(0, 1, 0), glm::vec3(1)) };
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(triangles);
+
+    const Intersection behind   = ClosestIntersection(glm::vec3(0, 0,  2), glm::vec3(0, 0, 1), records);
+    const Intersection outside  = ClosestIntersection(glm::vec3(5, 0,  2), glm::vec3(0, 0, -1), records);
+    const Intersection parallel = ClosestIntersection(glm::vec3(0, 0,  2), glm::vec3(1, 0, 0), records);
+
+    Check(bool(behind),   ==, false);
+    Check(bool(outside),  ==, false);
+    Check(bool(parallel), ==, false);
+}
+
+Test(PrecomputedMatchesReference)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const std::vector<Triangle>       model   = LoadTestModel();
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(model);
+
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+
+    for (int row = 0; row < 100; ++row)
+    {
+        for (int column = 0; column < 100; ++column)
+        {
+            const glm::vec3 direction (column - 49.5f, row - 49.5f, -50.0f);
+
+            const Intersection reference   = ClosestIntersection(origin, direction, model);
+            const Intersection precomputed = ClosestIntersection(origin, direction, records);
+
+            // Rays into the corners of the room hit two walls at the same distance, so the two kernels may disagree
+            // on which triangle was hit, but never on whether or where.
+            Check(bool(precomputed), ==, bool(reference));
+            Check(std::abs(precomputed.distance - reference.distance), <, 0.0001f);
+        }
+    }
+}
+
+Test(OccludedOnlyWithinInterval)
+{
+    const std::vector<Triangle> triangles { Triangle(glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(0, 1, 0), glm::vec3(1)) };
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(triangles);
+
+    // The triangle is at t = 2.
+    Check(Occluded(glm::vec3(0, 0, 2), glm::vec3(0, 0, -1), 3.0f, records), ==, true);
+    Check(Occluded(glm::vec3(0, 0, 2), glm::vec3(0, 0, -1), 1.0f, records), ==, false);
+    Check(Occluded(glm::vec3(0, 0, 2), glm::vec3(0, 0,  1), 3.0f, records), ==, false);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,196 @@
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "lab2.h"
+#include "binning.h"
+#include "shadows.h"
+
+
+// Where the blocks cast shadows onto the floor and the walls, and onto each other.
+std::vector<Light> TestLights()
+{
+    std::vector<Light> lights(3);
+    lights[0].position = glm::vec3(0.0f, -0.5f, 0.0f);
+    lights[1].position = glm::vec3(0.2f, -0.3f, 0.4f);
+    lights[2].position = glm::vec3(-0.6f, -0.8f, -0.5f);
+    return lights;
+}
+
+
+Test(CubeFacesCoverEveryDirection)
+{
+    // Every face's camera sees the directions CubeFace gives it, in the middle of its image.
+    const glm::vec3 directions[6] = {
+        glm::vec3( 1, 0.2f, -0.3f), glm::vec3(-1, -0.4f, 0.1f), glm::vec3(0.3f,  1, 0.2f),
+        glm::vec3(-0.2f, -1, 0.4f), glm::vec3(0.1f, -0.3f,  1), glm::vec3(0.4f, 0.2f, -1)
+    };
+
+    for (i32 face = 0; face < ShadowMap::FACES; ++face)
+    {
+        Check(CubeFace(directions[face]), ==, face);
+
+        const glm::vec3 camera_space = FaceRotation(face) * directions[face];
+        Check(camera_space.z, <, -0.9f);
+        Check(std::abs(camera_space.x), <, -camera_space.z);
+        Check(std::abs(camera_space.y), <, -camera_space.z);
+    }
+}
+
+Test(AgreesWithShadowRays)
+{
+    const std::vector<Triangle> model = LoadTestModel();
+    const Mesh mesh = IndexedMesh(model);
+    const BVH  bvh  = BuildBVH(model);
+
+    ThreadPool pool(3);
+    ShadowMap  map;
+    Resize(map, 512);
+
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<f32> uniform(0.0f, 1.0f);
+
+    // Points all over the box lit by the light, or not, as Lab2's shadow rays say. Where the filter sees some of both
+    // it's along the edge of a shadow, and either is right. Not the ones the light grazes, which it hardly lights.
+    unsigned shadowed  = 0;
+    unsigned edges     = 0;
+    unsigned disagree  = 0;
+    unsigned samples   = 0;
+    for (const Light& light : TestLights())
+    {
+        Check(DrawShadowMap(light, mesh, pool, map), ==, true);
+
+        for (const Triangle& triangle : model)
+        {
+            for (int i = 0; i < 200; ++i)
+            {
+                f32 u = uniform(generator), v = uniform(generator);
+                if (u + v > 1.0f)
+                {
+                    u = 1.0f - u;
+                    v = 1.0f - v;
+                }
+                const glm::vec3 position = triangle.v0 + u * (triangle.v1 - triangle.v0) + v * (triangle.v2 - triangle.v0);
+
+                const glm::vec3 to_light = light.position - position;
+                if (glm::dot(glm::normalize(to_light), triangle.normal) < 0.1f)
+                    continue;
+
+                const glm::vec3 start = position + glm::normalize(to_light) * 0.001f;
+                const bool in_shadow  = Occluded(start, to_light, 1.0f, bvh);
+                const f32  lit        = Lit(map, position, triangle.normal);
+
+                samples  += 1;
+                shadowed += in_shadow;
+                edges    += lit > 0.0f and lit < 1.0f;
+                disagree += (lit == 1.0f and in_shadow) or (lit == 0.0f and not in_shadow);
+            }
+        }
+    }
+    Check(shadowed, >,  samples / 20);
+    Check(edges,    <,  samples / 20);
+    Check(disagree, <,  samples / 200);
+}
+
+Test(OnlyDarkensWhatsInShadow)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 100;
+    const Viewport viewport {0, 0, size, size};
+
+    Camera camera;
+    camera.position = glm::vec3(-0.4f, 0.1f, 3.0f);
+    SetYaw(camera, -0.2f);
+
+    ThreadPool pool(3);
+    TileBins   bins;
+    GBuffer    gbuffer;
+    ShadowMap  map;
+    Resize(map, 256);
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> without(size, size);
+    Array2D<u32> forward(size, size);
+    Array2D<u32> deferred_with(size, size);
+
+    for (const Light& light : TestLights())
+    {
+        DrawShadowMap(light, mesh, pool, map);
+
+        for (const bool deferred : { false, true })
+        {
+            Array2D<u32>& with = deferred ? deferred_with : forward;
+            if (deferred)
+            {
+                DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, View(without));
+                DrawBinnedDeferred(camera, light, viewport, mesh, pool, bins, gbuffer, View(with), &map);
+            }
+            else
+            {
+                DrawBinnedLit(camera, light, viewport, mesh, pool, bins, z_buffer, View(without));
+                DrawBinnedLit(camera, light, viewport, mesh, pool, bins, z_buffer, View(with), &map);
+            }
+
+            // No channel of any pixel brighter, and some darker.
+            unsigned brighter = 0;
+            unsigned darker   = 0;
+            for (int y = 0; y < size; ++y)
+            {
+                for (int x = 0; x < size; ++x)
+                {
+                    for (int shift = 0; shift < 24; shift += 8)
+                    {
+                        const u32 before = (without(y, x) >> shift) & 0xFF;
+                        const u32 after  = (with(y, x)    >> shift) & 0xFF;
+                        brighter += after > before;
+                        darker   += after < before;
+                    }
+                }
+            }
+            Check(brighter, ==, 0);
+            Check(darker,   >,  size);
+        }
+
+        // The same shadows in the same places, forward or deferred.
+        unsigned mismatches = 0;
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                mismatches += forward(y, x) != deferred_with(y, x);
+        Check(mismatches, ==, 0);
+    }
+}
+
+Test(DrawsAgainOnlyWhenTheLightMoves)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    ThreadPool pool(2);
+    ShadowMap  map;
+    Resize(map, 64);
+
+    Light light;
+    light.position = glm::vec3(0.2f, -0.3f, 0.4f);
+
+    Check(DrawShadowMap(light, mesh, pool, map), ==, true);
+    Check(DrawShadowMap(light, mesh, pool, map), ==, false);
+
+    light.color *= 2.0f;
+    Check(DrawShadowMap(light, mesh, pool, map), ==, false);
+
+    light.position.x += 0.1f;
+    Check(DrawShadowMap(light, mesh, pool, map), ==, true);
+
+    Resize(map, 64);
+    Check(DrawShadowMap(light, mesh, pool, map), ==, false);
+
+    Resize(map, 128);
+    Check(DrawShadowMap(light, mesh, pool, map), ==, true);
+
+    map.valid = false;
+    Check(DrawShadowMap(light, mesh, pool, map), ==, true);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,95 @@
+#include <random>
+
+#include "test.h"
+#include "TestModel.h"
+#include "raytracer.h"
+#include "soa.h"
+
+
+Test(PaddedAndAligned)
+{
+    const std::vector<Triangle> model = LoadRandomModel(SIMD_WIDTH * 3 + 1, 11);
+    const TriangleLanes lanes = PrecomputeTriangleLanes(model);
+
+    Check(Size(lanes), ==, SIMD_WIDTH * 4);
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        Check(reinterpret_cast<size_t>(lanes.v0[axis].data()) % SIMD_ALIGNMENT, ==, 0);
+        Check(reinterpret_cast<size_t>(lanes.e1[axis].data()) % SIMD_ALIGNMENT, ==, 0);
+        Check(reinterpret_cast<size_t>(lanes.e2[axis].data()) % SIMD_ALIGNMENT, ==, 0);
+    }
+
+    // The padding is never hit, even by a ray through the origin.
+    Check(bool(ClosestIntersection(glm::vec3(0, 0, 2), glm::vec3(0, 0, -1), PrecomputeTriangleLanes({}))), ==, false);
+}
+
+Test(MatchesRecords)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const std::vector<Triangle>       model   = LoadRandomModel(1001, 12);
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(model);
+    const TriangleLanes               lanes   = PrecomputeTriangleLanes(model);
+
+    std::mt19937 generator(13);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    unsigned hits = 0;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const glm::vec3 start     (unit(generator) * 2, unit(generator) * 2, unit(generator) * 2);
+        const glm::vec3 direction (unit(generator),     unit(generator),     unit(generator));
+        const float     t_max = unit(generator) + 1.0f;
+
+        const Intersection scalar     = ClosestIntersection(start, direction, records);
+        const Intersection vectorized = ClosestIntersection(start, direction, lanes);
+
+        Check(vectorized.triangle_index, ==, scalar.triangle_index);
+        Check(vectorized.distance,       ==, scalar.distance);
+        Check(Occluded(start, direction, t_max, lanes), ==, Occluded(start, direction, t_max, records));
+
+        hits += bool(scalar);
+    }
+
+    Check(hits, >, 0);
+}
+
+Test(CornellBoxCorners)
+{
+    options.flags = Options::OUTPUT_FAILURES | Options::OUTPUT_TESTS;
+
+    const std::vector<Triangle>       model   = LoadTestModel();
+    const std::vector<TriangleRecord> records = PrecomputeTriangles(model);
+    const TriangleLanes               lanes   = PrecomputeTriangleLanes(model);
+
+    const glm::vec3 origin (0.0f, 0.0f, 2.0f);
+
+    for (int row = 0; row < 100; ++row)
+    {
+        for (int column = 0; column < 100; ++column)
+        {
+            const glm::vec3 direction (column - 49.5f, row - 49.5f, -50.0f);
+
+            // Ties between lanes go to the lowest index, like in the scalar scan.
+            Check(ClosestIntersection(origin, direction, lanes).triangle_index, ==, ClosestIntersection(origin, direction, records).triangle_index);
+        }
+    }
+}
+
+Test(ShadingTableFollowsModel)
+{
+    const std::vector<Triangle>      model   = LoadTestModel();
+    const std::vector<ShadingRecord> shading = ShadingTable(model);
+
+    Check(shading.size(), ==, model.size());
+    Check(shading[7].normal == model[7].normal, ==, true);
+    Check(shading[7].color  == model[7].color,  ==, true);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,67 @@
+#include "test.h"
+#include "threadpool.h"
+
+
+Test(EveryTaskRunsOnce)
+{
+    for (const unsigned thread_count : { 1u, 2u, 3u, 8u })
+    {
+        ThreadPool pool(thread_count);
+
+        std::vector<std::atomic<unsigned>> runs(1000);
+        for (std::atomic<unsigned>& count : runs)
+            count = 0;
+
+        ParallelFor(pool, static_cast<unsigned>(runs.size()), [&](const unsigned task, const unsigned thread)
+        {
+            // Uneven amounts of work, so the threads have something to steal.
+            if (thread == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+
+            runs[task] += 1;
+        });
+
+        unsigned once = 0;
+        for (const std::atomic<unsigned>& count : runs)
+            once += count == 1;
+
+        unsigned tasks = 0;
+        for (const ThreadPool::ThreadStatistics& statistics : pool.statistics)
+            tasks += statistics.tasks;
+
+        Check(once,  ==, runs.size());
+        Check(tasks, ==, runs.size());
+    }
+}
+
+Test(ReusedForManyBatches)
+{
+    ThreadPool pool(4);
+
+    std::atomic<unsigned> sum { 0 };
+    for (unsigned batch = 0; batch < 100; ++batch)
+        ParallelFor(pool, batch, [&](const unsigned task, unsigned) { sum += task; });
+
+    // Sum of 0 + 1 + ... + (batch - 1) for every batch.
+    unsigned expected = 0;
+    for (unsigned batch = 0; batch < 100; ++batch)
+        expected += batch * (batch - 1) / 2;
+
+    Check(sum.load(), ==, expected);
+}
+
+Test(ThreadIndexInRange)
+{
+    ThreadPool pool(3);
+
+    std::atomic<unsigned> out_of_range { 0 };
+    ParallelFor(pool, 500, [&](unsigned, const unsigned thread) { out_of_range += thread >= 3; });
+
+    Check(out_of_range.load(), ==, 0);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
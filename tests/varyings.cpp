@@ -0,0 +1,201 @@
+#include "test.h"
+#include "debug.h"
+#include "TestModel.h"
+#include "binning.h"
+#include "TestViews.h"
+
+
+// Up to 'tolerance' apart in every channel.
+bool SimilarColors(const u32 a, const u32 b, const int tolerance)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+        if (std::abs(static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((b >> shift) & 0xFF)) > tolerance)
+            return false;
+
+    return true;
+}
+
+
+Test(SimdMatchesScalar)
+{
+    const RasterVertex p0 = AtPixel(3, 2, 1.5f);
+    const RasterVertex p1 = AtPixel(60, 30, 9.0f);
+    const RasterVertex p2 = AtPixel(10, 61, 4.0f);
+
+    const Varyings<4> vertices[3] = { { { 1, 2, 3, 4 } }, { { -5, 0, 7, 1 } }, { { 2, 2, -1, 0.5f } } };
+    const VaryingInterpolator<4> interpolator = Interpolator(p0, p1, p2, WholeTriangle(), vertices);
+
+    unsigned lanes      = 0;
+    unsigned mismatches = 0;
+
+    // Every SIMD lane is what the scalar At gives at its pixel and depth.
+    for (i32 y = 0; y < 64; ++y)
+    {
+        for (i32 x = 0; x < 64; x += SIMD_WIDTH)
+        {
+            alignas(SIMD_ALIGNMENT) f32 depths[SIMD_WIDTH];
+            for (unsigned lane = 0; lane < SIMD_WIDTH; ++lane)
+                depths[lane] = 1.0f / (1.5f + 0.1f * static_cast<f32>(x + lane) + 0.05f * static_cast<f32>(y));
+
+            SimdFloat varyings[4];
+            interpolator.At(x, y, LoadU(depths), varyings);
+
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                alignas(SIMD_ALIGNMENT) f32 values[SIMD_WIDTH];
+                Store(values, varyings[i]);
+
+                for (unsigned lane = 0; lane < SIMD_WIDTH; ++lane)
+                {
+                    Varyings<4> scalar;
+                    interpolator.At(x + static_cast<i32>(lane), y, depths[lane], scalar);
+                    mismatches += std::memcmp(&scalar.values[i], &values[lane], sizeof(f32)) != 0;
+                    lanes      += 1;
+                }
+            }
+        }
+    }
+    Check(lanes,      ==, 64u * 64u * 4u);
+    Check(mismatches, ==, 0);
+}
+
+Test(GivesTheVaryingsAtTheVertices)
+{
+    // Pixel centres, so the vertices are sampled exactly.
+    const RasterVertex p0 = AtPixel(0,  0,  1.0f);
+    const RasterVertex p1 = AtPixel(40, 0,  5.0f);
+    const RasterVertex p2 = AtPixel(0,  40, 2.0f);
+
+    const Varyings<2> vertices[3] = { { { 1, -3 } }, { { 10, 0.25f } }, { { -2, 8 } } };
+    const VaryingInterpolator<2> interpolator = Interpolator(p0, p1, p2, WholeTriangle(), vertices);
+
+    const RasterVertex corners[3] = { p0, p1, p2 };
+    for (unsigned vertex = 0; vertex < 3; ++vertex)
+    {
+        Varyings<2> varyings;
+        interpolator.At(corners[vertex].x >> SUBPIXEL_BITS, corners[vertex].y >> SUBPIXEL_BITS, 1.0f / corners[vertex].z, varyings);
+
+        for (unsigned i = 0; i < 2; ++i)
+            Check(std::abs(varyings.values[i] - vertices[vertex].values[i]), <, 1e-4f);
+    }
+}
+
+Test(IsLinearInWorldSpace)
+{
+    // A quad seen at a slant, with 'a + b x + c y + d z' of its world position as the varying: perspective correct
+    // interpolation gives exactly that at every pixel, where interpolating in screen space would bend it. Wound both
+    // ways, so one of the two is facing the camera.
+    const glm::vec3 a (-1, -1,  0.5f);
+    const glm::vec3 b ( 1, -1, -2.0f);
+    const glm::vec3 c ( 1,  1, -2.0f);
+    const glm::vec3 d (-1,  1,  0.5f);
+    const Mesh mesh = IndexedMesh({
+        Triangle(a, b, c, glm::vec3(1)), Triangle(a, c, d, glm::vec3(1)),
+        Triangle(a, c, b, glm::vec3(1)), Triangle(a, d, c, glm::vec3(1))
+    });
+
+    constexpr int size = 64;
+    const Viewport viewport {0, 0, size, size};
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+    SetYaw(camera, 0.0f);
+
+    const auto linear = [](const glm::vec3& p) { return 0.5f + 2.0f * p.x - 1.0f * p.y + 0.25f * p.z; };
+
+    VertexBuffer vertices;
+    Resize(vertices, mesh);
+    TransformVertices(camera, viewport, mesh, vertices, 0, static_cast<u32>(mesh.positions[0].size()));
+
+    CullingStats   culling;
+    ClippedPolygon polygon;
+    unsigned fragments = 0;
+    unsigned wrong     = 0;
+
+    for (u32 triangle = 0; triangle < TriangleCount(mesh); ++triangle)
+    {
+        if (not VisibleTriangle(camera, viewport, mesh, vertices, triangle, culling, polygon))
+            continue;
+
+        Varyings<4> at_vertices[3];
+        for (unsigned vertex = 0; vertex < 3; ++vertex)
+        {
+            const glm::vec3 p = Position(mesh, mesh.indices[3 * triangle + vertex]);
+            at_vertices[vertex] = { { linear(p), p.x, p.y, p.z } };
+        }
+
+        for (u32 piece = 0; piece < PieceCount(polygon); ++piece)
+        {
+            const RasterVertex& p0 = polygon.vertices[0];
+            const RasterVertex& p1 = polygon.vertices[piece + 1];
+            const RasterVertex& p2 = polygon.vertices[piece + 2];
+            const VaryingInterpolator<4> interpolator = Interpolator(p0, p1, p2, Barycentrics(polygon, piece), at_vertices);
+
+            Rasterize(viewport, p0, p1, p2, [&](const i32 x, const i32 y, const f32 depth)
+            {
+                Varyings<4> varyings;
+                interpolator.At(x, y, depth, varyings);
+
+                const glm::vec3 position (varyings.values[1], varyings.values[2], varyings.values[3]);
+                wrong     += std::abs(varyings.values[0] - linear(position)) > 1e-4f;
+                fragments += 1;
+            });
+        }
+    }
+    Check(fragments, >, size * size / 4);
+    Check(wrong,     ==, 0);
+}
+
+Test(LitMatchesDeferred)
+{
+    const Mesh mesh = IndexedMesh(LoadTestModel());
+
+    constexpr int size = 100;
+    const Viewport viewport {0, 0, size, size};
+    const Light light = TestLight();
+
+    VertexBuffer vertices;
+    GBuffer gbuffer;
+    TileBins bins;
+    Array2D<f32> z_buffer(size, size);
+    Array2D<u32> deferred(size, size);
+    Array2D<u32> lit(size, size);
+    Array2D<u32> binned(size, size);
+    ThreadPool pool(3);
+
+    Camera front;
+    front.position = glm::vec3(-0.3f, 0.1f, 2.5f);
+    SetYaw(front, -0.2f);
+
+    for (const Camera& camera : { front, InsideCamera() })
+    {
+        DrawDeferred(camera, light, viewport, mesh, vertices, gbuffer, pool, View(deferred));
+
+        // Shading the same surface at the same pixel, up to how the two round the interpolation.
+        DrawLit(camera, light, viewport, mesh, vertices, z_buffer, View(lit));
+        unsigned different = 0;
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                different += not SimilarColors(lit(y, x), deferred(y, x), 1);
+        Check(different, ==, 0);
+
+        // The binned draws are the serial one bit for bit, with or without the depth pre-pass.
+        for (const bool depth_prepass : { false, true })
+        {
+            bins.depth_prepass = depth_prepass;
+            DrawBinnedLit(camera, light, viewport, mesh, pool, bins, z_buffer, View(binned));
+
+            unsigned mismatches = 0;
+            for (int y = 0; y < size; ++y)
+                for (int x = 0; x < size; ++x)
+                    mismatches += lit(y, x) != binned(y, x);
+            Check(mismatches, ==, 0);
+        }
+    }
+}
+
+
+int main()
+{
+    RunAllTests();
+}